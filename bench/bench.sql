@@ -0,0 +1,105 @@
+/*
+ * pgnodemx benchmark
+ *
+ * Expects to run against a cluster whose pgnodemx.procroot,
+ * pgnodemx.cgrouproot, and pgnodemx.kdapi_path point at a tree built by
+ * gen_fixtures.sh. See run_bench.sh.
+ *
+ * psql variables:
+ *   iters  - number of calls per function
+ *   cgmode - v1 or v2, selects the cgroup files to exercise
+ */
+
+\pset pager off
+\set ON_ERROR_STOP on
+\if :{?cgmode}
+\else
+\set cgmode v2
+\endif
+SELECT :'cgmode' = 'v1' AS is_v1 \gset
+DROP EXTENSION IF EXISTS pgnodemx;
+CREATE EXTENSION pgnodemx;
+
+SELECT cgroup_mode(), current_setting('pgnodemx.procroot') AS procroot,
+       current_setting('pgnodemx.cgrouproot') AS cgrouproot;
+
+CREATE TEMP TABLE bench_call (source TEXT, usec FLOAT8);
+CREATE TEMP TABLE bench_io (source TEXT, key TEXT, delta NUMERIC);
+
+/*
+ * The backend's own /proc/<pid>/io; read from the real procfs since
+ * pgnodemx.procroot points at the fixture tree. The read syscall and
+ * byte counters cover everything read_vfs() does on our behalf.
+ */
+CREATE FUNCTION pg_temp.backend_io()
+RETURNS TABLE (key TEXT, val NUMERIC)
+LANGUAGE sql AS $$
+  SELECT split_part(l, ':', 1), trim(split_part(l, ':', 2))::numeric
+  FROM regexp_split_to_table(
+         pg_read_file('/proc/' || pg_backend_pid() || '/io'), E'\n') AS l
+  WHERE l <> ''
+$$;
+
+CREATE FUNCTION pg_temp.bench(source TEXT, query TEXT, iters INT)
+RETURNS void
+LANGUAGE plpgsql AS $$
+DECLARE
+  t0  TIMESTAMPTZ;
+  i   INT;
+BEGIN
+  /* warm up, and fail early on a broken fixture */
+  EXECUTE query;
+
+  CREATE TEMP TABLE io_before AS SELECT * FROM pg_temp.backend_io();
+  FOR i IN 1 .. iters LOOP
+    t0 := clock_timestamp();
+    EXECUTE query;
+    INSERT INTO bench_call
+      VALUES (source, EXTRACT(EPOCH FROM clock_timestamp() - t0) * 1000000);
+  END LOOP;
+
+  INSERT INTO bench_io
+    SELECT source, a.key, (a.val - b.val) / iters
+    FROM pg_temp.backend_io() a JOIN io_before b USING (key)
+    WHERE a.key IN ('rchar', 'syscr');
+  DROP TABLE io_before;
+END;
+$$;
+
+SELECT pg_temp.bench('proc_diskstats', 'SELECT count(*) FROM proc_diskstats()', :iters);
+SELECT pg_temp.bench('proc_mountinfo', 'SELECT count(*) FROM proc_mountinfo()', :iters);
+SELECT pg_temp.bench('proc_meminfo', 'SELECT count(*) FROM proc_meminfo()', :iters);
+SELECT pg_temp.bench('proc_network_stats', 'SELECT count(*) FROM proc_network_stats()', :iters);
+SELECT pg_temp.bench('proc_cputime', 'SELECT count(*) FROM proc_cputime()', :iters);
+SELECT pg_temp.bench('proc_loadavg', 'SELECT count(*) FROM proc_loadavg()', :iters);
+SELECT pg_temp.bench('proc_pid_stat', 'SELECT count(*) FROM proc_pid_stat()', :iters);
+SELECT pg_temp.bench('proc_pid_io', 'SELECT count(*) FROM proc_pid_io()', :iters);
+SELECT pg_temp.bench('proc_pid_cmdline', 'SELECT count(*) FROM proc_pid_cmdline()', :iters);
+
+SELECT pg_temp.bench('cgroup_process_count', 'SELECT cgroup_process_count()', :iters);
+SELECT pg_temp.bench('cgroup_setof_bigint', 'SELECT count(*) FROM cgroup_setof_bigint(''cgroup.procs'')', :iters);
+SELECT pg_temp.bench('cgroup_setof_kv', 'SELECT count(*) FROM cgroup_setof_kv(''memory.stat'')', :iters);
+\if :is_v1
+SELECT pg_temp.bench('cgroup_scalar_bigint', 'SELECT cgroup_scalar_bigint(''memory.usage_in_bytes'')', :iters);
+SELECT pg_temp.bench('cgroup_setof_ksv', 'SELECT count(*) FROM cgroup_setof_ksv(''blkio.throttle.io_serviced'')', :iters);
+\else
+SELECT pg_temp.bench('cgroup_scalar_bigint', 'SELECT cgroup_scalar_bigint(''memory.current'')', :iters);
+SELECT pg_temp.bench('cgroup_array_bigint', 'SELECT cgroup_array_bigint(''cpu.max'')', :iters);
+SELECT pg_temp.bench('cgroup_setof_nkv', 'SELECT count(*) FROM cgroup_setof_nkv(''io.stat'')', :iters);
+\endif
+
+SELECT pg_temp.bench('kdapi_setof_kv', 'SELECT count(*) FROM kdapi_setof_kv(''labels'')', :iters);
+SELECT pg_temp.bench('kdapi_scalar_bigint', 'SELECT kdapi_scalar_bigint(''mem_limit'')', :iters);
+
+SELECT
+  c.source,
+  count(*) AS calls,
+  round(percentile_cont(0.5) WITHIN GROUP (ORDER BY usec)::numeric, 1) AS p50_us,
+  round(percentile_cont(0.9) WITHIN GROUP (ORDER BY usec)::numeric, 1) AS p90_us,
+  round(percentile_cont(0.99) WITHIN GROUP (ORDER BY usec)::numeric, 1) AS p99_us,
+  round(max(usec)::numeric, 1) AS max_us,
+  (SELECT round(delta, 1) FROM bench_io i WHERE i.source = c.source AND key = 'syscr') AS read_syscalls,
+  (SELECT round(delta) FROM bench_io i WHERE i.source = c.source AND key = 'rchar') AS bytes_read
+FROM bench_call c
+GROUP BY c.source
+ORDER BY c.source;
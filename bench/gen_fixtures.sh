@@ -0,0 +1,268 @@
+#!/bin/sh
+#
+# gen_fixtures.sh
+#
+# Generate a synthetic procfs and cgroupfs tree for benchmarking the
+# pgnodemx parsers. Point pgnodemx.procroot at <outdir>/proc,
+# pgnodemx.cgrouproot at <outdir>/cgroup, and pgnodemx.kdapi_path at
+# <outdir>/podinfo.
+#
+# The per-backend part of the tree hangs off the postmaster pid, which
+# is only known once the server is running. Run once without -P to build
+# the static part before starting the server, and once more with -P
+# afterwards to add the backends.
+#
+# This code is released under the PostgreSQL license.
+#
+# Copyright 2020-2025 Crunchy Data Solutions, Inc.
+#
+
+set -e
+
+usage()
+{
+	cat <<EOF
+usage: $0 -o outdir [-P postmaster_pid] [-n npids] [-d ndisks]
+          [-m nmounts] [-l nlabels] [-c v1|v2]
+
+  -o  output directory (created if needed)
+  -P  postmaster pid; generate the per-backend files only
+  -n  number of backend pids (default 100)
+  -d  number of block devices in diskstats and io.stat (default 10)
+  -m  number of mountinfo lines (default 30)
+  -l  number of Downward API labels (default 10)
+  -c  cgroup layout, v1 or v2 (default v2)
+EOF
+	exit 1
+}
+
+outdir=
+ppid=
+npids=100
+ndisks=10
+nmounts=30
+nlabels=10
+cgmode=v2
+
+while getopts "o:P:n:d:m:l:c:" opt
+do
+	case $opt in
+		o) outdir=$OPTARG ;;
+		P) ppid=$OPTARG ;;
+		n) npids=$OPTARG ;;
+		d) ndisks=$OPTARG ;;
+		m) nmounts=$OPTARG ;;
+		l) nlabels=$OPTARG ;;
+		c) cgmode=$OPTARG ;;
+		*) usage ;;
+	esac
+done
+
+[ -n "$outdir" ] || usage
+[ "$cgmode" = v1 ] || [ "$cgmode" = v2 ] || usage
+
+proc=$outdir/proc
+cg=$outdir/cgroup
+podinfo=$outdir/podinfo
+
+# first synthetic backend pid; keep clear of the real pid range
+pidbase=4000000
+
+#
+# per-backend files: <ppid>/task/<ppid>/children and <pid>/{stat,io,cmdline}
+#
+if [ -n "$ppid" ]
+then
+	mkdir -p "$proc/$ppid/task/$ppid"
+	awk -v proc="$proc" -v ppid="$ppid" -v npids="$npids" -v base="$pidbase" '
+	BEGIN {
+		children = ""
+		for (i = 0; i < npids; i++)
+		{
+			pid = base + i
+			children = children pid " "
+			dir = proc "/" pid
+			system("mkdir -p " dir)
+
+			f = dir "/stat"
+			printf "%d (postgres) S %d %d %d 0 -1 4194560 %d 0 %d 0 %d %d 0 0 20 0 1 0 %d 228405248 %d 18446744073709551615 94555384160256 94555392158965 140727035838608 0 0 0 4194304 19935239 0 0 0 0 17 %d 0 0 %d 0 0 94555394394992 94555394511624 94555418628096 140727035843466 140727035843518 140727035843518 140727035846616 0\n", pid, ppid, pid, pid, 1000 + i, 10 + i % 7, 200 + i, 100 + i, 12345678 + i, 2000 + i, i % 64, i % 13 > f
+			close(f)
+
+			f = dir "/io"
+			printf "rchar: %d\nwchar: %d\nsyscr: %d\nsyscw: %d\nread_bytes: %d\nwrite_bytes: %d\ncancelled_write_bytes: %d\n", 1000000 + i, 500000 + i, 3000 + i, 1500 + i, 81920 * i, 40960 * i, 0 > f
+			close(f)
+
+			f = dir "/cmdline"
+			printf "postgres: bench bench [local] idle" > f
+			close(f)
+		}
+		f = proc "/" ppid "/task/" ppid "/children"
+		print children > f
+		close(f)
+	}'
+	exit 0
+fi
+
+#
+# static procfs files
+#
+mkdir -p "$proc/self/net"
+
+awk -v ndisks="$ndisks" 'BEGIN {
+	for (i = 0; i < ndisks; i++)
+		printf "%4d %7d nvme%dn1 %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d\n", 259, i, i, 1000 + i, i, 80000 + i, 300 + i, 2000 + i, 2 * i, 160000 + i, 900 + i, i % 4, 5000 + i, 6000 + i, i, 0, 8 * i, 1, 50 + i, 7
+}' > "$proc/diskstats"
+
+awk -v nmounts="$nmounts" 'BEGIN {
+	for (i = 0; i < nmounts; i++)
+		printf "%d %d 259:%d / /mnt/vol%d rw,noatime shared:%d - xfs /dev/nvme%dn1 rw,attr2,inode64,logbufs=8,logbsize=32k,noquota\n", 100 + i, 99, i, i, i + 1, i
+}' > "$proc/self/mountinfo"
+
+cat > "$proc/meminfo" <<EOF
+MemTotal:       65755648 kB
+MemFree:        10485760 kB
+MemAvailable:   41943040 kB
+Buffers:          524288 kB
+Cached:         30408704 kB
+SwapCached:            0 kB
+Active:         20971520 kB
+Inactive:       25165824 kB
+Active(anon):    8388608 kB
+Inactive(anon):  4194304 kB
+Active(file):   12582912 kB
+Inactive(file): 20971520 kB
+Unevictable:           0 kB
+Mlocked:               0 kB
+SwapTotal:       8388608 kB
+SwapFree:        8388608 kB
+Dirty:             65536 kB
+Writeback:             0 kB
+AnonPages:      12582912 kB
+Mapped:          8388608 kB
+Shmem:           8388608 kB
+KReclaimable:    1048576 kB
+Slab:            2097152 kB
+SReclaimable:    1048576 kB
+SUnreclaim:      1048576 kB
+KernelStack:       16384 kB
+PageTables:       262144 kB
+NFS_Unstable:          0 kB
+Bounce:                0 kB
+WritebackTmp:          0 kB
+CommitLimit:    41266432 kB
+Committed_AS:   25165824 kB
+VmallocTotal:   34359738367 kB
+VmallocUsed:       65536 kB
+VmallocChunk:          0 kB
+Percpu:            32768 kB
+HardwareCorrupted:     0 kB
+AnonHugePages:         0 kB
+ShmemHugePages:        0 kB
+ShmemPmdMapped:        0 kB
+FileHugePages:         0 kB
+FilePmdMapped:         0 kB
+HugePages_Total:       0
+HugePages_Free:        0
+HugePages_Rsvd:        0
+HugePages_Surp:        0
+Hugepagesize:       2048 kB
+Hugetlb:               0 kB
+DirectMap4k:      524288 kB
+DirectMap2M:    16777216 kB
+DirectMap1G:    50331648 kB
+EOF
+
+{
+	echo "cpu  1000000 2000 300000 90000000 40000 0 5000 0 0 0"
+	i=0
+	while [ $i -lt 16 ]
+	do
+		echo "cpu$i 62500 125 18750 5625000 2500 0 312 0 0 0"
+		i=$((i + 1))
+	done
+	echo "intr 123456789 0 0 0"
+	echo "ctxt 987654321"
+	echo "btime 1700000000"
+	echo "processes 1234567"
+	echo "procs_running 3"
+	echo "procs_blocked 0"
+} > "$proc/stat"
+
+echo "1.25 1.10 0.95 3/$((npids + 50)) $((pidbase + npids))" > "$proc/loadavg"
+
+{
+	echo "Inter-|   Receive                                                |  Transmit"
+	echo " face |bytes    packets errs drop fifo frame compressed multicast|bytes    packets errs drop fifo colls carrier compressed"
+	echo "    lo: 123456789 654321 0 0 0 0 0 0 123456789 654321 0 0 0 0 0 0"
+	echo "  eth0: 987654321 7654321 0 0 0 0 0 12 876543210 6543210 0 0 0 0 0 0"
+} > "$proc/self/net/dev"
+
+#
+# cgroup tree; pgnodemx.containerized should be set on so that the
+# controller files are found directly under pgnodemx.cgrouproot
+#
+memory_stat()
+{
+	awk 'BEGIN {
+		n = split("anon file kernel kernel_stack pagetables percpu sock vmalloc shmem zswap zswapped file_mapped file_dirty file_writeback swapcached anon_thp file_thp shmem_thp inactive_anon active_anon inactive_file active_file unevictable slab_reclaimable slab_unreclaimable slab workingset_refault_anon workingset_refault_file workingset_activate_anon workingset_activate_file workingset_restore_anon workingset_restore_file workingset_nodereclaim pgscan pgsteal pgscan_kswapd pgscan_direct pgsteal_kswapd pgsteal_direct pgfault pgmajfault pgrefill pgactivate pgdeactivate pglazyfree pglazyfreed thp_fault_alloc thp_collapse_alloc", k, " ")
+		for (i = 1; i <= n; i++)
+			printf "%s %d\n", k[i], i * 4096
+	}'
+}
+
+cgroup_procs()
+{
+	awk -v npids="$npids" -v base="$pidbase" 'BEGIN {
+		for (i = 0; i < npids; i++)
+			print base + i
+	}'
+}
+
+mkdir -p "$cg"
+if [ "$cgmode" = v2 ]
+then
+	echo "0::/" > "$proc/self/cgroup"
+	echo "cpuset cpu io memory hugetlb pids rdma misc" > "$cg/cgroup.controllers"
+	cgroup_procs > "$cg/cgroup.procs"
+	memory_stat > "$cg/memory.stat"
+	echo 8589934592 > "$cg/memory.current"
+	echo max > "$cg/memory.max"
+	echo "max 100000" > "$cg/cpu.max"
+	echo "$npids" > "$cg/pids.current"
+	printf "usage_usec 123456789\nuser_usec 100000000\nsystem_usec 23456789\nnr_periods 0\nnr_throttled 0\nthrottled_usec 0\n" > "$cg/cpu.stat"
+	awk -v ndisks="$ndisks" 'BEGIN {
+		for (i = 0; i < ndisks; i++)
+			printf "259:%d rbytes=%d wbytes=%d rios=%d wios=%d dbytes=0 dios=0\n", i, 4096000 + i, 8192000 + i, 1000 + i, 2000 + i
+	}' > "$cg/io.stat"
+else
+	printf "12:pids:/\n11:blkio:/\n10:cpu,cpuacct:/\n9:memory:/\n" > "$proc/self/cgroup"
+	mkdir -p "$cg/memory" "$cg/cpu,cpuacct" "$cg/blkio" "$cg/pids"
+	cgroup_procs > "$cg/memory/cgroup.procs"
+	memory_stat > "$cg/memory/memory.stat"
+	echo 8589934592 > "$cg/memory/memory.usage_in_bytes"
+	echo 9223372036854771712 > "$cg/memory/memory.limit_in_bytes"
+	echo 1024 > "$cg/cpu,cpuacct/cpu.shares"
+	echo -1 > "$cg/cpu,cpuacct/cpu.cfs_quota_us"
+	echo 123456789000 > "$cg/cpu,cpuacct/cpuacct.usage"
+	printf "nr_periods 0\nnr_throttled 0\nthrottled_time 0\n" > "$cg/cpu,cpuacct/cpu.stat"
+	echo "$npids" > "$cg/pids/pids.current"
+	awk -v ndisks="$ndisks" 'BEGIN {
+		split("Read Write Sync Async Total", op, " ")
+		for (i = 0; i < ndisks; i++)
+			for (j = 1; j <= 5; j++)
+				printf "259:%d %s %d\n", i, op[j], 1000 * j + i
+		printf "Total %d\n", 15000 * ndisks
+	}' > "$cg/blkio/blkio.throttle.io_serviced"
+fi
+
+#
+# Kubernetes Downward API files
+#
+mkdir -p "$podinfo"
+awk -v nlabels="$nlabels" 'BEGIN {
+	for (i = 0; i < nlabels; i++)
+		printf "label%d=\"value-%d\"\n", i, i
+}' > "$podinfo/labels"
+printf 'kubernetes.io/config.source="api"\nstatus="{\\"phase\\":\\"Running\\",\\"conditions\\":[{\\"type\\":\\"Ready\\",\\"status\\":\\"True\\"}]}"\n' > "$podinfo/annotations"
+echo 4 > "$podinfo/cpu_limit"
+echo 8589934592 > "$podinfo/mem_limit"
@@ -0,0 +1,579 @@
+/*
+ * parsebench.c
+ *
+ * Standalone microbenchmark for the parsing core in parseutils.c.
+ * Built against the stand-in headers in bench/shim, so no server is
+ * needed: palloc is a counting bump allocator which is reset between
+ * iterations, and read_vfs() hands back a copy of a recorded input
+ * loaded once at startup, so file system cost is excluded.
+ *
+ * usage: parsebench [-i iters] fixturedir
+ *
+ * fixturedir is a tree produced by gen_fixtures.sh (run it with -P too,
+ * to get a pid stat file), or any directory laid out the same way, e.g.
+ * a copy of files from a real host. Inputs which are missing are skipped.
+ *
+ * Reports ns/line, input bytes per TSC cycle, and palloc calls and
+ * bytes per line for each parser.
+ *
+ * This code is released under the PostgreSQL license.
+ *
+ * Copyright 2020-2025 Crunchy Data Solutions, Inc.
+ */
+
+#include "postgres.h"
+
+#include <dirent.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_RDTSC
+#endif
+
+#include "mb/pg_wchar.h"
+#include "fileutils.h"
+#include "parseutils.h"
+#include "stats.h"
+
+/*
+ * Counting bump allocator standing in for a memory context
+ */
+#define ARENA_BLOCK_SIZE	(8 * 1024 * 1024)
+
+typedef struct ArenaBlock
+{
+	struct ArenaBlock  *next;
+	Size				used;
+	Size				size;
+	char				data[];
+} ArenaBlock;
+
+typedef struct ChunkHeader
+{
+	Size		size;
+	Size		pad;	/* keep the payload 16-byte aligned */
+} ChunkHeader;
+
+static ArenaBlock *arena = NULL;
+static uint64 nallocs = 0;
+static uint64 nallocbytes = 0;
+
+static void
+arena_reset(void)
+{
+	ArenaBlock *blk = arena;
+
+	/* keep the first block around, free the rest */
+	while (blk && blk->next)
+	{
+		ArenaBlock *next = blk->next;
+
+		free(blk);
+		blk = next;
+	}
+	arena = blk;
+	if (arena)
+		arena->used = 0;
+}
+
+void *
+palloc(Size size)
+{
+	Size		need = sizeof(ChunkHeader) + ((size + 15) & ~((Size) 15));
+	ChunkHeader *hdr;
+
+	if (arena == NULL || arena->size - arena->used < need)
+	{
+		Size		bsize = need > ARENA_BLOCK_SIZE ? need : ARENA_BLOCK_SIZE;
+		ArenaBlock *blk = malloc(sizeof(ArenaBlock) + bsize);
+
+		if (blk == NULL)
+		{
+			fprintf(stderr, "parsebench: out of memory\n");
+			exit(1);
+		}
+		blk->next = arena;
+		blk->used = 0;
+		blk->size = bsize;
+		arena = blk;
+	}
+
+	hdr = (ChunkHeader *) (arena->data + arena->used);
+	hdr->size = size;
+	arena->used += need;
+
+	nallocs++;
+	nallocbytes += size;
+
+	return hdr + 1;
+}
+
+void *
+palloc0(Size size)
+{
+	void	   *p = palloc(size);
+
+	memset(p, 0, size);
+	return p;
+}
+
+void *
+repalloc(void *pointer, Size size)
+{
+	ChunkHeader *hdr = ((ChunkHeader *) pointer) - 1;
+	void	   *p;
+
+	if (size <= hdr->size)
+	{
+		hdr->size = size;
+		nallocs++;
+		return pointer;
+	}
+
+	p = palloc(size);
+	memcpy(p, pointer, hdr->size);
+	return p;
+}
+
+char *
+pstrdup(const char *in)
+{
+	Size		len = strlen(in) + 1;
+	char	   *out = palloc(len);
+
+	memcpy(out, in, len);
+	return out;
+}
+
+void
+pfree(void *pointer)
+{
+	/* released on the next arena_reset() */
+}
+
+/*
+ * Self-instrumentation is a server feature; the benchmark reports
+ * its own numbers
+ */
+void
+stats_lines_parsed(int nlines)
+{
+}
+
+/*
+ * ereport() support; any ERROR is fatal to the benchmark
+ */
+int
+errcode(int sqlerrcode)
+{
+	return 0;
+}
+
+int
+errcode_for_file_access(void)
+{
+	return 0;
+}
+
+int
+errmsg(const char *fmt,...)
+{
+	va_list		ap;
+
+	fprintf(stderr, "parsebench: ");
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	fprintf(stderr, "\n");
+	return 0;
+}
+
+int
+errdetail(const char *fmt,...)
+{
+	va_list		ap;
+
+	fprintf(stderr, "DETAIL: ");
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	fprintf(stderr, "\n");
+	return 0;
+}
+
+void
+errfinish(int elevel)
+{
+	if (elevel >= ERROR)
+		exit(1);
+}
+
+/*
+ * UTF8 only, which is all parse_quoted_string() needs from us
+ */
+int
+pg_wchar2mb_with_len(const pg_wchar *from, char *to, int len)
+{
+	int			cnt = 0;
+
+	for (; len > 0 && *from; len--, from++)
+	{
+		pg_wchar	c = *from;
+
+		if (c <= 0x7F)
+			to[cnt++] = c;
+		else if (c <= 0x7FF)
+		{
+			to[cnt++] = 0xC0 | (c >> 6);
+			to[cnt++] = 0x80 | (c & 0x3F);
+		}
+		else if (c <= 0xFFFF)
+		{
+			to[cnt++] = 0xE0 | (c >> 12);
+			to[cnt++] = 0x80 | ((c >> 6) & 0x3F);
+			to[cnt++] = 0x80 | (c & 0x3F);
+		}
+		else
+		{
+			to[cnt++] = 0xF0 | (c >> 18);
+			to[cnt++] = 0x80 | ((c >> 12) & 0x3F);
+			to[cnt++] = 0x80 | ((c >> 6) & 0x3F);
+			to[cnt++] = 0x80 | (c & 0x3F);
+		}
+	}
+	to[cnt] = '\0';
+
+	return cnt;
+}
+
+/*
+ * Recorded inputs; read_vfs() returns a fresh copy on each call since
+ * the parsers tokenize in place
+ */
+#define MAX_INPUTS	16
+
+typedef struct RecordedInput
+{
+	char	   *path;
+	char	   *data;
+	Size		len;
+} RecordedInput;
+
+static RecordedInput inputs[MAX_INPUTS];
+static int ninputs = 0;
+
+static RecordedInput *
+load_input(const char *path)
+{
+	FILE	   *file;
+	RecordedInput *in;
+	Size		cap = 4096;
+
+	if (ninputs == MAX_INPUTS || (file = fopen(path, "r")) == NULL)
+		return NULL;
+
+	in = &inputs[ninputs++];
+	in->path = strdup(path);
+	in->data = malloc(cap);
+	in->len = 0;
+	for (;;)
+	{
+		Size		rbytes = fread(in->data + in->len, 1, cap - in->len - 1, file);
+
+		in->len += rbytes;
+		if (rbytes == 0)
+			break;
+		if (cap - in->len - 1 == 0)
+		{
+			cap *= 2;
+			in->data = realloc(in->data, cap);
+		}
+	}
+	in->data[in->len] = '\0';
+	fclose(file);
+
+	return in;
+}
+
+char *
+read_vfs(char *filename)
+{
+	int			i;
+
+	for (i = 0; i < ninputs; i++)
+	{
+		if (strcmp(inputs[i].path, filename) == 0)
+		{
+			char	   *buf = palloc(inputs[i].len + 1);
+
+			memcpy(buf, inputs[i].data, inputs[i].len + 1);
+			return buf;
+		}
+	}
+
+	fprintf(stderr, "parsebench: no recorded input for \"%s\"\n", filename);
+	exit(1);
+}
+
+/*
+ * Per-file drivers; each mirrors what the corresponding SRF does with
+ * the lines, minus building the tuplestore. Return the line count.
+ */
+static int
+bench_ss(char *path, int minntok, int maxntok)
+{
+	int			nlines;
+	char	  **lines = read_nlsv(path, &nlines);
+	int			i;
+
+	for (i = 0; i < nlines; i++)
+	{
+		int			ntok;
+
+		(void) parse_ss_line(lines[i], &ntok);
+		if (ntok < minntok || ntok > maxntok)
+			ereport(ERROR,
+					(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+					errmsg("unexpected number of tokens, %d, in file %s, line %d",
+						   ntok, path, i + 1)));
+	}
+
+	return nlines;
+}
+
+static int
+bench_diskstats(char *path)
+{
+	return bench_ss(path, 14, 20);
+}
+
+static int
+bench_mountinfo(char *path)
+{
+	return bench_ss(path, 10, 64);
+}
+
+static int
+bench_kv(char *path)
+{
+	return bench_ss(path, 2, 2);
+}
+
+static int
+bench_meminfo(char *path)
+{
+	int			nlines;
+	char	  **lines = read_nlsv(path, &nlines);
+	int			i;
+
+	for (i = 0; i < nlines; i++)
+	{
+		int			ntok;
+		char	  **fkl = parse_ss_line(lines[i], &ntok);
+
+		if (ntok < 2 || ntok > 3)
+			ereport(ERROR,
+					(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+					errmsg("unexpected number of tokens, %d, in file %s, line %d",
+						   ntok, path, i + 1)));
+
+		/* strip the colon; unit conversion lives in genutils.c */
+		fkl[0][strlen(fkl[0]) - 1] = '\0';
+	}
+
+	return nlines;
+}
+
+static int
+bench_pid_stat(char *path)
+{
+	int			ntok;
+
+	(void) parse_pid_stat_line(get_string_from_file(path), &ntok);
+	if (ntok != 52)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				errmsg("expected 52 tokens, got %d in file %s", ntok, path)));
+
+	return 1;
+}
+
+static int
+bench_nested_keyed(char *path)
+{
+	int			nlines;
+	char	  **lines = read_nlsv(path, &nlines);
+	int			i;
+
+	for (i = 0; i < nlines; i++)
+		(void) parse_nested_keyed_line(lines[i]);
+
+	return nlines;
+}
+
+static int
+bench_keqv(char *path)
+{
+	int			nlines;
+	char	  **lines = read_nlsv(path, &nlines);
+	int			i;
+
+	for (i = 0; i < nlines; i++)
+		(void) parse_keqv_line(lines[i]);
+
+	return nlines;
+}
+
+/*
+ * The first pid directory under proc which has a stat file
+ */
+static char *
+find_pid_stat(const char *fixturedir)
+{
+	char		path[4096];
+	DIR		   *dir;
+	struct dirent *de;
+	char	   *result = NULL;
+
+	snprintf(path, sizeof(path), "%s/proc", fixturedir);
+	if ((dir = opendir(path)) == NULL)
+		return NULL;
+
+	while (result == NULL && (de = readdir(dir)) != NULL)
+	{
+		if (strspn(de->d_name, "0123456789") != strlen(de->d_name))
+			continue;
+		snprintf(path, sizeof(path), "%s/proc/%s/stat", fixturedir, de->d_name);
+		if (access(path, R_OK) == 0)
+			result = strdup(path);
+	}
+	closedir(dir);
+
+	return result;
+}
+
+static uint64
+now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static uint64
+now_cycles(void)
+{
+#ifdef HAVE_RDTSC
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+static void
+run_one(const char *name, char *path, int (*fn) (char *), int iters)
+{
+	RecordedInput *in;
+	uint64		t0,
+				t1,
+				c0,
+				c1;
+	uint64		lines = 0;
+	uint64		a0,
+				b0;
+	int			i;
+
+	if (path == NULL || (in = load_input(path)) == NULL)
+	{
+		printf("%-20s skipped, no input\n", name);
+		return;
+	}
+
+	/* warm up, and size the arena */
+	fn(path);
+	arena_reset();
+
+	a0 = nallocs;
+	b0 = nallocbytes;
+	t0 = now_ns();
+	c0 = now_cycles();
+	for (i = 0; i < iters; i++)
+	{
+		lines += fn(path);
+		arena_reset();
+	}
+	c1 = now_cycles();
+	t1 = now_ns();
+
+	if (lines == 0)
+	{
+		printf("%-20s skipped, empty input\n", name);
+		return;
+	}
+
+	printf("%-20s %8lu %10.1f ", name, (unsigned long) (lines / iters),
+		   (double) (t1 - t0) / lines);
+	if (c1 > c0)
+		printf("%10.3f ", (double) in->len * iters / (c1 - c0));
+	else
+		printf("%10s ", "-");
+	printf("%10.1f %12.1f\n", (double) (nallocs - a0) / lines,
+		   (double) (nallocbytes - b0) / lines);
+}
+
+static void
+usage(const char *progname)
+{
+	fprintf(stderr, "usage: %s [-i iters] fixturedir\n", progname);
+	exit(1);
+}
+
+int
+main(int argc, char **argv)
+{
+	int			iters = 10000;
+	int			c;
+	char	   *dir;
+	char		path[4096];
+
+	while ((c = getopt(argc, argv, "i:")) != -1)
+	{
+		switch (c)
+		{
+			case 'i':
+				iters = atoi(optarg);
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+	if (optind != argc - 1 || iters <= 0)
+		usage(argv[0]);
+	dir = argv[optind];
+
+	printf("%-20s %8s %10s %10s %10s %12s\n",
+		   "input", "lines", "ns/line", "bytes/cyc", "allocs/line", "abytes/line");
+
+#define RUN(name, rel, fn) \
+	do { \
+		snprintf(path, sizeof(path), "%s/%s", dir, rel); \
+		run_one(name, strdup(path), fn, iters); \
+	} while (0)
+
+	RUN("diskstats", "proc/diskstats", bench_diskstats);
+	RUN("mountinfo", "proc/self/mountinfo", bench_mountinfo);
+	RUN("meminfo", "proc/meminfo", bench_meminfo);
+	run_one("pid stat", find_pid_stat(dir), bench_pid_stat, iters);
+	/* only one of these exists, depending on the cgroup layout */
+	RUN("memory.stat (v2)", "cgroup/memory.stat", bench_kv);
+	RUN("memory.stat (v1)", "cgroup/memory/memory.stat", bench_kv);
+	RUN("io.stat", "cgroup/io.stat", bench_nested_keyed);
+	RUN("labels", "podinfo/labels", bench_keqv);
+	RUN("annotations", "podinfo/annotations", bench_keqv);
+
+	return 0;
+}
@@ -0,0 +1,81 @@
+#!/bin/sh
+#
+# run_bench.sh
+#
+# Build a synthetic procfs/cgroupfs tree with gen_fixtures.sh, start a
+# throwaway cluster with pgnodemx pointed at it, and run bench.sql.
+# pgnodemx must already be installed into the PostgreSQL found via
+# pg_config (or $PATH).
+#
+# Tunables, via the environment:
+#   BENCH_NPIDS    number of synthetic backend pids (default 100)
+#   BENCH_NDISKS   number of block devices (default 10)
+#   BENCH_NMOUNTS  number of mountinfo lines (default 30)
+#   BENCH_NLABELS  number of Downward API labels (default 10)
+#   BENCH_CGMODE   v1, v2, or both (default both)
+#   BENCH_ITERS    calls per function (default 1000)
+#   BENCH_OUTPUT   results file (default bench_output.txt)
+#
+# This code is released under the PostgreSQL license.
+#
+# Copyright 2020-2025 Crunchy Data Solutions, Inc.
+#
+
+set -e
+
+npids=${BENCH_NPIDS:-100}
+ndisks=${BENCH_NDISKS:-10}
+nmounts=${BENCH_NMOUNTS:-30}
+nlabels=${BENCH_NLABELS:-10}
+cgmodes=${BENCH_CGMODE:-both}
+iters=${BENCH_ITERS:-1000}
+output=${BENCH_OUTPUT:-bench_output.txt}
+
+[ "$cgmodes" = both ] && cgmodes="v1 v2"
+
+benchdir=$(cd "$(dirname "$0")" && pwd)
+bindir=$(pg_config --bindir 2>/dev/null || dirname "$(command -v postgres)")
+workdir=$(mktemp -d "${TMPDIR:-/tmp}/pgnodemx_bench.XXXXXX")
+pgdata=$workdir/data
+
+cleanup()
+{
+	"$bindir/pg_ctl" -D "$pgdata" -m immediate stop >/dev/null 2>&1 || true
+	rm -rf "$workdir"
+}
+trap cleanup EXIT INT TERM
+
+"$bindir/initdb" -D "$pgdata" -A trust -U postgres >/dev/null
+
+: > "$output"
+for cgmode in $cgmodes
+do
+	fixtures=$workdir/fixtures_$cgmode
+	sh "$benchdir/gen_fixtures.sh" -o "$fixtures" -c "$cgmode" \
+		-n "$npids" -d "$ndisks" -m "$nmounts" -l "$nlabels"
+
+	cat > "$pgdata/postgresql.auto.conf" <<EOF
+listen_addresses = ''
+unix_socket_directories = '$workdir'
+shared_preload_libraries = 'pgnodemx'
+pgnodemx.procroot = '$fixtures/proc'
+pgnodemx.cgrouproot = '$fixtures/cgroup'
+pgnodemx.containerized = on
+pgnodemx.kdapi_path = '$fixtures/podinfo'
+EOF
+
+	"$bindir/pg_ctl" -D "$pgdata" -l "$workdir/server_$cgmode.log" -w start >/dev/null
+	ppid=$(head -1 "$pgdata/postmaster.pid")
+	sh "$benchdir/gen_fixtures.sh" -o "$fixtures" -c "$cgmode" \
+		-n "$npids" -P "$ppid"
+
+	{
+		echo "== cgroup $cgmode, npids=$npids ndisks=$ndisks nmounts=$nmounts nlabels=$nlabels iters=$iters"
+		"$bindir/psql" -X -h "$workdir" -U postgres -d postgres \
+			-v iters="$iters" -v cgmode="$cgmode" -f "$benchdir/bench.sql"
+	} >> "$output" 2>&1
+
+	"$bindir/pg_ctl" -D "$pgdata" -w stop >/dev/null
+done
+
+cat "$output"
@@ -0,0 +1,12 @@
+/*
+ * fmgr.h
+ *
+ * Stand-in for the server header; see postgres.h in this directory.
+ */
+
+#ifndef PARSEBENCH_FMGR_H
+#define PARSEBENCH_FMGR_H
+
+typedef struct FunctionCallInfoBaseData *FunctionCallInfo;
+
+#endif	/* PARSEBENCH_FMGR_H */
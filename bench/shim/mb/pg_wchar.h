@@ -0,0 +1,15 @@
+/*
+ * mb/pg_wchar.h
+ *
+ * Stand-in for the server header; see postgres.h in this directory.
+ * The benchmark always runs as if the database encoding were UTF8.
+ */
+
+#ifndef PARSEBENCH_PG_WCHAR_H
+#define PARSEBENCH_PG_WCHAR_H
+
+typedef unsigned int pg_wchar;
+
+extern int	pg_wchar2mb_with_len(const pg_wchar *from, char *to, int len);
+
+#endif	/* PARSEBENCH_PG_WCHAR_H */
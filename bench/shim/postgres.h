@@ -0,0 +1,66 @@
+/*
+ * postgres.h
+ *
+ * Minimal stand-in for the server headers, just enough to compile
+ * parseutils.c into the standalone parser benchmark. palloc and friends
+ * are backed by a bump allocator in parsebench.c which counts calls and
+ * bytes, and is reset between iterations the way a memory context would
+ * be. ereport(ERROR) prints the message and exits.
+ *
+ * This code is released under the PostgreSQL license.
+ *
+ * Copyright 2020-2025 Crunchy Data Solutions, Inc.
+ */
+
+#ifndef PARSEBENCH_POSTGRES_H
+#define PARSEBENCH_POSTGRES_H
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+/* parseutils.c only needs to know it is on a 15+ server */
+#define PG_VERSION_NUM 150000
+
+typedef int64_t int64;
+typedef uint64_t uint64;
+typedef uint32_t uint32;
+typedef size_t Size;
+
+#define PG_INT64_MAX INT64_MAX
+#define Assert(condition) ((void) 0)
+#define strtoi64(str, endptr, base) ((int64) strtoll(str, endptr, base))
+
+/* only referenced from prototypes in fileutils.h */
+typedef struct varlena text;
+
+extern void *palloc(Size size);
+extern void *palloc0(Size size);
+extern void *repalloc(void *pointer, Size size);
+extern char *pstrdup(const char *in);
+extern void pfree(void *pointer);
+
+#define LOG			15
+#define WARNING		19
+#define ERROR		21
+
+#define ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE	0
+#define ERRCODE_INVALID_TEXT_REPRESENTATION			0
+
+extern int	errcode(int sqlerrcode);
+extern int	errcode_for_file_access(void);
+extern int	errmsg(const char *fmt,...);
+extern int	errdetail(const char *fmt,...);
+extern void errfinish(int elevel);
+
+#define ereport(elevel, rest) \
+	do { \
+		(void) rest; \
+		errfinish(elevel); \
+	} while (0)
+
+#endif	/* PARSEBENCH_POSTGRES_H */
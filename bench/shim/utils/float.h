@@ -0,0 +1,13 @@
+/*
+ * utils/float.h
+ *
+ * Stand-in for the server header; see postgres.h in this directory.
+ */
+
+#ifndef PARSEBENCH_FLOAT_H
+#define PARSEBENCH_FLOAT_H
+
+#define float8in_internal(num, endptr_p, type_name, orig_string) \
+	strtod(num, endptr_p)
+
+#endif	/* PARSEBENCH_FLOAT_H */
@@ -47,14 +47,18 @@
 #include "catalog/pg_type.h"
 #endif
 #include "fmgr.h"
-#if PG_VERSION_NUM >= 130000
-#include "lib/qunique.h"
-#else	/* did not exist prior to pg13; use local copy */
-#include "qunique.h"
-#endif
 #include "lib/stringinfo.h"
+#if PG_VERSION_NUM >= 120000
+#include "port/pg_bitutils.h"
+#endif
+#include "storage/fd.h"
+#include "storage/ipc.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
 #include "utils/builtins.h"
+#include "miscadmin.h"
 #include "utils/guc_tables.h"
+#include "utils/hsearch.h"
 #include "utils/memutils.h"
 #if PG_VERSION_NUM >= 100000
 #include "utils/varlena.h"
@@ -62,6 +66,7 @@
 #include "fileutils.h"
 #include "genutils.h"
 #include "parseutils.h"
+#include "stats.h"
 #include "cgroup.h"
 
 #define DEFCONTROLLER	"memory"
@@ -71,6 +76,14 @@ static void create_default_cgpath(char *str, int curlen);
 static void init_or_reset_cgpath(void);
 static StringInfo candidate_controller_path(char *controller, char *r);
 static StringInfo check_and_fix_controller_path(char *controller, char *r);
+static char *lookup_cgpath_value(char *key);
+static char *proc_pid_cgroup(const char *pid, char **controller);
+static char *backend_cgroup_dir(char *rel, char *controller,
+								const char *pm_rel, const char *pm_dir);
+static void read_cgroup_cpu_stat(const char *dir, char **stat);
+static char *cg_nsec_to_usec(const char *val);
+static void cgmembers_shmem_request(void);
+static void cgmembers_shmem_startup(void);
 
 /* custom GUC vars */
 bool	containerized = false;
@@ -81,6 +94,27 @@ bool cgroup_enabled = true;
 char *cgmode = NULL;
 kvpairs *cgpath = NULL;
 
+/*
+ * The membership of the cgroup as of the last cgroup_members_delta()
+ * call, shared by all backends. It is empty until the first call.
+ */
+#define PGNX_CGMEMBERS_MAX		16384
+#define PGNX_CGMEMBERS_TRANCHE	"pgnodemx cgroup members"
+
+typedef struct pgnxCgMembersShared
+{
+	LWLock		   *lock;		/* protects everything below */
+	int				npids;
+	int64			pids[PGNX_CGMEMBERS_MAX];	/* sorted, distinct */
+} pgnxCgMembersShared;
+
+static pgnxCgMembersShared *pgnx_cgmembers = NULL;
+
+#if PG_VERSION_NUM >= 150000
+static shmem_request_hook_type prev_shmem_request_hook = NULL;
+#endif
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+
 /*
  * Take input filename from caller, make sure it is acceptable
  * (not absolute, no relative parent references, caller belongs
@@ -114,75 +148,128 @@ get_fq_cgroup_path(FunctionCallInfo fcinfo)
  * Find out all the pids in a cgroup.
  * 
  * In cgroup v2 (at least) cgroup.procs is not sorted or guaranteed unique.
- * Remedy that. *pids is set to point to a palloc'd array containing
- * distinct pids in sorted order. The length of the array is the
- * function result. Cribbed from aclmembers.
+ * Remedy that. If pids is not NULL, *pids is set to point to a palloc'd
+ * array containing distinct pids in sorted order. The number of distinct
+ * pids is the function result.
+ *
+ * The file is parsed in place in one pass, and duplicates are found with
+ * a bitmap spanning the smallest to the largest pid seen, which pid_max
+ * keeps small. Walking that bitmap gives the pids in sorted order, so
+ * there is no need to sort, and nothing at all is done for a count.
  */
 int
 cgmembers(int64 **pids)
 {
 	int64	   *list;
-	int			i;
+	int			nlist = 0;
+	int			maxlist = 1;
+	int64		minpid = PG_INT64_MAX;
+	int64		maxpid = 0;
+	uint64	   *bitmap;
+	int64		nwords;
+	int			result = 0;
+	int64		i;
 	StringInfo	ftr = makeStringInfo();
-	int			nlines;
-	char	  **lines;
+	char	   *rawstr;
+	char	   *p;
 
 	appendStringInfo(ftr, "%s/%s", get_cgpath_value("cgroup"), "cgroup.procs");
-	lines = read_nlsv(ftr->data, &nlines);
+	rawstr = read_vfs(ftr->data);
 
-	if (nlines == 0)
+	/* one pid per line, so the newlines bound the number of pids */
+	for (p = rawstr; *p != '\0'; p++)
 	{
-		/*
-		 * This should never happen, by definition. If it does
-		 * die horribly...
-		 */
-		ereport(ERROR,
-				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
-				errmsg("pgnodemx: no cgroup procs found in file %s", ftr->data)));
+		if (*p == '\n')
+			maxlist++;
 	}
-
-	/* Allocate the worst-case space requirement */
-	list = (int64 *) palloc(nlines * sizeof(int64));
+	list = (int64 *) palloc(maxlist * sizeof(int64));
 
 	/*
-	 * Walk the string array collecting PIDs.
+	 * Walk the buffer collecting PIDs.
 	 */
-	for (i = 0; i < nlines; i++)
+	for (p = rawstr; *p != '\0'; )
 	{
-		bool	success = false;
-		int64	result;
-#if PG_VERSION_NUM >= 150000
-		char   *endptr = NULL;
-#endif
+		char	   *endptr;
+		int64		pid;
+
+		if (*p == '\n')
+		{
+			p++;
+			continue;
+		}
 
-#if PG_VERSION_NUM < 150000
-		success = scanint8(lines[i], true, &result);
-#else
 		errno = 0;
-		result = strtoi64(lines[i], &endptr, 10);
-		if (errno == 0 && *endptr == '\0')
-			success = true;
-#endif
-		if (!success)
+		pid = strtoll(p, &endptr, 10);
+		if (errno != 0 || endptr == p || pid < 0 ||
+			(*endptr != '\n' && *endptr != '\0'))
 			ereport(ERROR,
 					(errcode_for_file_access(),
 					errmsg("contents not an integer, file \"%s\"",
 					ftr->data)));
 
-		list[i] = result;
+		list[nlist++] = pid;
+		minpid = Min(minpid, pid);
+		maxpid = Max(maxpid, pid);
+		p = endptr;
 	}
+	stats_lines_parsed(nlist);
 
-	/* Sort the array */
-	qsort(list, nlines, sizeof(int64), int64_cmp);
+	if (nlist == 0)
+	{
+		/*
+		 * This should never happen, by definition. If it does
+		 * die horribly...
+		 */
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				errmsg("pgnodemx: no cgroup procs found in file %s", ftr->data)));
+	}
 
-	/*
-	 * We could repalloc the array down to minimum size, but it's hardly worth
-	 * it since it's only transient memory.
-	 */
-	*pids = list;
+	nwords = (maxpid - minpid) / 64 + 1;
+	bitmap = (uint64 *) palloc0(nwords * sizeof(uint64));
+	for (i = 0; i < nlist; i++)
+	{
+		int64		off = list[i] - minpid;
+		uint64		bit = UINT64CONST(1) << (off % 64);
+
+		if ((bitmap[off / 64] & bit) == 0)
+		{
+			bitmap[off / 64] |= bit;
+			result++;
+		}
+	}
+
+	if (pids != NULL)
+	{
+		int			n = 0;
+
+		/*
+		 * Reuse list, the distinct pids are no more than all of them. The
+		 * bitmap is walked a word at a time, skipping empty words and
+		 * taking the set bits of the others lowest first.
+		 */
+		for (i = 0; i < nwords; i++)
+		{
+			uint64		word = bitmap[i];
+
+			while (word != 0)
+			{
+				int			bit;
+
+#if PG_VERSION_NUM >= 120000
+				bit = pg_rightmost_one_pos64(word);
+#else
+				for (bit = 0; (word & (UINT64CONST(1) << bit)) == 0; bit++)
+					;
+#endif
+				list[n++] = minpid + i * 64 + bit;
+				word &= word - 1;
+			}
+		}
+		*pids = list;
+	}
 
-	/* Remove duplicates from the array, returns new size */
-	return qunique(list, nlines, sizeof(int64), int64_cmp);
+	return result;
 }
 
 /*
@@ -371,6 +458,33 @@ set_cgmode(void)
 			return true;
 		}
 	}
+	else if (strcmp(cgrouproot, CGROUPROOT) != 0)
+	{
+		StringInfo		str = makeStringInfo();
+
+		/*
+		 * A non-default cgrouproot which is not a cgroup mount is
+		 * presumably a captured snapshot of a cgroup tree. Infer the
+		 * mode from the layout: only the unified hierarchy has a
+		 * cgroup.controllers file at its root.
+		 */
+		appendStringInfo(str, "%s/%s", cgrouproot, "cgroup.controllers");
+
+		ereport(LOG,
+				(errmsg("pgnodemx: cgroup root %s is not a cgroup mount", cgrouproot),
+				errdetail("treating it as a captured snapshot of a cgroup tree")));
+
+		if (access(str->data, F_OK) == 0)
+		{
+			cgmode = MemoryContextStrdup(TopMemoryContext, CGROUP_V2);
+			return true;
+		}
+		else
+		{
+			cgmode = MemoryContextStrdup(TopMemoryContext, CGROUP_V1);
+			return true;
+		}
+	}
 	else
 	{
 		/*
@@ -912,6 +1026,23 @@ set_cgpath(void)
  */
 char *
 get_cgpath_value(char *key)
+{
+	char   *path = lookup_cgpath_value(key);
+
+	/* bad request if not found */
+	if (path == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("failed to find controller %s", key)));
+
+	return path;
+}
+
+/*
+ * As above, returning NULL if not found
+ */
+static char *
+lookup_cgpath_value(char *key)
 {
 	int		i;
 
@@ -950,11 +1081,463 @@ get_cgpath_value(char *key)
 		}
 	}
 
-	/* bad request if not found */
-	ereport(ERROR,
-			(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
-			 errmsg("failed to find controller %s", key)));
+	return NULL;
+}
+
+/*
+ * Build the rows for the cgroup_files foreign table: one row per
+ * "<controller>.<name>" file found in the cgroup directory of each
+ * controller, along with its contents. If controllers is not NIL, only
+ * the listed controllers are scanned. File contents are only read if
+ * flagged in needed (or needed is NULL), and are NULL for files which
+ * cannot be read, e.g. write-only control files.
+ */
+char ***
+cgroup_files_rows(List *controllers, bool *needed, int *nrow)
+{
+	int			ncol = CGROUP_FILES_NCOL;
+	char	 ***values = (char ***) palloc(0);
+	int			i;
+
+	*nrow = 0;
+	for (i = 0; i < cgpath->nkvp; ++i)
+	{
+		char	   *path = cgpath->values[i];
+		char	   *keys = pstrdup(cgpath->keys[i]);
+		char	   *controller;
+		char	   *lstate;
+
+		/* v1 controller names may be combined, e.g. "cpu,cpuacct" */
+		for (controller = strtok_r(keys, ",", &lstate); controller;
+			 controller = strtok_r(NULL, ",", &lstate))
+		{
+			DIR			   *dir;
+			struct dirent  *de;
+			size_t			len = strlen(controller);
+
+			if (controllers != NIL && !cstring_in_list(controller, controllers))
+				continue;
+
+			/* e.g. the "cgroup" entry when no default path was found */
+			if ((dir = AllocateDir(path)) == NULL)
+				continue;
+
+			while ((de = ReadDir(dir, path)) != NULL)
+			{
+				char  **row;
+
+				if (strncmp(de->d_name, controller, len) != 0 ||
+					de->d_name[len] != '.')
+					continue;
+
+				row = (char **) palloc0(ncol * sizeof(char *));
+				row[0] = pstrdup(controller);
+				row[1] = pstrdup(de->d_name);
+				if (needed == NULL || needed[2])
+				{
+					StringInfo	fname = makeStringInfo();
+
+					appendStringInfo(fname, "%s/%s", path, de->d_name);
+					row[2] = read_file_or_null(fname->data);
+				}
+
+				values = (char ***) repalloc(values, (*nrow + 1) * sizeof(char **));
+				values[*nrow] = row;
+				*nrow += 1;
+			}
+			FreeDir(dir);
+		}
+	}
+
+	return values;
+}
+
+/*
+ * Paths of backend_cgroup(), interned so that each distinct cgroup is
+ * resolved, and its cpu stats read, only once per call.
+ */
+typedef struct cgPathEntry
+{
+	char		path[MAXPGPATH];	/* hash key, relative to the hierarchy */
+	bool		stat_done;
+	char	   *stat[BACKEND_CGROUP_NCOL - 2];
+} cgPathEntry;
+
+/*
+ * Build the rows for backend_cgroup: the cgroup of every backend from
+ * "/proc/<pid>/cgroup", read in one pass, and if include_cpu_stat, the
+ * cpu usage and throttling of that cgroup. Backends which exit while
+ * being read are skipped.
+ */
+char ***
+backend_cgroup_rows(bool include_cpu_stat, int *nrow)
+{
+	int			ncol = BACKEND_CGROUP_NCOL;
+	char	  **pids;
+	int			npids;
+	char	 ***values;
+	HASHCTL		ctl;
+	HTAB	   *paths;
+	char	   *pm_controller = NULL;
+	char	   *pm_rel;
+	char	   *pm_dir;
+	char		pmpid[32];
+	int			i;
+
+	*nrow = 0;
+	pids = get_backend_pids(&npids);
+	if (npids < 1)
+		return NULL;
+
+	memset(&ctl, 0, sizeof(ctl));
+	ctl.keysize = MAXPGPATH;
+	ctl.entrysize = sizeof(cgPathEntry);
+	ctl.hcxt = CurrentMemoryContext;
+	paths = hash_create("pgnodemx backend cgroups", 16, &ctl,
+#if PG_VERSION_NUM >= 140000
+						HASH_ELEM | HASH_STRINGS | HASH_CONTEXT);
+#else
+						HASH_ELEM | HASH_CONTEXT);
+#endif
+
+	/*
+	 * The postmaster's own cgroup, and the directory set_cgpath() found
+	 * for it, anchor the cgroups of the backends below it.
+	 */
+	snprintf(pmpid, sizeof(pmpid), "%d", (int) PostmasterPid);
+	pm_rel = proc_pid_cgroup(pmpid, &pm_controller);
+	pm_dir = lookup_cgpath_value(is_cgroup_v2 ? "cgroup" : "cpu");
+
+	values = (char ***) palloc(npids * sizeof(char **));
+	for (i = 0; i < npids; ++i)
+	{
+		char		   *controller = NULL;
+		char		   *rel = proc_pid_cgroup(pids[i], &controller);
+		cgPathEntry	   *entry;
+		bool			found;
+
+		if (rel == NULL)
+			continue;
+
+		entry = (cgPathEntry *) hash_search(paths, rel, HASH_ENTER, &found);
+		if (!found)
+		{
+			entry->stat_done = false;
+			memset(entry->stat, 0, sizeof(entry->stat));
+		}
+
+		if (include_cpu_stat && !entry->stat_done)
+		{
+			char   *dir = backend_cgroup_dir(rel, controller, pm_rel, pm_dir);
 
-	/* unreached */
-	return "unknown";
+			if (dir != NULL)
+				read_cgroup_cpu_stat(dir, entry->stat);
+			entry->stat_done = true;
+		}
+
+		values[*nrow] = (char **) palloc(ncol * sizeof(char *));
+		values[*nrow][0] = pids[i];
+		values[*nrow][1] = entry->path;
+		memcpy(&values[*nrow][2], entry->stat, sizeof(entry->stat));
+		*nrow += 1;
+	}
+
+	return values;
+}
+
+/*
+ * The cgroup of pid from "/proc/<pid>/cgroup": the line of the unified
+ * hierarchy on cgroup v2, or of the hierarchy with the cpu controller
+ * on v1, in which case *controller is set to its controller list.
+ * Returns NULL if the process has exited or has no such line.
+ */
+static char *
+proc_pid_cgroup(const char *pid, char **controller)
+{
+	StringInfo	fname = makeStringInfo();
+	char	   *rawstr;
+	char	   *line;
+	char	   *next;
+
+	appendStringInfo(fname, "%s/%s/cgroup", procroot, pid);
+	if ((rawstr = read_file_or_null(fname->data)) == NULL)
+		return NULL;
+
+	for (line = rawstr; line != NULL && *line != '\0'; line = next)
+	{
+		char	   *ctrl;
+		char	   *path;
+
+		/* lines look like "#:<controller list>:/<relative_path>" */
+		if ((next = strchr(line, '\n')) != NULL)
+			*next++ = '\0';
+		if ((ctrl = strchr(line, ':')) == NULL ||
+			(path = strchr(++ctrl, ':')) == NULL)
+			continue;
+		*path++ = '\0';
+
+		if (is_cgroup_v2)
+		{
+			if (*ctrl == '\0')
+				return path;
+		}
+		else
+		{
+			char	   *buf = pstrdup(ctrl);
+			char	   *token;
+			char	   *lstate;
+
+			for (token = strtok_r(buf, ",", &lstate); token; token = strtok_r(NULL, ",", &lstate))
+			{
+				if (strcmp(token, "cpu") == 0)
+				{
+					*controller = ctrl;
+					return path;
+				}
+			}
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Directory of the cgroup at rel. Cgroups at or below the postmaster's
+ * are found relative to the directory already resolved for it, which
+ * also works when containerized, e.g. for cgroups delegated to certain
+ * roles. Others can only be found when not containerized, since the
+ * paths are then relative to the host's hierarchy; NULL otherwise.
+ */
+static char *
+backend_cgroup_dir(char *rel, char *controller,
+				   const char *pm_rel, const char *pm_dir)
+{
+	if (pm_rel != NULL && pm_dir != NULL)
+	{
+		size_t		len = strlen(pm_rel);
+
+		if (strcmp(pm_rel, "/") == 0)
+			return psprintf("%s%s", pm_dir, strcmp(rel, "/") == 0 ? "" : rel);
+		if (strncmp(rel, pm_rel, len) == 0 &&
+			(rel[len] == '\0' || rel[len] == '/'))
+			return psprintf("%s%s", pm_dir, rel + len);
+	}
+
+	if (containerized)
+		return NULL;
+
+	if (is_cgroup_v2)
+		return psprintf("%s%s", cgrouproot, rel);
+
+	/* skip the leading "/" as set_cgpath() does */
+	return check_and_fix_controller_path(controller, rel + 1)->data;
+}
+
+/*
+ * Fill in stat with usage_usec, user_usec, system_usec, nr_throttled,
+ * and throttled_usec of the cgroup in dir. On cgroup v2 these are all
+ * in cpu.stat. On v1 the throttling is in cpu.stat, in nanoseconds,
+ * and the usage is in the cpuacct files, which are only found if cpu
+ * and cpuacct are mounted together. Values not found are left NULL.
+ */
+static void
+read_cgroup_cpu_stat(const char *dir, char **stat)
+{
+	StringInfo	fname = makeStringInfo();
+	char	   *rawstr;
+	char	   *line;
+	char	   *next;
+
+	appendStringInfo(fname, "%s/cpu.stat", dir);
+	if ((rawstr = read_file_or_null(fname->data)) != NULL)
+	{
+		for (line = rawstr; line != NULL && *line != '\0'; line = next)
+		{
+			char	   *val;
+
+			if ((next = strchr(line, '\n')) != NULL)
+				*next++ = '\0';
+			if ((val = strchr(line, ' ')) == NULL)
+				continue;
+			*val++ = '\0';
+
+			if (strcmp(line, "usage_usec") == 0)
+				stat[0] = pstrdup(val);
+			else if (strcmp(line, "user_usec") == 0)
+				stat[1] = pstrdup(val);
+			else if (strcmp(line, "system_usec") == 0)
+				stat[2] = pstrdup(val);
+			else if (strcmp(line, "nr_throttled") == 0)
+				stat[3] = pstrdup(val);
+			else if (strcmp(line, "throttled_usec") == 0)
+				stat[4] = pstrdup(val);
+			else if (strcmp(line, "throttled_time") == 0)
+				stat[4] = cg_nsec_to_usec(val);
+		}
+	}
+
+	if (is_cgroup_v2)
+		return;
+
+	resetStringInfo(fname);
+	appendStringInfo(fname, "%s/cpuacct.usage", dir);
+	stat[0] = cg_nsec_to_usec(read_file_or_null(fname->data));
+	resetStringInfo(fname);
+	appendStringInfo(fname, "%s/cpuacct.usage_user", dir);
+	stat[1] = cg_nsec_to_usec(read_file_or_null(fname->data));
+	resetStringInfo(fname);
+	appendStringInfo(fname, "%s/cpuacct.usage_sys", dir);
+	stat[2] = cg_nsec_to_usec(read_file_or_null(fname->data));
+}
+
+/*
+ * Convert a counter in nanoseconds to microseconds. NULL in, NULL out.
+ */
+static char *
+cg_nsec_to_usec(const char *val)
+{
+	char	   *endptr;
+	int64		result;
+
+	if (val == NULL)
+		return NULL;
+
+	errno = 0;
+	result = strtoll(val, &endptr, 10);
+	if (errno != 0 || endptr == val)
+		return NULL;
+
+	return int64_to_string(result / 1000);
+}
+
+/*
+ * Install the shared memory hooks for cgroup_members_delta().
+ * Must be called from _PG_init().
+ */
+void
+cgmembers_init(void)
+{
+#if PG_VERSION_NUM >= 150000
+	prev_shmem_request_hook = shmem_request_hook;
+	shmem_request_hook = cgmembers_shmem_request;
+#else
+	cgmembers_shmem_request();
+#endif
+	prev_shmem_startup_hook = shmem_startup_hook;
+	shmem_startup_hook = cgmembers_shmem_startup;
+}
+
+static void
+cgmembers_shmem_request(void)
+{
+#if PG_VERSION_NUM >= 150000
+	if (prev_shmem_request_hook)
+		prev_shmem_request_hook();
+#endif
+
+	RequestAddinShmemSpace(MAXALIGN(sizeof(pgnxCgMembersShared)));
+#if PG_VERSION_NUM >= 90600
+	RequestNamedLWLockTranche(PGNX_CGMEMBERS_TRANCHE, 1);
+#else
+	RequestAddinLWLocks(1);
+#endif
+}
+
+static void
+cgmembers_shmem_startup(void)
+{
+	bool		found;
+
+	if (prev_shmem_startup_hook)
+		prev_shmem_startup_hook();
+
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+	pgnx_cgmembers = ShmemInitStruct("pgnodemx cgroup members",
+									 sizeof(pgnxCgMembersShared), &found);
+	if (!found)
+	{
+		memset(pgnx_cgmembers, 0, sizeof(pgnxCgMembersShared));
+#if PG_VERSION_NUM >= 90600
+		pgnx_cgmembers->lock = &(GetNamedLWLockTranche(PGNX_CGMEMBERS_TRANCHE))->lock;
+#else
+		pgnx_cgmembers->lock = LWLockAssign();
+#endif
+	}
+
+	LWLockRelease(AddinShmemInitLock);
+}
+
+/*
+ * Build the rows for cgroup_members_delta: the pids which entered or
+ * left the cgroup since the previous call by any backend, found by a
+ * merge of the sorted membership saved then against the one from
+ * cgmembers() now, which then replaces it. On the first call every
+ * member has entered. Only the changed pids have "/proc/<pid>/comm"
+ * read; it is NULL for a pid which no longer exists.
+ */
+char ***
+cgroup_members_delta_rows(int *nrow)
+{
+	char	 ***values;
+	int64	   *pids;
+	int			npids;
+	int64	   *changed;
+	bool	   *entered;
+	int			nchanged = 0;
+	int			i = 0;
+	int			j = 0;
+
+	npids = cgmembers(&pids);
+	if (npids > PGNX_CGMEMBERS_MAX)
+		ereport(ERROR,
+				(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+				errmsg("pgnodemx: cgroup has %d processes, more than the %d tracked",
+					   npids, PGNX_CGMEMBERS_MAX)));
+
+	LWLockAcquire(pgnx_cgmembers->lock, LW_EXCLUSIVE);
+
+	/* at most every old pid left and every new one entered */
+	changed = (int64 *) palloc((pgnx_cgmembers->npids + npids) * sizeof(int64));
+	entered = (bool *) palloc((pgnx_cgmembers->npids + npids) * sizeof(bool));
+
+	while (i < pgnx_cgmembers->npids || j < npids)
+	{
+		if (j >= npids ||
+			(i < pgnx_cgmembers->npids && pgnx_cgmembers->pids[i] < pids[j]))
+		{
+			changed[nchanged] = pgnx_cgmembers->pids[i++];
+			entered[nchanged++] = false;
+		}
+		else if (i >= pgnx_cgmembers->npids || pids[j] < pgnx_cgmembers->pids[i])
+		{
+			changed[nchanged] = pids[j++];
+			entered[nchanged++] = true;
+		}
+		else
+		{
+			i++;
+			j++;
+		}
+	}
+
+	memcpy(pgnx_cgmembers->pids, pids, npids * sizeof(int64));
+	pgnx_cgmembers->npids = npids;
+
+	LWLockRelease(pgnx_cgmembers->lock);
+
+	values = (char ***) palloc(Max(nchanged, 1) * sizeof(char **));
+	for (i = 0; i < nchanged; ++i)
+	{
+		char	   *pid = int64_to_string(changed[i]);
+		char	   *fname = psprintf("%s/comm", pid);
+
+		values[i] = (char **) palloc(CGROUP_MEMBERS_DELTA_NCOL * sizeof(char *));
+		values[i][0] = pid;
+		values[i][1] = pstrdup(entered[i] ? "entered" : "left");
+		values[i][2] = read_file_or_null(get_fq_proc_path(fname));
+	}
+
+	*nrow = nchanged;
+	return values;
 }
@@ -33,8 +33,11 @@
 
 #include "fmgr.h"
 #include "parseutils.h"
+#include "procfunc.h"
 
-#define PROC_CGROUP_FILE	"/proc/self/cgroup"
+#define CGROUPROOT			"/sys/fs/cgroup"
+/* resolved relative to pgnodemx.procroot */
+#define PROC_CGROUP_FILE	get_fq_proc_path("self/cgroup")
 #define CGROUP_V1			"legacy"
 #define CGROUP_V2			"unified"
 #define CGROUP_HYBRID		"hybrid"
@@ -43,12 +46,23 @@
 #define is_cgroup_v2		(strcmp(cgmode, CGROUP_V2) == 0)
 #define is_cgroup_hy		(strcmp(cgmode, CGROUP_HYBRID) == 0)
 
+/* controller, filename, contents */
+#define CGROUP_FILES_NCOL	3
+/* pid, cgroup_path, and five cpu.stat counters */
+#define BACKEND_CGROUP_NCOL	7
+/* pid, change, comm */
+#define CGROUP_MEMBERS_DELTA_NCOL	3
+
 extern bool set_cgmode(void);
 extern void set_containerized(void);
 extern void set_cgpath(void);
 extern int cgmembers(int64 **pids);
 extern char *get_cgpath_value(char *key);
 extern char *get_fq_cgroup_path(FunctionCallInfo fcinfo);
+extern char ***cgroup_files_rows(List *controllers, bool *needed, int *nrow);
+extern char ***backend_cgroup_rows(bool include_cpu_stat, int *nrow);
+extern void cgmembers_init(void);
+extern char ***cgroup_members_delta_rows(int *nrow);
 
 /* exported globals */
 extern char *cgmode;
@@ -30,7 +30,51 @@
 
 #include "postgres.h"
 
+#include <ctype.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include "utils/builtins.h"
+
 #include "envutils.h"
+#include "genutils.h"
+
+extern char **environ;
+
+/*
+ * Unit suffixes accepted by env_parse_size(): Kubernetes quantities,
+ * binary and decimal, and the PostgreSQL memory units.
+ */
+typedef struct
+{
+	const char *unit;
+	double		multiplier;
+} env_size_unit;
+
+static const env_size_unit env_size_units[] = {
+	{"Ki", 1024.0},
+	{"Mi", 1024.0 * 1024},
+	{"Gi", 1024.0 * 1024 * 1024},
+	{"Ti", 1024.0 * 1024 * 1024 * 1024},
+	{"Pi", 1024.0 * 1024 * 1024 * 1024 * 1024},
+	{"Ei", 1024.0 * 1024 * 1024 * 1024 * 1024 * 1024},
+	{"k", 1e3},
+	{"M", 1e6},
+	{"G", 1e9},
+	{"T", 1e12},
+	{"P", 1e15},
+	{"E", 1e18},
+	{"kB", 1024.0},
+	{"MB", 1024.0 * 1024},
+	{"GB", 1024.0 * 1024 * 1024},
+	{"TB", 1024.0 * 1024 * 1024 * 1024},
+	{"B", 1.0},
+	{NULL, 0}
+};
+
+static bool env_parse_int64(const char *str, int64 *result);
+static bool env_parse_size(const char *str, int64 *result);
+static int env_row_cmp(const void *p1, const void *p2);
 
 char *
 get_string_from_env(char *varname)
@@ -47,3 +91,117 @@ get_string_from_env(char *varname)
 	/* never reached */
 	return "not found";
 }
+
+/*
+ * Snapshot the whole environment, or the variables whose names begin
+ * with prefix, sorted by name. Each row is name, value, and the value
+ * as BIGINT, BOOLEAN, and a size in bytes, each NULL where the value
+ * does not parse as that type.
+ */
+char ***
+get_env_rows(const char *prefix, int *nrow)
+{
+	size_t		prefixlen = strlen(prefix);
+	char	 ***values;
+	char	  **env;
+	int			n = 0;
+
+	for (env = environ; *env != NULL; ++env)
+		++n;
+	values = (char ***) palloc(Max(n, 1) * sizeof(char **));
+
+	*nrow = 0;
+	for (env = environ; *env != NULL; ++env)
+	{
+		char	   *eq = strchr(*env, '=');
+		char	  **row;
+		int64		ival;
+		bool		bval;
+
+		if (eq == NULL || strncmp(*env, prefix, prefixlen) != 0)
+			continue;
+
+		row = (char **) palloc0(ENVVAR_ALL_NCOL * sizeof(char *));
+		row[0] = pnstrdup(*env, eq - *env);
+		row[1] = pstrdup(eq + 1);
+		if (env_parse_int64(row[1], &ival))
+			row[2] = int64_to_string(ival);
+		if (parse_bool(row[1], &bval))
+			row[3] = bval ? "t" : "f";
+		if (env_parse_size(row[1], &ival))
+			row[4] = int64_to_string(ival);
+
+		values[(*nrow)++] = row;
+	}
+
+	qsort(values, *nrow, sizeof(char **), env_row_cmp);
+
+	return values;
+}
+
+static int
+env_row_cmp(const void *p1, const void *p2)
+{
+	char	  **r1 = *(char ***) p1;
+	char	  **r2 = *(char ***) p2;
+
+	return strcmp(r1[0], r2[0]);
+}
+
+/* a whole string BIGINT, without raising an error */
+static bool
+env_parse_int64(const char *str, int64 *result)
+{
+	char	   *endptr;
+	long long	val;
+
+	if (*str == '\0' || isspace((unsigned char) *str))
+		return false;
+
+	errno = 0;
+	val = strtoll(str, &endptr, 10);
+	if (errno != 0 || *endptr != '\0')
+		return false;
+
+	*result = (int64) val;
+	return true;
+}
+
+/*
+ * A non-negative size with an optional unit, e.g. "512Mi", "1.5G",
+ * "8kB", or "1024", in bytes, without raising an error.
+ */
+static bool
+env_parse_size(const char *str, int64 *result)
+{
+	char	   *endptr;
+	double		val;
+	const env_size_unit *u;
+
+	if (!isdigit((unsigned char) *str))
+		return false;
+
+	errno = 0;
+	val = strtod(str, &endptr);
+	if (errno != 0)
+		return false;
+
+	if (*endptr != '\0')
+	{
+		for (u = env_size_units; u->unit != NULL; ++u)
+		{
+			if (strcmp(endptr, u->unit) == 0)
+				break;
+		}
+		if (u->unit == NULL)
+			return false;
+		val *= u->multiplier;
+	}
+
+	val = rint(val);
+	if (val >= (double) PG_INT64_MAX)
+		return false;
+
+	*result = (int64) val;
+	return true;
+}
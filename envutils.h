@@ -31,6 +31,9 @@
 #ifndef ENVUTILS_H
 #define ENVUTILS_H
 
+#define ENVVAR_ALL_NCOL		5
+
 char *get_string_from_env(char *varname);
+char ***get_env_rows(const char *prefix, int *nrow);
 
 #endif	/* ENVUTILS_H */
@@ -0,0 +1,403 @@
+/*
+ * exitstats.c
+ *
+ * Operating system resource usage of exited backends
+ *
+ * This code is released under the PostgreSQL license.
+ *
+ * Copyright 2020-2025 Crunchy Data Solutions, Inc.
+ *
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation for any purpose, without fee, and without a written
+ * agreement is hereby granted, provided that the above copyright notice
+ * and this paragraph and the following two paragraphs appear in all copies.
+ *
+ * IN NO EVENT SHALL CRUNCHY DATA SOLUTIONS, INC. BE LIABLE TO ANY PARTY
+ * FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING LOST PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS
+ * DOCUMENTATION, EVEN IF THE CRUNCHY DATA SOLUTIONS, INC. HAS BEEN ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THE CRUNCHY DATA SOLUTIONS, INC. SPECIFICALLY DISCLAIMS ANY WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE. THE SOFTWARE PROVIDED HEREUNDER IS
+ * ON AN "AS IS" BASIS, AND THE CRUNCHY DATA SOLUTIONS, INC. HAS NO
+ * OBLIGATIONS TO PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR
+ * MODIFICATIONS.
+ */
+
+#include "postgres.h"
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "fmgr.h"
+#include "libpq/auth.h"
+#include "miscadmin.h"
+#include "replication/walsender.h"
+#include "storage/ipc.h"
+#include "storage/lwlock.h"
+#include "storage/proc.h"
+#include "storage/shmem.h"
+#include "utils/builtins.h"
+#include "utils/hsearch.h"
+
+#include "exitstats.h"
+#include "fileutils.h"
+#include "genutils.h"
+#include "procfunc.h"
+#include "srfsigs.h"
+
+/*
+ * Every client backend and walsender registers a callback once
+ * authenticated which, as the process exits, takes its cpu time, page
+ * faults, context switches and peak rss from getrusage(), its block
+ * I/O delay from /proc/<pid>/stat, and its I/O counters from
+ * /proc/<pid>/io, and adds them to shared counters keyed by database,
+ * role and backend type. Short lived connections which were never
+ * caught by proc_pid_stat() or proc_pid_io() are thereby accounted for.
+ *
+ * The counters live only as long as the server. Background workers,
+ * parallel workers and autovacuum are not authenticated and so are
+ * not counted.
+ */
+#define PGNX_EXITSTATS_MAX_ENTRIES	1024
+#define PGNX_EXITSTATS_TRANCHE		"pgnodemx exit stats"
+
+/* all fields are zero padded, for HASH_BLOBS */
+typedef struct pgnxExitStatsKey
+{
+	Oid			dbid;
+	Oid			userid;
+	char		backend_type[NAMEDATALEN];
+} pgnxExitStatsKey;
+
+/* in the order of the backend_exit_stats() columns after the key */
+typedef struct pgnxExitStatsCounters
+{
+	int64		exits;
+	int64		user_usec;
+	int64		system_usec;
+	int64		blkio_delay_usec;
+	int64		minflt;
+	int64		majflt;
+	int64		nvcsw;
+	int64		nivcsw;
+	int64		max_rss_bytes;		/* the largest, not the sum */
+	int64		rchar;
+	int64		wchar;
+	int64		syscr;
+	int64		syscw;
+	int64		read_bytes;
+	int64		write_bytes;
+	int64		cancelled_write_bytes;
+} pgnxExitStatsCounters;
+
+#define PGNX_EXITSTATS_NCOUNTERS	(sizeof(pgnxExitStatsCounters) / sizeof(int64))
+#define PGNX_EXITSTATS_NCOL			(3 + PGNX_EXITSTATS_NCOUNTERS)
+
+typedef struct pgnxExitStatsEntry
+{
+	pgnxExitStatsKey		key;
+	pgnxExitStatsCounters	counters;
+} pgnxExitStatsEntry;
+
+typedef struct pgnxExitStatsShared
+{
+	LWLock		   *lock;		/* protects the hash */
+} pgnxExitStatsShared;
+
+static pgnxExitStatsShared *pgnx_exitstats = NULL;
+static HTAB *pgnx_exitstats_hash = NULL;
+
+#if PG_VERSION_NUM >= 150000
+static shmem_request_hook_type prev_shmem_request_hook = NULL;
+#endif
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+static ClientAuthentication_hook_type prev_ClientAuthentication_hook = NULL;
+
+static void exitstats_shmem_request(void);
+static void exitstats_shmem_startup(void);
+static void exitstats_client_auth(Port *port, int status);
+static void exitstats_backend_exit(int code, Datum arg);
+static void exitstats_read_proc(pgnxExitStatsCounters *counters);
+
+Datum pgnodemx_backend_exit_stats(PG_FUNCTION_ARGS);
+Datum pgnodemx_backend_exit_stats_reset(PG_FUNCTION_ARGS);
+
+/*
+ * Install the shared memory and authentication hooks.
+ * Must be called from _PG_init().
+ */
+void
+exitstats_init(void)
+{
+#if PG_VERSION_NUM >= 150000
+	prev_shmem_request_hook = shmem_request_hook;
+	shmem_request_hook = exitstats_shmem_request;
+#else
+	exitstats_shmem_request();
+#endif
+	prev_shmem_startup_hook = shmem_startup_hook;
+	shmem_startup_hook = exitstats_shmem_startup;
+
+	prev_ClientAuthentication_hook = ClientAuthentication_hook;
+	ClientAuthentication_hook = exitstats_client_auth;
+}
+
+static void
+exitstats_shmem_request(void)
+{
+#if PG_VERSION_NUM >= 150000
+	if (prev_shmem_request_hook)
+		prev_shmem_request_hook();
+#endif
+
+	RequestAddinShmemSpace(add_size(MAXALIGN(sizeof(pgnxExitStatsShared)),
+									hash_estimate_size(PGNX_EXITSTATS_MAX_ENTRIES,
+													   sizeof(pgnxExitStatsEntry))));
+#if PG_VERSION_NUM >= 90600
+	RequestNamedLWLockTranche(PGNX_EXITSTATS_TRANCHE, 1);
+#else
+	RequestAddinLWLocks(1);
+#endif
+}
+
+static void
+exitstats_shmem_startup(void)
+{
+	bool		found;
+	HASHCTL		info;
+
+	if (prev_shmem_startup_hook)
+		prev_shmem_startup_hook();
+
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+	pgnx_exitstats = ShmemInitStruct("pgnodemx exit stats",
+									 sizeof(pgnxExitStatsShared), &found);
+	if (!found)
+	{
+#if PG_VERSION_NUM >= 90600
+		pgnx_exitstats->lock = &(GetNamedLWLockTranche(PGNX_EXITSTATS_TRANCHE))->lock;
+#else
+		pgnx_exitstats->lock = LWLockAssign();
+#endif
+	}
+
+	memset(&info, 0, sizeof(info));
+	info.keysize = sizeof(pgnxExitStatsKey);
+	info.entrysize = sizeof(pgnxExitStatsEntry);
+	pgnx_exitstats_hash = ShmemInitHash("pgnodemx exit stats hash",
+										PGNX_EXITSTATS_MAX_ENTRIES,
+										PGNX_EXITSTATS_MAX_ENTRIES,
+										&info, HASH_ELEM | HASH_BLOBS);
+
+	LWLockRelease(AddinShmemInitLock);
+}
+
+static void
+exitstats_client_auth(Port *port, int status)
+{
+	if (prev_ClientAuthentication_hook)
+		prev_ClientAuthentication_hook(port, status);
+
+	if (status == STATUS_OK)
+		before_shmem_exit(exitstats_backend_exit, (Datum) 0);
+}
+
+/*
+ * Add this backend's totals to the shared counters. Runs at exit, so
+ * nothing here may throw; whatever cannot be read is counted as zero.
+ */
+static void
+exitstats_backend_exit(int code, Datum arg)
+{
+	pgnxExitStatsKey		key;
+	pgnxExitStatsCounters	counters;
+	pgnxExitStatsEntry	   *entry;
+	struct rusage			ru;
+	bool					found;
+	int64				   *dst;
+	int64				   *src;
+	int						i;
+
+	if (pgnx_exitstats == NULL)
+		return;
+
+	memset(&key, 0, sizeof(key));
+	key.dbid = MyDatabaseId;
+	key.userid = MyProc != NULL ? MyProc->roleId : InvalidOid;
+#if PG_VERSION_NUM >= 130000
+	strlcpy(key.backend_type, GetBackendTypeDesc(MyBackendType), NAMEDATALEN);
+#else
+	strlcpy(key.backend_type, am_walsender ? "walsender" : "client backend",
+			NAMEDATALEN);
+#endif
+
+	memset(&counters, 0, sizeof(counters));
+	counters.exits = 1;
+	if (getrusage(RUSAGE_SELF, &ru) == 0)
+	{
+		counters.user_usec = (int64) ru.ru_utime.tv_sec * 1000000 + ru.ru_utime.tv_usec;
+		counters.system_usec = (int64) ru.ru_stime.tv_sec * 1000000 + ru.ru_stime.tv_usec;
+		counters.minflt = ru.ru_minflt;
+		counters.majflt = ru.ru_majflt;
+		counters.nvcsw = ru.ru_nvcsw;
+		counters.nivcsw = ru.ru_nivcsw;
+		counters.max_rss_bytes = (int64) ru.ru_maxrss * 1024;
+	}
+	exitstats_read_proc(&counters);
+
+	LWLockAcquire(pgnx_exitstats->lock, LW_EXCLUSIVE);
+
+	/*
+	 * New keys are not counted once the limit is reached; a shared hash
+	 * would otherwise keep growing into the spare shared memory.
+	 */
+	entry = (pgnxExitStatsEntry *) hash_search(pgnx_exitstats_hash, &key,
+											   HASH_FIND, &found);
+	if (entry == NULL &&
+		hash_get_num_entries(pgnx_exitstats_hash) < PGNX_EXITSTATS_MAX_ENTRIES)
+		entry = (pgnxExitStatsEntry *) hash_search(pgnx_exitstats_hash, &key,
+												   HASH_ENTER_NULL, &found);
+	if (entry != NULL)
+	{
+		int64		max_rss_bytes;
+
+		if (!found)
+			memset(&entry->counters, 0, sizeof(pgnxExitStatsCounters));
+		max_rss_bytes = Max(entry->counters.max_rss_bytes, counters.max_rss_bytes);
+
+		dst = (int64 *) &entry->counters;
+		src = (int64 *) &counters;
+		for (i = 0; i < PGNX_EXITSTATS_NCOUNTERS; ++i)
+			dst[i] += src[i];
+		entry->counters.max_rss_bytes = max_rss_bytes;
+	}
+
+	LWLockRelease(pgnx_exitstats->lock);
+}
+
+/*
+ * The block I/O delay from field 42 of "/proc/<pid>/stat", and the
+ * counters from "/proc/<pid>/io".
+ */
+static void
+exitstats_read_proc(pgnxExitStatsCounters *counters)
+{
+	char		fname[MAXPGPATH];
+	char		buf[1024];
+	char	   *p;
+	int			i;
+
+	snprintf(fname, MAXPGPATH, "%s/%d/stat", procroot, MyProcPid);
+	if (read_small_file(fname, buf, sizeof(buf)) &&
+		(p = strrchr(buf, ')')) != NULL)
+	{
+		/* p + 1 is just before field 3; skip to the start of field 42 */
+		for (i = 3; i <= 42 && p != NULL; ++i)
+			p = strchr(p + 1, ' ');
+		if (p != NULL)
+			counters->blkio_delay_usec =
+				strtoll(p + 1, NULL, 10) * 1000000 / sysconf(_SC_CLK_TCK);
+	}
+
+	snprintf(fname, MAXPGPATH, "%s/%d/io", procroot, MyProcPid);
+	if (!read_small_file(fname, buf, sizeof(buf)))
+		return;
+
+	for (p = buf; p != NULL && *p != '\0'; p = strchr(p, '\n'))
+	{
+		char	   *val;
+		int64	   *dst = NULL;
+
+		if (*p == '\n')
+			p++;
+		if ((val = strchr(p, ':')) == NULL)
+			break;
+
+		if (strncmp(p, "rchar:", 6) == 0)
+			dst = &counters->rchar;
+		else if (strncmp(p, "wchar:", 6) == 0)
+			dst = &counters->wchar;
+		else if (strncmp(p, "syscr:", 6) == 0)
+			dst = &counters->syscr;
+		else if (strncmp(p, "syscw:", 6) == 0)
+			dst = &counters->syscw;
+		else if (strncmp(p, "read_bytes:", 11) == 0)
+			dst = &counters->read_bytes;
+		else if (strncmp(p, "write_bytes:", 12) == 0)
+			dst = &counters->write_bytes;
+		else if (strncmp(p, "cancelled_write_bytes:", 22) == 0)
+			dst = &counters->cancelled_write_bytes;
+
+		if (dst != NULL)
+			*dst = strtoll(val + 1, NULL, 10);
+		p = val;
+	}
+}
+
+PG_FUNCTION_INFO_V1(pgnodemx_backend_exit_stats);
+Datum
+pgnodemx_backend_exit_stats(PG_FUNCTION_ARGS)
+{
+	int					nrow = 0;
+	int					ncol = PGNX_EXITSTATS_NCOL;
+	char			 ***values = NULL;
+	pgnxExitStatsEntry *entries;
+	pgnxExitStatsEntry *entry;
+	HASH_SEQ_STATUS		status;
+	int					i;
+	int					j;
+
+	if (pgnx_exitstats == NULL)
+		return form_srf(fcinfo, NULL, 0, ncol, oid_oid_text_16_bigint_sig);
+
+	/* take a consistent copy, then format it without holding the lock */
+	LWLockAcquire(pgnx_exitstats->lock, LW_SHARED);
+	entries = (pgnxExitStatsEntry *)
+		palloc(Max(hash_get_num_entries(pgnx_exitstats_hash), 1) * sizeof(pgnxExitStatsEntry));
+	hash_seq_init(&status, pgnx_exitstats_hash);
+	while ((entry = (pgnxExitStatsEntry *) hash_seq_search(&status)) != NULL)
+		entries[nrow++] = *entry;
+	LWLockRelease(pgnx_exitstats->lock);
+
+	if (nrow > 0)
+		values = (char ***) palloc(nrow * sizeof(char **));
+	for (i = 0; i < nrow; ++i)
+	{
+		pgnxExitStatsKey   *key = &entries[i].key;
+		int64			   *counters = (int64 *) &entries[i].counters;
+
+		values[i] = (char **) palloc0(ncol * sizeof(char *));
+		if (OidIsValid(key->dbid))
+			values[i][0] = psprintf("%u", key->dbid);
+		if (OidIsValid(key->userid))
+			values[i][1] = psprintf("%u", key->userid);
+		values[i][2] = pstrdup(key->backend_type);
+		for (j = 0; j < PGNX_EXITSTATS_NCOUNTERS; ++j)
+			values[i][3 + j] = int64_to_string(counters[j]);
+	}
+
+	return form_srf(fcinfo, values, nrow, ncol, oid_oid_text_16_bigint_sig);
+}
+
+PG_FUNCTION_INFO_V1(pgnodemx_backend_exit_stats_reset);
+Datum
+pgnodemx_backend_exit_stats_reset(PG_FUNCTION_ARGS)
+{
+	pgnxExitStatsEntry *entry;
+	HASH_SEQ_STATUS		status;
+
+	if (pgnx_exitstats == NULL)
+		PG_RETURN_VOID();
+
+	LWLockAcquire(pgnx_exitstats->lock, LW_EXCLUSIVE);
+	hash_seq_init(&status, pgnx_exitstats_hash);
+	while ((entry = (pgnxExitStatsEntry *) hash_seq_search(&status)) != NULL)
+		hash_search(pgnx_exitstats_hash, &entry->key, HASH_REMOVE, NULL);
+	LWLockRelease(pgnx_exitstats->lock);
+
+	PG_RETURN_VOID();
+}
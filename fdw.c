@@ -0,0 +1,1063 @@
+/*
+ * fdw.c
+ *
+ * Foreign data wrapper exposing pgnodemx sources as tables
+ *
+ * This code is released under the PostgreSQL license.
+ *
+ * Copyright 2020-2025 Crunchy Data Solutions, Inc.
+ *
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation for any purpose, without fee, and without a written
+ * agreement is hereby granted, provided that the above copyright notice
+ * and this paragraph and the following two paragraphs appear in all copies.
+ *
+ * IN NO EVENT SHALL CRUNCHY DATA SOLUTIONS, INC. BE LIABLE TO ANY PARTY
+ * FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING LOST PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS
+ * DOCUMENTATION, EVEN IF THE CRUNCHY DATA SOLUTIONS, INC. HAS BEEN ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THE CRUNCHY DATA SOLUTIONS, INC. SPECIFICALLY DISCLAIMS ANY WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE. THE SOFTWARE PROVIDED HEREUNDER IS
+ * ON AN "AS IS" BASIS, AND THE CRUNCHY DATA SOLUTIONS, INC. HAS NO
+ * OBLIGATIONS TO PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR
+ * MODIFICATIONS.
+ */
+
+#include "postgres.h"
+
+#include "access/reloptions.h"
+#include "access/parallel.h"
+#include "access/sysattr.h"
+#if PG_VERSION_NUM >= 110000
+#include "catalog/pg_operator_d.h"
+#include "catalog/pg_type_d.h"
+#else
+#include "catalog/pg_operator.h"
+#include "catalog/pg_type.h"
+#endif
+#include "catalog/pg_foreign_table.h"
+#include "commands/defrem.h"
+#include "commands/explain.h"
+#include "executor/tuptable.h"
+#include "foreign/fdwapi.h"
+#include "foreign/foreign.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "optimizer/cost.h"
+#if PG_VERSION_NUM >= 120000
+#include "optimizer/optimizer.h"
+#else
+#include "optimizer/var.h"
+#endif
+#include "optimizer/pathnode.h"
+#include "optimizer/planmain.h"
+#include "optimizer/restrictinfo.h"
+#include "port/atomics.h"
+#include "utils/array.h"
+#include "utils/builtins.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/rel.h"
+
+#include "cgroup.h"
+#include "genutils.h"
+#include "procfunc.h"
+#include "srfsigs.h"
+#include "stats.h"
+
+#ifndef Int4EqualOperator
+#define Int4EqualOperator 96
+#endif
+#ifndef TextEqualOperator
+#define TextEqualOperator 98
+#endif
+
+/*
+ * Planner cost of producing one row before local filtering: the per
+ * backend sources open at least one file per row, the others parse
+ * one line (or stat one file) per row.
+ */
+#define PGNX_FDW_PID_ROW_COST	0.5
+#define PGNX_FDW_ROW_COST		0.05
+
+/*
+ * Parallel scans of the per-backend sources: one worker is planned per
+ * PGNX_FDW_PIDS_PER_WORKER backends, and participants claim pids from
+ * the shared list PGNX_FDW_PID_CHUNK at a time.
+ */
+#define PGNX_FDW_PIDS_PER_WORKER	64
+#define PGNX_FDW_PID_CHUNK			8
+
+typedef char ***(*rows_fn) (List *keys, bool *needed, int *nrow);
+
+/*
+ * A foreign table source. Exactly one of pidrow and rows is set.
+ * Equality quals on keycol are pushed down: for per-backend sources
+ * keycol is the pid, and only matching backends are read; for the
+ * others it is a text column and only matching rows are built.
+ */
+typedef struct pgnxFdwSource
+{
+	const char		   *name;
+	int					ncol;
+	Oid				   *sig;
+	const char *const  *colnames;
+	int					keycol;
+	bool				is_cgroup;
+	pid_row_fn			pidrow;
+	rows_fn				rows;
+	int					estrows;	/* plan time estimate, for rows sources */
+} pgnxFdwSource;
+
+static const char *const proc_pid_stat_cols[] = {
+	"pid", "comm", "state", "ppid", "pgrp", "session", "tty_nr", "tpgid",
+	"flags", "minflt", "cminflt", "majflt", "cmajflt", "utime", "stime",
+	"cutime", "cstime", "priority", "nice", "num_threads", "itrealvalue",
+	"starttime", "vsize", "rss", "rsslim", "startcode", "endcode",
+	"startstack", "kstkesp", "kstkeip", "signal", "blocked", "sigignore",
+	"sigcatch", "wchan", "nswap", "cnswap", "exit_signal", "processor",
+	"rt_priority", "policy", "delayacct_blkio_ticks", "guest_time",
+	"cguest_time", "start_data", "end_data", "start_brk", "arg_start",
+	"arg_end", "env_start", "env_end", "exit_code"
+};
+
+static const char *const proc_pid_io_cols[] = {
+	"pid", "rchar", "wchar", "syscr", "syscw", "reads", "writes", "cwrites"
+};
+
+static const char *const proc_pid_cmdline_cols[] = {
+	"pid", "fullcomm", "uid", "username"
+};
+
+static const char *const proc_pid_schedstat_cols[] = {
+	"pid", "cpu_time_ns", "runqueue_wait_ns", "timeslices", "runqueue_wait_pct"
+};
+
+static const char *const proc_pid_status_cols[] = {
+	"pid", "vm_hwm", "vm_rss", "rss_anon", "rss_file", "rss_shmem", "vm_swap",
+	"threads", "voluntary_ctxt_switches", "nonvoluntary_ctxt_switches"
+};
+
+static const char *const proc_pid_fd_summary_cols[] = {
+	"pid", "total", "relation", "wal", "temp", "socket", "pipe", "other"
+};
+
+static const char *const proc_diskstats_cols[] = {
+	"major_number", "minor_number", "device_name",
+	"reads_completed_successfully", "reads_merged", "sectors_read",
+	"time_spent_reading_ms", "writes_completed", "writes_merged",
+	"sectors_written", "time_spent_writing_ms", "ios_currently_in_progress",
+	"time_spent_doing_ios_ms", "weighted_time_spent_doing_ios_ms",
+	"discards_completed_successfully", "discards_merged",
+	"sectors_discarded", "time_spent_discarding",
+	"flush_requests_completed_successfully", "time_spent_flushing"
+};
+
+static const char *const proc_meminfo_cols[] = {
+	"key", "val"
+};
+
+static const char *const cgroup_files_cols[] = {
+	"controller", "filename", "value"
+};
+
+static const pgnxFdwSource pgnx_fdw_sources[] = {
+	{"proc_pid_stat", PROC_PID_STAT_NCOL, proc_pid_stat_sig,
+	 proc_pid_stat_cols, 0, false, proc_pid_stat_row, NULL, 0},
+	{"proc_pid_io", PROC_PID_IO_NCOL, int_7_numeric_sig,
+	 proc_pid_io_cols, 0, false, proc_pid_io_row, NULL, 0},
+	{"proc_pid_cmdline", PROC_PID_CMDLINE_NCOL, int_text_int_text_sig,
+	 proc_pid_cmdline_cols, 0, false, proc_pid_cmdline_row, NULL, 0},
+	{"proc_pid_schedstat", PROC_PID_SCHEDSTAT_NCOL, int_3_numeric_float8_sig,
+	 proc_pid_schedstat_cols, 0, false, proc_pid_schedstat_row, NULL, 0},
+	{"proc_pid_status", PROC_PID_STATUS_NCOL, int_9_bigint_sig,
+	 proc_pid_status_cols, 0, false, proc_pid_status_row, NULL, 0},
+	{"proc_pid_fd_summary", PROC_PID_FD_SUMMARY_NCOL, int_7_bigint_sig,
+	 proc_pid_fd_summary_cols, 0, false, proc_pid_fd_summary_row, NULL, 0},
+	{"proc_diskstats", PROC_DISKSTATS_NCOL, proc_diskstats_sig,
+	 proc_diskstats_cols, 2, false, NULL, proc_diskstats_rows, 20},
+	{"proc_meminfo", PROC_MEMINFO_NCOL, text_bigint_sig,
+	 proc_meminfo_cols, 0, false, NULL, proc_meminfo_rows, 50},
+	{"cgroup_files", CGROUP_FILES_NCOL, text_text_text_sig,
+	 cgroup_files_cols, 0, true, NULL, cgroup_files_rows, 100}
+};
+
+#define PGNX_FDW_NSOURCES	lengthof(pgnx_fdw_sources)
+
+typedef struct pgnxFdwPlanState
+{
+	const pgnxFdwSource *source;
+	bool		have_keys;		/* true if keycol is restricted */
+	List	   *keys;			/* Integer (pid) or String nodes */
+	List	   *needed;			/* Integer nodes, 0-based columns */
+	List	   *other_quals;	/* RestrictInfos not pushed down */
+	double		ntuples;		/* rows produced before local filtering */
+} pgnxFdwPlanState;
+
+/*
+ * Shared state of a parallel scan: the leader's snapshot of the backend
+ * pids, and the index of the next one to claim.
+ */
+typedef struct pgnxFdwParallelState
+{
+	pg_atomic_uint32	next;
+	int					npids;
+	int					pids[FLEXIBLE_ARRAY_MEMBER];
+} pgnxFdwParallelState;
+
+typedef struct pgnxFdwScanState
+{
+	const pgnxFdwSource *source;
+	bool			have_keys;
+	List		   *keys;
+	bool		   *needed;
+	AttInMetadata  *attinmeta;
+	MemoryContext	rowcxt;
+	bool			generated;
+	char		 ***values;
+	int				nrow;
+	int				currow;
+
+	/* parallel scan only */
+	pgnxFdwParallelState *pstate;
+	char		  **pids;			/* leader's pid list, until copied */
+	int				npids;
+} pgnxFdwScanState;
+
+extern bool proc_enabled;
+
+Datum pgnodemx_fdw_handler(PG_FUNCTION_ARGS);
+Datum pgnodemx_fdw_validator(PG_FUNCTION_ARGS);
+
+static void pgnxGetForeignRelSize(PlannerInfo *root, RelOptInfo *baserel,
+								  Oid foreigntableid);
+static void pgnxGetForeignPaths(PlannerInfo *root, RelOptInfo *baserel,
+								Oid foreigntableid);
+static ForeignScan *pgnxGetForeignPlan(PlannerInfo *root, RelOptInfo *baserel,
+									   Oid foreigntableid, ForeignPath *best_path,
+									   List *tlist, List *scan_clauses,
+									   Plan *outer_plan);
+static void pgnxBeginForeignScan(ForeignScanState *node, int eflags);
+static TupleTableSlot *pgnxIterateForeignScan(ForeignScanState *node);
+static void pgnxReScanForeignScan(ForeignScanState *node);
+static void pgnxEndForeignScan(ForeignScanState *node);
+static void pgnxExplainForeignScan(ForeignScanState *node, ExplainState *es);
+#if PG_VERSION_NUM >= 90600
+static bool pgnxIsForeignScanParallelSafe(PlannerInfo *root, RelOptInfo *rel,
+										  RangeTblEntry *rte);
+#endif
+static List *pgnxImportForeignSchema(ImportForeignSchemaStmt *stmt,
+									 Oid serverOid);
+#if PG_VERSION_NUM >= 100000
+static Size pgnxEstimateDSMForeignScan(ForeignScanState *node,
+									   ParallelContext *pcxt);
+static void pgnxInitializeDSMForeignScan(ForeignScanState *node,
+										 ParallelContext *pcxt,
+										 void *coordinate);
+static void pgnxReInitializeDSMForeignScan(ForeignScanState *node,
+										   ParallelContext *pcxt,
+										   void *coordinate);
+static void pgnxInitializeWorkerForeignScan(ForeignScanState *node,
+											shm_toc *toc,
+											void *coordinate);
+static bool claim_pid_chunk(pgnxFdwScanState *fsstate);
+#endif
+
+static const pgnxFdwSource *find_source(const char *name);
+static const pgnxFdwSource *get_source(Oid foreigntableid);
+static bool source_enabled(const pgnxFdwSource *source);
+static bool extract_keys(pgnxFdwPlanState *fpinfo, RelOptInfo *baserel,
+						 Expr *clause);
+static Node *key_node(const pgnxFdwSource *source, Datum value);
+static List *key_cstrings(List *keys);
+static bool pid_in_keys(const char *pid, List *keys);
+static ForeignPath *make_path(PlannerInfo *root, RelOptInfo *baserel,
+							  double rows, Cost startup_cost, Cost total_cost);
+static void generate_rows(pgnxFdwScanState *fsstate);
+static void build_pid_rows(pgnxFdwScanState *fsstate, char **pids, int npids);
+
+PG_FUNCTION_INFO_V1(pgnodemx_fdw_handler);
+Datum
+pgnodemx_fdw_handler(PG_FUNCTION_ARGS)
+{
+	FdwRoutine *routine = makeNode(FdwRoutine);
+
+	routine->GetForeignRelSize = pgnxGetForeignRelSize;
+	routine->GetForeignPaths = pgnxGetForeignPaths;
+	routine->GetForeignPlan = pgnxGetForeignPlan;
+	routine->BeginForeignScan = pgnxBeginForeignScan;
+	routine->IterateForeignScan = pgnxIterateForeignScan;
+	routine->ReScanForeignScan = pgnxReScanForeignScan;
+	routine->EndForeignScan = pgnxEndForeignScan;
+	routine->ExplainForeignScan = pgnxExplainForeignScan;
+	routine->ImportForeignSchema = pgnxImportForeignSchema;
+#if PG_VERSION_NUM >= 90600
+	routine->IsForeignScanParallelSafe = pgnxIsForeignScanParallelSafe;
+#endif
+#if PG_VERSION_NUM >= 100000
+	routine->EstimateDSMForeignScan = pgnxEstimateDSMForeignScan;
+	routine->InitializeDSMForeignScan = pgnxInitializeDSMForeignScan;
+	routine->ReInitializeDSMForeignScan = pgnxReInitializeDSMForeignScan;
+	routine->InitializeWorkerForeignScan = pgnxInitializeWorkerForeignScan;
+#endif
+
+	PG_RETURN_POINTER(routine);
+}
+
+/*
+ * The only option is "source", on foreign tables
+ */
+PG_FUNCTION_INFO_V1(pgnodemx_fdw_validator);
+Datum
+pgnodemx_fdw_validator(PG_FUNCTION_ARGS)
+{
+	List	   *options = untransformRelOptions(PG_GETARG_DATUM(0));
+	Oid			catalog = PG_GETARG_OID(1);
+	ListCell   *lc;
+
+	foreach(lc, options)
+	{
+		DefElem    *def = (DefElem *) lfirst(lc);
+
+		if (catalog != ForeignTableRelationId ||
+			strcmp(def->defname, "source") != 0)
+			ereport(ERROR,
+					(errcode(ERRCODE_FDW_INVALID_OPTION_NAME),
+					 errmsg("pgnodemx: invalid option \"%s\"", def->defname),
+					 errhint("Only the \"source\" option of foreign tables is supported.")));
+
+		if (find_source(defGetString(def)) == NULL)
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+					 errmsg("pgnodemx: unknown source \"%s\"", defGetString(def))));
+	}
+
+	PG_RETURN_VOID();
+}
+
+static const pgnxFdwSource *
+find_source(const char *name)
+{
+	int		i;
+
+	for (i = 0; i < PGNX_FDW_NSOURCES; ++i)
+	{
+		if (strcmp(pgnx_fdw_sources[i].name, name) == 0)
+			return &pgnx_fdw_sources[i];
+	}
+
+	return NULL;
+}
+
+static const pgnxFdwSource *
+get_source(Oid foreigntableid)
+{
+	ForeignTable *table = GetForeignTable(foreigntableid);
+	const pgnxFdwSource *source = NULL;
+	ListCell   *lc;
+
+	foreach(lc, table->options)
+	{
+		DefElem    *def = (DefElem *) lfirst(lc);
+
+		if (strcmp(def->defname, "source") == 0)
+			source = find_source(defGetString(def));
+	}
+
+	if (source == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_FDW_OPTION_NAME_NOT_FOUND),
+				 errmsg("pgnodemx: foreign table \"%s\" has no valid source option",
+						get_rel_name(foreigntableid))));
+
+	return source;
+}
+
+static bool
+source_enabled(const pgnxFdwSource *source)
+{
+	return source->is_cgroup ? cgroup_enabled : proc_enabled;
+}
+
+static void
+pgnxGetForeignRelSize(PlannerInfo *root, RelOptInfo *baserel,
+					  Oid foreigntableid)
+{
+	pgnxFdwPlanState *fpinfo = (pgnxFdwPlanState *) palloc0(sizeof(pgnxFdwPlanState));
+	const pgnxFdwSource *source = get_source(foreigntableid);
+	Bitmapset  *attrs_used = NULL;
+	bool		wholerow;
+	ListCell   *lc;
+	int			i;
+
+	fpinfo->source = source;
+
+	/* the first usable equality qual on keycol is pushed down */
+	foreach(lc, baserel->baserestrictinfo)
+	{
+		RestrictInfo *rinfo = (RestrictInfo *) lfirst(lc);
+
+		if (!fpinfo->have_keys && extract_keys(fpinfo, baserel, rinfo->clause))
+			continue;
+		fpinfo->other_quals = lappend(fpinfo->other_quals, rinfo);
+	}
+
+	/* columns referenced by the target list or by quals checked locally */
+#if PG_VERSION_NUM >= 90600
+	pull_varattnos((Node *) baserel->reltarget->exprs, baserel->relid, &attrs_used);
+#else
+	pull_varattnos((Node *) baserel->reltargetlist, baserel->relid, &attrs_used);
+#endif
+	foreach(lc, baserel->baserestrictinfo)
+	{
+		RestrictInfo *rinfo = (RestrictInfo *) lfirst(lc);
+
+		pull_varattnos((Node *) rinfo->clause, baserel->relid, &attrs_used);
+	}
+	wholerow = bms_is_member(0 - FirstLowInvalidHeapAttributeNumber, attrs_used);
+	for (i = 0; i < source->ncol; ++i)
+	{
+		if (wholerow ||
+			bms_is_member(i + 1 - FirstLowInvalidHeapAttributeNumber, attrs_used))
+			fpinfo->needed = lappend(fpinfo->needed, makeInteger(i));
+	}
+
+	/* estimate what the scan will produce */
+	if (!source_enabled(source) || (fpinfo->have_keys && fpinfo->keys == NIL))
+		fpinfo->ntuples = 0;
+	else if (source->pidrow != NULL)
+	{
+		int		npids;
+
+		(void) get_backend_pids(&npids);
+		fpinfo->ntuples = npids;
+		if (fpinfo->have_keys)
+			fpinfo->ntuples = Min(npids, list_length(fpinfo->keys));
+	}
+	else
+	{
+		/*
+		 * A fixed estimate, as the ROWS of the matching function; reading
+		 * the files here would double the work of every scan. Each key
+		 * matches at most one row, except for cgroup_files.
+		 */
+		fpinfo->ntuples = source->estrows;
+		if (fpinfo->have_keys && !source->is_cgroup)
+			fpinfo->ntuples = Min(source->estrows, list_length(fpinfo->keys));
+	}
+
+	baserel->tuples = fpinfo->ntuples;
+	baserel->rows = fpinfo->ntuples *
+		clauselist_selectivity(root, fpinfo->other_quals, baserel->relid,
+							   JOIN_INNER, NULL);
+	baserel->rows = Max(rint(baserel->rows), 1.0);
+	baserel->fdw_private = (void *) fpinfo;
+}
+
+static void
+pgnxGetForeignPaths(PlannerInfo *root, RelOptInfo *baserel,
+					Oid foreigntableid)
+{
+	pgnxFdwPlanState *fpinfo = (pgnxFdwPlanState *) baserel->fdw_private;
+	double		row_cost;
+	Cost		startup_cost = 0;
+	Cost		total_cost;
+
+	row_cost = fpinfo->source->pidrow != NULL ?
+		PGNX_FDW_PID_ROW_COST : PGNX_FDW_ROW_COST;
+	total_cost = startup_cost + fpinfo->ntuples * (row_cost + cpu_tuple_cost);
+
+	add_path(baserel, (Path *)
+			 make_path(root, baserel, baserel->rows, startup_cost, total_cost));
+
+#if PG_VERSION_NUM >= 100000
+	/*
+	 * The per-backend sources can be split among parallel workers by pid,
+	 * each of them reading its own share of /proc/<pid> files.
+	 */
+	if (baserel->consider_parallel && fpinfo->source->pidrow != NULL)
+	{
+		int		workers = (int) (fpinfo->ntuples / PGNX_FDW_PIDS_PER_WORKER);
+
+		workers = Min(workers, max_parallel_workers_per_gather);
+		if (workers > 0)
+		{
+			/* the leader takes its share too */
+			double		divisor = workers + 1;
+			ForeignPath *path;
+
+			path = make_path(root, baserel, baserel->rows / divisor,
+							 startup_cost, total_cost / divisor);
+			path->path.parallel_aware = true;
+			path->path.parallel_safe = true;
+			path->path.parallel_workers = workers;
+			add_partial_path(baserel, (Path *) path);
+		}
+	}
+#endif
+}
+
+static ForeignPath *
+make_path(PlannerInfo *root, RelOptInfo *baserel, double rows,
+		  Cost startup_cost, Cost total_cost)
+{
+#if PG_VERSION_NUM >= 180000
+	return create_foreignscan_path(root, baserel, NULL, rows, 0,
+								   startup_cost, total_cost, NIL,
+								   NULL, NULL, NIL, NIL);
+#elif PG_VERSION_NUM >= 170000
+	return create_foreignscan_path(root, baserel, NULL, rows,
+								   startup_cost, total_cost, NIL,
+								   NULL, NULL, NIL, NIL);
+#elif PG_VERSION_NUM >= 90600
+	return create_foreignscan_path(root, baserel, NULL, rows,
+								   startup_cost, total_cost, NIL,
+								   NULL, NULL, NIL);
+#else
+	return create_foreignscan_path(root, baserel, rows,
+								   startup_cost, total_cost, NIL,
+								   NULL, NULL, NIL);
+#endif
+}
+
+static ForeignScan *
+pgnxGetForeignPlan(PlannerInfo *root, RelOptInfo *baserel,
+				   Oid foreigntableid, ForeignPath *best_path,
+				   List *tlist, List *scan_clauses, Plan *outer_plan)
+{
+	pgnxFdwPlanState *fpinfo = (pgnxFdwPlanState *) baserel->fdw_private;
+	List	   *fdw_private;
+
+	/*
+	 * All quals are rechecked locally, including the pushed down one;
+	 * the keys only limit what is read.
+	 */
+	scan_clauses = extract_actual_clauses(scan_clauses, false);
+
+	fdw_private = list_make3(makeInteger(fpinfo->have_keys ? 1 : 0),
+							 fpinfo->keys, fpinfo->needed);
+
+	return make_foreignscan(tlist, scan_clauses, baserel->relid,
+							NIL, fdw_private, NIL, NIL, outer_plan);
+}
+
+/*
+ * Collect the key values from "keycol = const" or
+ * "keycol = ANY (const array)". Returns false if clause is not one of
+ * those.
+ */
+static bool
+extract_keys(pgnxFdwPlanState *fpinfo, RelOptInfo *baserel, Expr *clause)
+{
+	const pgnxFdwSource *source = fpinfo->source;
+	Oid			eqop = source->pidrow != NULL ? Int4EqualOperator : TextEqualOperator;
+	Node	   *left;
+	Node	   *right;
+	Oid			opno;
+	bool		is_array;
+	Var		   *var;
+	Const	   *c;
+
+	if (IsA(clause, OpExpr) && list_length(((OpExpr *) clause)->args) == 2)
+	{
+		OpExpr	   *op = (OpExpr *) clause;
+
+		opno = op->opno;
+		left = linitial(op->args);
+		right = lsecond(op->args);
+		is_array = false;
+
+		/* accept "const = keycol" too */
+		if (IsA(left, Const))
+		{
+			Node   *tmp = left;
+
+			left = right;
+			right = tmp;
+		}
+	}
+	else if (IsA(clause, ScalarArrayOpExpr) && ((ScalarArrayOpExpr *) clause)->useOr)
+	{
+		ScalarArrayOpExpr *saop = (ScalarArrayOpExpr *) clause;
+
+		opno = saop->opno;
+		left = linitial(saop->args);
+		right = lsecond(saop->args);
+		is_array = true;
+	}
+	else
+		return false;
+
+	if (opno != eqop || !IsA(left, Var) || !IsA(right, Const))
+		return false;
+
+	var = (Var *) left;
+	if (var->varno != baserel->relid || var->varlevelsup != 0 ||
+		var->varattno != source->keycol + 1)
+		return false;
+
+	c = (Const *) right;
+	fpinfo->have_keys = true;
+	fpinfo->keys = NIL;
+
+	/* keycol = NULL matches nothing */
+	if (c->constisnull)
+		return true;
+
+	if (!is_array)
+		fpinfo->keys = list_make1(key_node(source, c->constvalue));
+	else
+	{
+		ArrayType  *arr = DatumGetArrayTypeP(c->constvalue);
+		int16		typlen;
+		bool		typbyval;
+		char		typalign;
+		Datum	   *elems;
+		bool	   *nulls;
+		int			nelems;
+		int			i;
+
+		get_typlenbyvalalign(ARR_ELEMTYPE(arr), &typlen, &typbyval, &typalign);
+		deconstruct_array(arr, ARR_ELEMTYPE(arr), typlen, typbyval, typalign,
+						  &elems, &nulls, &nelems);
+		for (i = 0; i < nelems; ++i)
+		{
+			if (!nulls[i])
+				fpinfo->keys = lappend(fpinfo->keys, key_node(source, elems[i]));
+		}
+	}
+
+	return true;
+}
+
+static Node *
+key_node(const pgnxFdwSource *source, Datum value)
+{
+	if (source->pidrow != NULL)
+		return (Node *) makeInteger(DatumGetInt32(value));
+
+	return (Node *) makeString(TextDatumGetCString(value));
+}
+
+/* String nodes to a list of C strings, as taken by the rows functions */
+static List *
+key_cstrings(List *keys)
+{
+	List	   *result = NIL;
+	ListCell   *lc;
+
+	foreach(lc, keys)
+		result = lappend(result, strVal(lfirst(lc)));
+
+	return result;
+}
+
+static bool
+pid_in_keys(const char *pid, List *keys)
+{
+	int			ipid = atoi(pid);
+	ListCell   *lc;
+
+	foreach(lc, keys)
+	{
+		if (intVal(lfirst(lc)) == ipid)
+			return true;
+	}
+
+	return false;
+}
+
+static void
+pgnxBeginForeignScan(ForeignScanState *node, int eflags)
+{
+	ForeignScan *plan = (ForeignScan *) node->ss.ps.plan;
+	Relation	rel = node->ss.ss_currentRelation;
+	TupleDesc	tupdesc = RelationGetDescr(rel);
+	pgnxFdwScanState *fsstate;
+	ListCell   *lc;
+	int			i;
+
+	if (eflags & EXEC_FLAG_EXPLAIN_ONLY)
+		return;
+
+	fsstate = (pgnxFdwScanState *) palloc0(sizeof(pgnxFdwScanState));
+	fsstate->source = get_source(RelationGetRelid(rel));
+
+	/* same check form_srf() does for the SRFs */
+	if (tupdesc->natts != fsstate->source->ncol)
+		ereport(ERROR,
+				(errcode(ERRCODE_FDW_INVALID_COLUMN_NUMBER),
+				 errmsg("pgnodemx: foreign table \"%s\" does not match source \"%s\"",
+						RelationGetRelationName(rel), fsstate->source->name),
+				 errdetail("Expected %d columns, got %d.",
+						   fsstate->source->ncol, tupdesc->natts),
+				 errhint("Use IMPORT FOREIGN SCHEMA to create the foreign tables.")));
+	for (i = 0; i < tupdesc->natts; ++i)
+	{
+		Oid		tdtyp = TupleDescAttr(tupdesc, i)->atttypid;
+
+		if (tdtyp != fsstate->source->sig[i])
+			ereport(ERROR,
+					(errcode(ERRCODE_FDW_INVALID_DATA_TYPE),
+					 errmsg("pgnodemx: foreign table \"%s\" does not match source \"%s\"",
+							RelationGetRelationName(rel), fsstate->source->name),
+					 errdetail("Expected %s, got %s for column %d.",
+							   format_type_be(fsstate->source->sig[i]),
+							   format_type_be(tdtyp), i + 1),
+					 errhint("Use IMPORT FOREIGN SCHEMA to create the foreign tables.")));
+	}
+
+	fsstate->have_keys = intVal(linitial(plan->fdw_private)) != 0;
+	fsstate->keys = (List *) lsecond(plan->fdw_private);
+	fsstate->needed = (bool *) palloc0(fsstate->source->ncol * sizeof(bool));
+	foreach(lc, (List *) lthird(plan->fdw_private))
+		fsstate->needed[intVal(lfirst(lc))] = true;
+
+	fsstate->attinmeta = TupleDescGetAttInMetadata(tupdesc);
+#if PG_VERSION_NUM >= 90600
+	fsstate->rowcxt = AllocSetContextCreate(CurrentMemoryContext,
+											"pgnodemx fdw rows",
+											ALLOCSET_DEFAULT_SIZES);
+#else
+	fsstate->rowcxt = AllocSetContextCreate(CurrentMemoryContext,
+											"pgnodemx fdw rows",
+											ALLOCSET_DEFAULT_MINSIZE,
+											ALLOCSET_DEFAULT_INITSIZE,
+											ALLOCSET_DEFAULT_MAXSIZE);
+#endif
+
+	node->fdw_state = (void *) fsstate;
+}
+
+/*
+ * Read the source, once per scan. Columns not needed by the query are
+ * left NULL so their input functions are skipped.
+ */
+static void
+generate_rows(pgnxFdwScanState *fsstate)
+{
+	const pgnxFdwSource *source = fsstate->source;
+	MemoryContext	oldcontext;
+
+	oldcontext = MemoryContextSwitchTo(fsstate->rowcxt);
+
+	fsstate->generated = true;
+	fsstate->values = NULL;
+	fsstate->nrow = 0;
+	fsstate->currow = 0;
+
+	if (!source_enabled(source) || (fsstate->have_keys && fsstate->keys == NIL))
+		;	/* nothing to return */
+	else if (source->pidrow != NULL)
+	{
+		int		npids;
+		char  **pids = get_backend_pids(&npids);
+
+		build_pid_rows(fsstate, pids, npids);
+	}
+	else
+	{
+		int		i;
+		int		k;
+
+		fsstate->values = source->rows(fsstate->have_keys ?
+									   key_cstrings(fsstate->keys) : NIL,
+									   fsstate->needed, &fsstate->nrow);
+		for (i = 0; i < fsstate->nrow; ++i)
+		{
+			for (k = 0; k < source->ncol; ++k)
+			{
+				if (!fsstate->needed[k])
+					fsstate->values[i][k] = NULL;
+			}
+		}
+	}
+
+	MemoryContextSwitchTo(oldcontext);
+
+	stats_flush_source(psprintf("fdw.%s", source->name));
+}
+
+/*
+ * Build the rows of a per-backend source for the given pids, skipping
+ * those not matching the pushed down keys.
+ */
+static void
+build_pid_rows(pgnxFdwScanState *fsstate, char **pids, int npids)
+{
+	const pgnxFdwSource *source = fsstate->source;
+	int			ncol = source->ncol;
+	bool		need_file = false;
+	int			i;
+	int			k;
+
+	/* the pid itself needs no file read */
+	for (k = 1; k < ncol; ++k)
+		need_file |= fsstate->needed[k];
+
+	fsstate->values = (char ***) palloc(Max(npids, 1) * sizeof(char **));
+	fsstate->nrow = 0;
+	fsstate->currow = 0;
+	for (i = 0; i < npids; ++i)
+	{
+		char  **row;
+
+		if (fsstate->have_keys && !pid_in_keys(pids[i], fsstate->keys))
+			continue;
+
+		if (need_file)
+		{
+			row = source->pidrow(pids[i], fsstate->needed);
+			for (k = 0; k < ncol; ++k)
+			{
+				if (!fsstate->needed[k])
+					row[k] = NULL;
+			}
+		}
+		else
+		{
+			row = (char **) palloc0(ncol * sizeof(char *));
+			if (fsstate->needed[0])
+				row[0] = pids[i];
+		}
+		fsstate->values[fsstate->nrow++] = row;
+	}
+}
+
+static TupleTableSlot *
+pgnxIterateForeignScan(ForeignScanState *node)
+{
+	pgnxFdwScanState *fsstate = (pgnxFdwScanState *) node->fdw_state;
+	TupleTableSlot *slot = node->ss.ss_ScanTupleSlot;
+
+#if PG_VERSION_NUM >= 100000
+	if (fsstate->pstate != NULL)
+	{
+		while (fsstate->currow >= fsstate->nrow)
+		{
+			if (!claim_pid_chunk(fsstate))
+				break;
+		}
+	}
+	else
+#endif
+	if (!fsstate->generated)
+		generate_rows(fsstate);
+
+	ExecClearTuple(slot);
+	if (fsstate->currow < fsstate->nrow)
+	{
+		HeapTuple	tuple;
+
+		tuple = BuildTupleFromCStrings(fsstate->attinmeta,
+									   fsstate->values[fsstate->currow++]);
+#if PG_VERSION_NUM >= 120000
+		ExecStoreHeapTuple(tuple, slot, false);
+#else
+		ExecStoreTuple(tuple, slot, InvalidBuffer, false);
+#endif
+	}
+
+	return slot;
+}
+
+static void
+pgnxReScanForeignScan(ForeignScanState *node)
+{
+	pgnxFdwScanState *fsstate = (pgnxFdwScanState *) node->fdw_state;
+
+	/*
+	 * Nothing is parameterized, so the rows already read still apply,
+	 * except in a parallel scan, where the shared cursor starts over.
+	 */
+	fsstate->currow = 0;
+	if (fsstate->pstate != NULL)
+		fsstate->nrow = 0;
+}
+
+static void
+pgnxEndForeignScan(ForeignScanState *node)
+{
+	pgnxFdwScanState *fsstate = (pgnxFdwScanState *) node->fdw_state;
+
+	if (fsstate == NULL)
+		return;
+
+	if (fsstate->pstate != NULL)
+		stats_flush_source(psprintf("fdw.%s", fsstate->source->name));
+
+	MemoryContextDelete(fsstate->rowcxt);
+}
+
+#if PG_VERSION_NUM >= 100000
+/*
+ * The leader takes the snapshot of the backend pids shared by the
+ * workers here, since the size of the shared state depends on it.
+ */
+static Size
+pgnxEstimateDSMForeignScan(ForeignScanState *node, ParallelContext *pcxt)
+{
+	pgnxFdwScanState *fsstate = (pgnxFdwScanState *) node->fdw_state;
+	MemoryContext	oldcontext;
+
+	fsstate->pids = NULL;
+	fsstate->npids = 0;
+	if (source_enabled(fsstate->source) &&
+		!(fsstate->have_keys && fsstate->keys == NIL))
+	{
+		oldcontext = MemoryContextSwitchTo(fsstate->rowcxt);
+		fsstate->pids = get_backend_pids(&fsstate->npids);
+		MemoryContextSwitchTo(oldcontext);
+	}
+
+	return add_size(offsetof(pgnxFdwParallelState, pids),
+					mul_size(fsstate->npids, sizeof(int)));
+}
+
+static void
+pgnxInitializeDSMForeignScan(ForeignScanState *node, ParallelContext *pcxt,
+							 void *coordinate)
+{
+	pgnxFdwScanState *fsstate = (pgnxFdwScanState *) node->fdw_state;
+	pgnxFdwParallelState *pstate = (pgnxFdwParallelState *) coordinate;
+	int			i;
+
+	pg_atomic_init_u32(&pstate->next, 0);
+	pstate->npids = fsstate->npids;
+	for (i = 0; i < fsstate->npids; ++i)
+		pstate->pids[i] = atoi(fsstate->pids[i]);
+
+	fsstate->pstate = pstate;
+	MemoryContextReset(fsstate->rowcxt);
+	fsstate->pids = NULL;
+}
+
+static void
+pgnxReInitializeDSMForeignScan(ForeignScanState *node, ParallelContext *pcxt,
+							   void *coordinate)
+{
+	pgnxFdwParallelState *pstate = (pgnxFdwParallelState *) coordinate;
+
+	pg_atomic_write_u32(&pstate->next, 0);
+}
+
+static void
+pgnxInitializeWorkerForeignScan(ForeignScanState *node, shm_toc *toc,
+								void *coordinate)
+{
+	pgnxFdwScanState *fsstate = (pgnxFdwScanState *) node->fdw_state;
+
+	fsstate->pstate = (pgnxFdwParallelState *) coordinate;
+}
+
+/*
+ * Claim the next chunk of the shared pid list and build its rows.
+ * Returns false once the list is exhausted.
+ */
+static bool
+claim_pid_chunk(pgnxFdwScanState *fsstate)
+{
+	pgnxFdwParallelState *pstate = fsstate->pstate;
+	MemoryContext	oldcontext;
+	uint32			first;
+	int				npids;
+	char		  **pids;
+	int				i;
+
+	first = pg_atomic_fetch_add_u32(&pstate->next, PGNX_FDW_PID_CHUNK);
+	if (first >= (uint32) pstate->npids)
+		return false;
+	npids = Min(PGNX_FDW_PID_CHUNK, pstate->npids - (int) first);
+
+	MemoryContextReset(fsstate->rowcxt);
+	oldcontext = MemoryContextSwitchTo(fsstate->rowcxt);
+
+	pids = (char **) palloc(npids * sizeof(char *));
+	for (i = 0; i < npids; ++i)
+		pids[i] = psprintf("%d", pstate->pids[first + i]);
+	build_pid_rows(fsstate, pids, npids);
+
+	MemoryContextSwitchTo(oldcontext);
+
+	return true;
+}
+#endif
+
+static void
+pgnxExplainForeignScan(ForeignScanState *node, ExplainState *es)
+{
+	ForeignScan *plan = (ForeignScan *) node->ss.ps.plan;
+	Relation	rel = node->ss.ss_currentRelation;
+
+	ExplainPropertyText("pgnodemx Source",
+						get_source(RelationGetRelid(rel))->name, es);
+
+	if (intVal(linitial(plan->fdw_private)) != 0)
+	{
+		StringInfo	keys = makeStringInfo();
+		ListCell   *lc;
+
+		foreach(lc, (List *) lsecond(plan->fdw_private))
+		{
+			Node   *key = (Node *) lfirst(lc);
+
+			if (keys->len > 0)
+				appendStringInfoString(keys, ", ");
+			if (IsA(key, Integer))
+				appendStringInfo(keys, "%d", (int) intVal(key));
+			else
+				appendStringInfoString(keys, strVal(key));
+		}
+		ExplainPropertyText("pgnodemx Keys", keys->data, es);
+	}
+}
+
+#if PG_VERSION_NUM >= 90600
+/*
+ * Nothing read depends on which backend does the reading, so a scan
+ * may run in a parallel worker.
+ */
+static bool
+pgnxIsForeignScanParallelSafe(PlannerInfo *root, RelOptInfo *rel,
+							  RangeTblEntry *rte)
+{
+	return true;
+}
+#endif
+
+/*
+ * One foreign table per source, named after it. LIMIT TO and EXCEPT
+ * are applied by the caller. The remote schema name is not used.
+ */
+static List *
+pgnxImportForeignSchema(ImportForeignSchemaStmt *stmt, Oid serverOid)
+{
+	ForeignServer  *server = GetForeignServer(serverOid);
+	List		   *commands = NIL;
+	int				i;
+
+	for (i = 0; i < PGNX_FDW_NSOURCES; ++i)
+	{
+		const pgnxFdwSource *source = &pgnx_fdw_sources[i];
+		StringInfoData	buf;
+		int				k;
+
+		initStringInfo(&buf);
+		appendStringInfo(&buf, "CREATE FOREIGN TABLE %s (",
+						 quote_identifier(source->name));
+		for (k = 0; k < source->ncol; ++k)
+			appendStringInfo(&buf, "%s%s %s", k > 0 ? ", " : "",
+							 quote_identifier(source->colnames[k]),
+							 format_type_be(source->sig[k]));
+		appendStringInfo(&buf, ") SERVER %s OPTIONS (source %s)",
+						 quote_identifier(server->servername),
+						 quote_literal_cstr(source->name));
+
+		commands = lappend(commands, buf.data);
+	}
+
+	return commands;
+}
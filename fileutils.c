@@ -30,6 +30,7 @@
 
 #include "postgres.h"
 
+#include <fcntl.h>
 #include <linux/magic.h>
 #ifndef CGROUP2_SUPER_MAGIC
 #define CGROUP2_SUPER_MAGIC  0x63677270
@@ -57,6 +58,7 @@
 
 #include "fileutils.h"
 #include "genutils.h"
+#include "stats.h"
 
 uint64	magic_ids[] =
 	{ADFS_SUPER_MAGIC,AFFS_SUPER_MAGIC,AFS_SUPER_MAGIC,
@@ -228,6 +230,9 @@ read_vfs(char *filename)
 	size_t			nbytes = 0;
 	FILE		   *file;
 	StringInfoData	sbuf;
+	int				nreads = 0;
+
+	stats_read_begin();
 
 	if ((file = AllocateFile(filename, PG_BINARY_R)) == NULL)
 		ereport(ERROR,
@@ -273,6 +278,7 @@ read_vfs(char *filename)
 					   (size_t) (sbuf.maxlen - sbuf.len - 1), file);
 		sbuf.len += rbytes;
 		nbytes += rbytes;
+		nreads++;
 	}
 
 	/*
@@ -291,9 +297,82 @@ read_vfs(char *filename)
 
 	FreeFile(file);
 
+	stats_read_end(nbytes, nreads);
+
 	return buf;
 }
 
+/*
+ * Read a whole file, minus any trailing newline. Unlike read_vfs(),
+ * failure is not an error: NULL is returned instead. Useful for files
+ * which may be unreadable or vanish under us, such as write-only
+ * control files or the task directories of exiting threads.
+ */
+char *
+read_file_or_null(const char *fname)
+{
+	FILE		   *file;
+	StringInfoData	buf;
+	char			rbuf[1024];
+	size_t			rbytes;
+	size_t			nbytes = 0;
+	int				nreads = 0;
+	bool			failed;
+
+	stats_read_begin();
+
+	if ((file = AllocateFile(fname, PG_BINARY_R)) == NULL)
+		return NULL;
+
+	initStringInfo(&buf);
+	while ((rbytes = fread(rbuf, 1, sizeof(rbuf), file)) > 0)
+	{
+		appendBinaryStringInfo(&buf, rbuf, rbytes);
+		nbytes += rbytes;
+		nreads++;
+	}
+	failed = ferror(file);
+	FreeFile(file);
+
+	stats_read_end(nbytes, nreads);
+
+	if (failed)
+		return NULL;
+
+	while (buf.len > 0 && buf.data[buf.len - 1] == '\n')
+		buf.data[--buf.len] = '\0';
+
+	return buf.data;
+}
+
+/*
+ * Read a short file into buf without erroring, since a process may
+ * exit at any time. Trailing newlines are stripped. Nothing is
+ * allocated and fd.c is bypassed, so this is safe in a background
+ * worker's sampling loop and in exit callbacks.
+ */
+bool
+read_small_file(const char *fname, char *buf, size_t len)
+{
+	int			fd;
+	ssize_t		nbytes;
+
+	fd = open(fname, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	nbytes = read(fd, buf, len - 1);
+	close(fd);
+	if (nbytes <= 0)
+		return false;
+
+	buf[nbytes] = '\0';
+	while (nbytes > 0 && buf[nbytes - 1] == '\n')
+		buf[--nbytes] = '\0';
+
+	return true;
+}
+
 /*
  * Convert statfs and stat structs for given path (at least the
  * interesting bits) to a string matrix of key/value pairs, suitable
@@ -348,6 +427,30 @@ get_statfs_path(char *pname, int *nrow, int *ncol)
 	return values;
 }
 
+/*
+ * Count the entries of a directory, not including "." and "..".
+ * Returns -1 if the directory cannot be opened.
+ */
+int
+count_dir_entries(const char *dname)
+{
+	DIR			   *dir;
+	struct dirent  *de;
+	int				n = 0;
+
+	if ((dir = AllocateDir(dname)) == NULL)
+		return -1;
+
+	while ((de = ReadDir(dir, dname)) != NULL)
+	{
+		if (strcmp(de->d_name, ".") != 0 && strcmp(de->d_name, "..") != 0)
+			++n;
+	}
+	FreeDir(dir);
+
+	return n;
+}
+
 static char *
 magic_get_name(uint64 magic_id)
 {
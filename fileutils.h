@@ -34,6 +34,9 @@
 extern void pgnodemx_check_role(void);
 extern char *convert_and_check_filename(text *arg, bool allow_abs);
 extern char *read_vfs(char *filename);
+extern char *read_file_or_null(const char *fname);
+extern bool read_small_file(const char *fname, char *buf, size_t len);
 extern char ***get_statfs_path(char *pname, int *nrow, int *ncol);
+extern int count_dir_entries(const char *dname);
 
 #endif	/* FILEUTILS_H */
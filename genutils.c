@@ -61,6 +61,7 @@
 #include "genutils.h"
 #include "parseutils.h"
 #include "srfsigs.h"
+#include "stats.h"
 
 #if PG_VERSION_NUM < 160000
 /* These two functions are used via custom find_option() function
@@ -213,6 +214,8 @@ form_srf(FunctionCallInfo fcinfo, char ***values, int nrow, int ncol, Oid *dtype
 	MemoryContext		oldcontext;
 	int					i;
 
+	stats_build_begin();
+
 	/* check to see if caller supports us returning a tuplestore */
 	if (!rsinfo || !(rsinfo->allowedModes & SFRM_Materialize))
 		ereport(ERROR,
@@ -290,6 +293,8 @@ form_srf(FunctionCallInfo fcinfo, char ***values, int nrow, int ncol, Oid *dtype
 	rsinfo->setDesc = tupdesc;
 	MemoryContextSwitchTo(oldcontext);
 
+	stats_flush(fcinfo);
+
 	return (Datum) 0;
 }
 
@@ -403,6 +408,23 @@ int64_cmp(const void *p1, const void *p2)
 	return 0;
 }
 
+/*
+ * True if str is equal to one of the C strings in list
+ */
+bool
+cstring_in_list(const char *str, List *list)
+{
+	ListCell   *lc;
+
+	foreach(lc, list)
+	{
+		if (strcmp(str, (char *) lfirst(lc)) == 0)
+			return true;
+	}
+
+	return false;
+}
+
 /*
  * Functions for obtaining the context within which we are operating
  */
@@ -31,6 +31,8 @@
 #ifndef GENUTILS_H
 #define GENUTILS_H
 
+#include "nodes/pg_list.h"
+
 extern Datum form_srf(FunctionCallInfo fcinfo,
 					  char ***values, int nrow, int ncol, Oid *dtypes);
 extern Datum setof_scalar_internal(FunctionCallInfo fcinfo,
@@ -38,6 +40,7 @@ extern Datum setof_scalar_internal(FunctionCallInfo fcinfo,
 extern Datum string_get_array_datum(char **values, int nvals,
 									Oid typelem, bool *isnull);
 extern int int64_cmp(const void *p1, const void *p2);
+extern bool cstring_in_list(const char *str, List *list);
 #if PG_VERSION_NUM < 160000
 extern struct config_generic *find_option(const char *name);
 #endif
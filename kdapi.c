@@ -31,15 +31,53 @@
 
 #include "postgres.h"
 
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include "fmgr.h"
 #include "lib/stringinfo.h"
+#include "utils/hsearch.h"
+#include "utils/memutils.h"
 
 #include "fileutils.h"
 #include "kdapi.h"
 #include "parseutils.h"
 
+/*
+ * Per-backend cache of parsed Downward API files, keyed by fully
+ * qualified path. The kubelet updates the files by writing a new
+ * timestamped directory and atomically swapping the "..data" symlink
+ * to it, so the symlink target identifies the content of every file.
+ * Where there is no "..data" link, e.g. the files were put in place
+ * some other way, an entry is validated by the inode, size, and
+ * modification time of the file instead. Either way, a hit costs one
+ * readlink() or stat() rather than an open, read, and parse.
+ */
+typedef enum kdapiCacheKind
+{
+	KDAPI_CACHE_NONE = 0,
+	KDAPI_CACHE_KV,
+	KDAPI_CACHE_INT64
+} kdapiCacheKind;
+
+typedef struct kdapiCacheEntry
+{
+	char			fqpath[MAXPGPATH];	/* hash key */
+	char			version[MAXPGPATH];
+	kdapiCacheKind	kind;
+	MemoryContext	cxt;				/* holds values */
+	int				nrow;
+	char		 ***values;
+	int64			int64val;
+} kdapiCacheEntry;
+
+static HTAB *kdapi_cache_htab = NULL;
+
+static kdapiCacheEntry *kdapi_cache_entry(char *fqpath, char *version);
+
 char *kdapi_path = NULL;
 bool kdapi_enabled = true;
+bool kdapi_cache = true;
 
 /*
  * Take input filename from caller, make sure it is acceptable
@@ -59,3 +97,202 @@ get_fq_kdapi_path(FunctionCallInfo fcinfo)
 
 	return pstrdup(ftr->data);
 }
+
+/*
+ * Get the current version stamp of fqpath, and its cache entry. Returns
+ * NULL if the file cannot be cached, in which case it is simply read.
+ */
+static kdapiCacheEntry *
+kdapi_cache_entry(char *fqpath, char *version)
+{
+	StringInfo		datalink = makeStringInfo();
+	ssize_t			len;
+	struct stat		st;
+	kdapiCacheEntry *entry;
+	bool			found;
+
+	if (!kdapi_cache || strlen(fqpath) >= MAXPGPATH)
+		return NULL;
+
+	appendStringInfo(datalink, "%s/..data", kdapi_path);
+	len = readlink(datalink->data, version, MAXPGPATH - 1);
+	if (len > 0)
+		version[len] = '\0';
+	else if (stat(fqpath, &st) == 0)
+		snprintf(version, MAXPGPATH, "%lu:%lld:%lld.%09ld",
+				 (unsigned long) st.st_ino, (long long) st.st_size,
+				 (long long) st.st_mtim.tv_sec, (long) st.st_mtim.tv_nsec);
+	else
+		return NULL;
+
+	if (kdapi_cache_htab == NULL)
+	{
+		HASHCTL		ctl;
+
+		memset(&ctl, 0, sizeof(ctl));
+		ctl.keysize = MAXPGPATH;
+		ctl.entrysize = sizeof(kdapiCacheEntry);
+		kdapi_cache_htab = hash_create("pgnodemx kdapi cache", 16, &ctl,
+#if PG_VERSION_NUM >= 140000
+									   HASH_ELEM | HASH_STRINGS);
+#else
+									   HASH_ELEM);
+#endif
+	}
+
+	entry = (kdapiCacheEntry *) hash_search(kdapi_cache_htab, fqpath,
+											HASH_ENTER, &found);
+	if (!found)
+	{
+		entry->version[0] = '\0';
+		entry->kind = KDAPI_CACHE_NONE;
+		entry->cxt = NULL;
+		entry->nrow = 0;
+		entry->values = NULL;
+	}
+
+	return entry;
+}
+
+/*
+ * Return the key/value pairs of a "key equals quoted value" file, as
+ * parsed by parse_keqv_line(). The result may belong to the cache and
+ * must not be modified.
+ */
+char ***
+kdapi_get_kv(char *fqpath, int *nrow)
+{
+	char			version[MAXPGPATH];
+	kdapiCacheEntry *entry = kdapi_cache_entry(fqpath, version);
+	MemoryContext	oldcontext;
+	char		  **lines;
+	char		 ***values;
+	int				nlines;
+	int				i;
+
+	if (entry != NULL && entry->kind == KDAPI_CACHE_KV &&
+		strcmp(entry->version, version) == 0)
+	{
+		*nrow = entry->nrow;
+		return entry->values;
+	}
+
+	lines = read_nlsv(fqpath, &nlines);
+	if (nlines < 1)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				errmsg("pgnodemx: no lines in Kubernetes Downward API file: %s ", fqpath)));
+
+	values = (char ***) palloc(nlines * sizeof(char **));
+	for (i = 0; i < nlines; ++i)
+	{
+		/*
+		 * parse_keqv_line always returns two tokens
+		 * or throws an error if it cannot.
+		 */
+		values[i] = parse_keqv_line(lines[i]);
+	}
+	*nrow = nlines;
+
+	if (entry == NULL)
+		return values;
+
+	/* invalidate first, in case we fail part way through the copy */
+	entry->kind = KDAPI_CACHE_NONE;
+	if (entry->cxt == NULL)
+		entry->cxt = AllocSetContextCreate(TopMemoryContext,
+										   "pgnodemx kdapi cache entry",
+#if PG_VERSION_NUM >= 90600
+										   ALLOCSET_SMALL_SIZES);
+#else
+										   ALLOCSET_SMALL_MINSIZE,
+										   ALLOCSET_SMALL_INITSIZE,
+										   ALLOCSET_SMALL_MAXSIZE);
+#endif
+	else
+		MemoryContextReset(entry->cxt);
+
+	oldcontext = MemoryContextSwitchTo(entry->cxt);
+	entry->values = (char ***) palloc(nlines * sizeof(char **));
+	for (i = 0; i < nlines; ++i)
+	{
+		entry->values[i] = (char **) palloc(2 * sizeof(char *));
+		entry->values[i][0] = pstrdup(values[i][0]);
+		entry->values[i][1] = pstrdup(values[i][1]);
+	}
+	MemoryContextSwitchTo(oldcontext);
+
+	entry->nrow = nlines;
+	strlcpy(entry->version, version, MAXPGPATH);
+	entry->kind = KDAPI_CACHE_KV;
+
+	return values;
+}
+
+/*
+ * Return the BIGINT contents of a single value file
+ */
+int64
+kdapi_get_int64(char *fqpath)
+{
+	char			version[MAXPGPATH];
+	kdapiCacheEntry *entry = kdapi_cache_entry(fqpath, version);
+	int64			result;
+
+	if (entry != NULL && entry->kind == KDAPI_CACHE_INT64 &&
+		strcmp(entry->version, version) == 0)
+		return entry->int64val;
+
+	result = get_int64_from_file(fqpath);
+
+	if (entry != NULL)
+	{
+		if (entry->cxt != NULL)
+			MemoryContextReset(entry->cxt);
+		entry->values = NULL;
+		entry->nrow = 0;
+		entry->int64val = result;
+		strlcpy(entry->version, version, MAXPGPATH);
+		entry->kind = KDAPI_CACHE_INT64;
+	}
+
+	return result;
+}
+
+/*
+ * Return the value of key in a "key equals quoted value" file, or NULL
+ * if it is not there. With the cache on this is a lookup in the cached
+ * pairs. Otherwise the file is scanned up to the matching line, and
+ * only that line is parsed, so the quoted values of the others (large
+ * JSON annotations, say) are never unescaped.
+ */
+char *
+kdapi_get_value(char *fqpath, char *key)
+{
+	size_t		keylen = strlen(key);
+	int			nlines;
+	int			i;
+
+	if (kdapi_cache)
+	{
+		char	 ***values = kdapi_get_kv(fqpath, &nlines);
+
+		for (i = 0; i < nlines; ++i)
+		{
+			if (strcmp(values[i][0], key) == 0)
+				return pstrdup(values[i][1]);
+		}
+	}
+	else
+	{
+		char	  **lines = read_nlsv(fqpath, &nlines);
+
+		for (i = 0; i < nlines; ++i)
+		{
+			if (strncmp(lines[i], key, keylen) == 0 && lines[i][keylen] == '=')
+				return parse_keqv_line(lines[i])[1];
+		}
+	}
+
+	return NULL;
+}
@@ -35,9 +35,13 @@
 #include "fmgr.h"
 
 char *get_fq_kdapi_path(FunctionCallInfo fcinfo);
+char ***kdapi_get_kv(char *fqpath, int *nrow);
+int64 kdapi_get_int64(char *fqpath);
+char *kdapi_get_value(char *fqpath, char *key);
 
 /* exported globals */
 extern char *kdapi_path;
 extern bool kdapi_enabled;
+extern bool kdapi_cache;
 
 #endif	/* KDAPI_H */
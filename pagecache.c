@@ -0,0 +1,515 @@
+/*
+ * pagecache.c
+ *
+ * Operating system page cache efficiency of backend reads
+ *
+ * This code is released under the PostgreSQL license.
+ *
+ * Copyright 2020-2025 Crunchy Data Solutions, Inc.
+ *
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation for any purpose, without fee, and without a written
+ * agreement is hereby granted, provided that the above copyright notice
+ * and this paragraph and the following two paragraphs appear in all copies.
+ *
+ * IN NO EVENT SHALL CRUNCHY DATA SOLUTIONS, INC. BE LIABLE TO ANY PARTY
+ * FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING LOST PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS
+ * DOCUMENTATION, EVEN IF THE CRUNCHY DATA SOLUTIONS, INC. HAS BEEN ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THE CRUNCHY DATA SOLUTIONS, INC. SPECIFICALLY DISCLAIMS ANY WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE. THE SOFTWARE PROVIDED HEREUNDER IS
+ * ON AN "AS IS" BASIS, AND THE CRUNCHY DATA SOLUTIONS, INC. HAS NO
+ * OBLIGATIONS TO PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR
+ * MODIFICATIONS.
+ */
+
+#include "postgres.h"
+
+#include "commands/dbcommands.h"
+#include "executor/spi.h"
+#include "fmgr.h"
+#include "miscadmin.h"
+#include "pgstat.h"
+#include "storage/ipc.h"
+#include "storage/latch.h"
+#include "utils/builtins.h"
+#include "utils/timestamp.h"
+
+#include "fileutils.h"
+#include "genutils.h"
+#include "procfunc.h"
+#include "srfsigs.h"
+
+/*
+ * PostgreSQL counts the reads it issues to the kernel; the read_bytes
+ * field of "/proc/<pid>/io" counts what each process actually had read
+ * from storage. Over an interval the difference between the two is
+ * what the operating system page cache served. Both are sampled at the
+ * start and end of the interval, and only backends present at both
+ * ends are counted, so that the two sides cover the same processes:
+ *
+ * On PostgreSQL 18 and later the PostgreSQL side is also taken per
+ * backend, from pg_stat_get_backend_io(), and both are added up by
+ * backend type and by database over the backends which report it.
+ *
+ * Before that only the totals of pg_stat_io (PostgreSQL 16 and later,
+ * per backend type) and pg_stat_database (per database) are available,
+ * which also count backends which started or exited during the
+ * interval. A group is then only returned if the same backends were
+ * in it at both ends.
+ *
+ * Either way the PostgreSQL counters lag, since backends only publish
+ * them now and then, while procfs is current.
+ */
+#define PAGE_CACHE_NCOL		5
+
+extern bool proc_enabled;
+
+/* one row: a backend type if dbid is invalid, otherwise a database */
+typedef struct pcGroup
+{
+	char		backend_type[NAMEDATALEN];
+	Oid			dbid;
+	bool		has_logical;
+	int64		logical_start;
+	int64		logical_end;
+	int64		storage;
+	int			nstart;			/* backends at the start */
+	int			nend;			/* backends at the end */
+	int			nboth;			/* the same backends at both */
+} pcGroup;
+
+/* the reads of one backend at one end of the interval */
+typedef struct pcBackend
+{
+	int			pid;
+	Oid			dbid;
+	char		backend_type[NAMEDATALEN];
+	int64		read_bytes;
+	int64		logical;		/* -1 if not known per backend */
+} pcBackend;
+
+typedef struct pcGroups
+{
+	pcGroup	   *groups;
+	int			ngroups;
+	int			maxgroups;
+} pcGroups;
+
+#if PG_VERSION_NUM >= 100000
+static pcGroup *pc_get_group(pcGroups *g, const char *backend_type, Oid dbid);
+#if PG_VERSION_NUM < 180000
+static void pc_sample_logical(pcGroups *g, bool at_end);
+#else
+static void pc_sample_backend_logical(pcBackend *backends, int nbackends);
+#endif
+static pcBackend *pc_sample_backends(int *nbackends);
+static int pc_backend_cmp(const void *a, const void *b);
+static int64 pc_read_bytes(int pid);
+static void pc_wait(int64 usecs);
+#endif
+
+Datum pgnodemx_page_cache_efficiency(PG_FUNCTION_ARGS);
+
+#if PG_VERSION_NUM >= 100000
+static pcGroup *
+pc_get_group(pcGroups *g, const char *backend_type, Oid dbid)
+{
+	pcGroup	   *group;
+	int			i;
+
+	for (i = 0; i < g->ngroups; ++i)
+	{
+		group = &g->groups[i];
+		if (group->dbid == dbid && strcmp(group->backend_type, backend_type) == 0)
+			return group;
+	}
+
+	if (g->ngroups == g->maxgroups)
+	{
+		g->maxgroups *= 2;
+		g->groups = (pcGroup *) repalloc(g->groups, g->maxgroups * sizeof(pcGroup));
+	}
+
+	group = &g->groups[g->ngroups++];
+	memset(group, 0, sizeof(pcGroup));
+	strlcpy(group->backend_type, backend_type, NAMEDATALEN);
+	group->dbid = dbid;
+	return group;
+}
+
+#if PG_VERSION_NUM < 180000
+/*
+ * Add the reads PostgreSQL has issued, per backend type and per
+ * database, to the start or end counters of their groups. The
+ * statistics snapshot is cleared first so the end of the interval
+ * does not see the same values as its start.
+ */
+static void
+pc_sample_logical(pcGroups *g, bool at_end)
+{
+	MemoryContext	oldcxt = CurrentMemoryContext;
+	const char	   *queries[2];
+	int				q;
+
+	pgstat_clear_snapshot();
+
+	queries[0] = psprintf("SELECT NULL::text, datid, blks_read * %d::int8 "
+						  "FROM pg_stat_database WHERE datid <> 0", BLCKSZ);
+#if PG_VERSION_NUM >= 160000
+	queries[1] = "SELECT backend_type, 0::oid, sum(reads * op_bytes)::int8 "
+				 "FROM pg_stat_io GROUP BY backend_type";
+#else
+	queries[1] = NULL;
+#endif
+
+	if (SPI_connect() != SPI_OK_CONNECT)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				errmsg("pgnodemx: SPI_connect failed")));
+
+	for (q = 0; q < 2 && queries[q] != NULL; ++q)
+	{
+		uint64		i;
+
+		if (SPI_execute(queries[q], true, 0) != SPI_OK_SELECT)
+			ereport(ERROR,
+					(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+					errmsg("pgnodemx: could not read statistics: %s", queries[q])));
+
+		for (i = 0; i < SPI_processed; ++i)
+		{
+			HeapTuple	tup = SPI_tuptable->vals[i];
+			TupleDesc	tupdesc = SPI_tuptable->tupdesc;
+			char	   *backend_type = SPI_getvalue(tup, tupdesc, 1);
+			bool		isnull;
+			Oid			dbid;
+			int64		bytes;
+			pcGroup	   *group;
+			MemoryContext spicxt;
+
+			dbid = DatumGetObjectId(SPI_getbinval(tup, tupdesc, 2, &isnull));
+			bytes = DatumGetInt64(SPI_getbinval(tup, tupdesc, 3, &isnull));
+			if (isnull)
+				continue;
+
+			/* the groups outlive SPI_finish() */
+			spicxt = MemoryContextSwitchTo(oldcxt);
+			group = pc_get_group(g, backend_type ? backend_type : "", dbid);
+			MemoryContextSwitchTo(spicxt);
+
+			group->has_logical = true;
+			if (at_end)
+				group->logical_end += bytes;
+			else
+				group->logical_start += bytes;
+		}
+	}
+
+	SPI_finish();
+}
+#else
+/*
+ * Fill in the reads PostgreSQL has issued for each backend which
+ * reports its own I/O statistics. backends must be sorted by pid.
+ */
+static void
+pc_sample_backend_logical(pcBackend *backends, int nbackends)
+{
+	const char *query = "SELECT a.pid, sum(io.read_bytes)::int8 "
+						"FROM pg_stat_activity a, "
+						"LATERAL pg_stat_get_backend_io(a.pid) io "
+						"WHERE a.pid IS NOT NULL GROUP BY a.pid";
+	uint64		i;
+
+	if (SPI_connect() != SPI_OK_CONNECT)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				errmsg("pgnodemx: SPI_connect failed")));
+
+	if (SPI_execute(query, true, 0) != SPI_OK_SELECT)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				errmsg("pgnodemx: could not read statistics: %s", query)));
+
+	for (i = 0; i < SPI_processed; ++i)
+	{
+		HeapTuple	tup = SPI_tuptable->vals[i];
+		TupleDesc	tupdesc = SPI_tuptable->tupdesc;
+		bool		isnull;
+		pcBackend	key;
+		pcBackend  *backend;
+		int64		bytes;
+
+		key.pid = DatumGetInt32(SPI_getbinval(tup, tupdesc, 1, &isnull));
+		bytes = DatumGetInt64(SPI_getbinval(tup, tupdesc, 2, &isnull));
+		if (isnull)
+			continue;
+
+		backend = (pcBackend *) bsearch(&key, backends, nbackends,
+										sizeof(pcBackend), pc_backend_cmp);
+		if (backend != NULL)
+			backend->logical = bytes;
+	}
+
+	SPI_finish();
+}
+#endif
+
+/*
+ * The storage reads of every backend in the backend status table,
+ * sorted by pid, and on PostgreSQL 18 and later the reads PostgreSQL
+ * issued for each. Processes which cannot be read are left out.
+ */
+static pcBackend *
+pc_sample_backends(int *nbackends)
+{
+	pcBackend  *backends;
+	int			nentries;
+	int			n = 0;
+	int			i;
+
+	pgstat_clear_snapshot();
+	nentries = pgstat_fetch_stat_numbackends();
+	backends = (pcBackend *) palloc0(Max(nentries, 1) * sizeof(pcBackend));
+
+	for (i = 1; i <= nentries; ++i)
+	{
+		LocalPgBackendStatus   *local;
+		PgBackendStatus		   *beentry;
+		pcBackend			   *backend = &backends[n];
+
+#if PG_VERSION_NUM >= 170000
+		local = pgstat_get_local_beentry_by_index(i);
+#else
+		local = pgstat_fetch_stat_local_beentry(i);
+#endif
+		if (local == NULL)
+			continue;
+
+		beentry = &local->backendStatus;
+		if (beentry->st_procpid <= 0)
+			continue;
+
+		backend->read_bytes = pc_read_bytes(beentry->st_procpid);
+		if (backend->read_bytes < 0)
+			continue;
+
+		backend->pid = beentry->st_procpid;
+		backend->dbid = beentry->st_databaseid;
+		backend->logical = -1;
+#if PG_VERSION_NUM >= 130000
+		strlcpy(backend->backend_type,
+				GetBackendTypeDesc(beentry->st_backendType), NAMEDATALEN);
+#else
+		strlcpy(backend->backend_type,
+				pgstat_get_backend_desc(beentry->st_backendType), NAMEDATALEN);
+#endif
+		n++;
+	}
+
+	qsort(backends, n, sizeof(pcBackend), pc_backend_cmp);
+#if PG_VERSION_NUM >= 180000
+	pc_sample_backend_logical(backends, n);
+#endif
+
+	*nbackends = n;
+	return backends;
+}
+
+static int
+pc_backend_cmp(const void *a, const void *b)
+{
+	int			pa = ((const pcBackend *) a)->pid;
+	int			pb = ((const pcBackend *) b)->pid;
+
+	return (pa > pb) - (pa < pb);
+}
+
+/*
+ * read_bytes from "/proc/<pid>/io", or -1 if the process is gone or
+ * the file cannot be read.
+ */
+static int64
+pc_read_bytes(int pid)
+{
+	char		fname[MAXPGPATH];
+	char		buf[256];
+	char	   *p;
+
+	snprintf(fname, MAXPGPATH, "%s/%d/io", procroot, pid);
+	if (!read_small_file(fname, buf, sizeof(buf)))
+		return -1;
+
+	if ((p = strstr(buf, "\nread_bytes:")) == NULL)
+		return -1;
+
+	return strtoll(p + 12, NULL, 10);
+}
+
+/*
+ * Sleep for usecs, waking up for interrupts, as pg_sleep() does.
+ */
+static void
+pc_wait(int64 usecs)
+{
+	TimestampTz		endtime = GetCurrentTimestamp() + usecs;
+
+	for (;;)
+	{
+		TimestampTz		now;
+		long			delay;
+		int				rc;
+
+		CHECK_FOR_INTERRUPTS();
+
+		now = GetCurrentTimestamp();
+		if (now >= endtime)
+			break;
+		delay = (long) ((endtime - now + 999) / 1000);
+
+#if PG_VERSION_NUM >= 120000
+		rc = WaitLatch(MyLatch, WL_LATCH_SET | WL_TIMEOUT | WL_EXIT_ON_PM_DEATH,
+					   delay, PG_WAIT_EXTENSION);
+#else
+		rc = WaitLatch(MyLatch, WL_LATCH_SET | WL_TIMEOUT | WL_POSTMASTER_DEATH,
+					   delay, PG_WAIT_EXTENSION);
+		if (rc & WL_POSTMASTER_DEATH)
+			proc_exit(1);
+#endif
+		if (rc & WL_LATCH_SET)
+			ResetLatch(MyLatch);
+	}
+}
+#endif	/* PG_VERSION_NUM >= 100000 */
+
+PG_FUNCTION_INFO_V1(pgnodemx_page_cache_efficiency);
+Datum
+pgnodemx_page_cache_efficiency(PG_FUNCTION_ARGS)
+{
+	int				nrow = 0;
+	int				ncol = PAGE_CACHE_NCOL;
+	char		 ***values = NULL;
+#if PG_VERSION_NUM >= 100000
+	Interval	   *span = PG_GETARG_INTERVAL_P(0);
+	int64			usecs;
+	pcGroups		g;
+	pcBackend	   *start;
+	pcBackend	   *end;
+	int				nstart;
+	int				nend;
+	int				i;
+
+	if (span->month != 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				errmsg("pgnodemx: interval must not include months")));
+	usecs = span->time + (int64) span->day * USECS_PER_DAY;
+	if (usecs <= 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				errmsg("pgnodemx: interval must be positive")));
+
+	if (!proc_enabled)
+		return form_srf(fcinfo, NULL, 0, ncol, text_text_2_bigint_float8_sig);
+
+	g.maxgroups = 32;
+	g.ngroups = 0;
+	g.groups = (pcGroup *) palloc(g.maxgroups * sizeof(pcGroup));
+
+#if PG_VERSION_NUM < 180000
+	pc_sample_logical(&g, false);
+#endif
+	start = pc_sample_backends(&nstart);
+	for (i = 0; i < nstart; ++i)
+	{
+		pc_get_group(&g, start[i].backend_type, InvalidOid)->nstart++;
+		if (OidIsValid(start[i].dbid))
+			pc_get_group(&g, "", start[i].dbid)->nstart++;
+	}
+
+	pc_wait(usecs);
+
+#if PG_VERSION_NUM < 180000
+	pc_sample_logical(&g, true);
+#endif
+	end = pc_sample_backends(&nend);
+
+	for (i = 0; i < nend; ++i)
+	{
+		pcBackend  *b = &end[i];
+		pcBackend  *a = (pcBackend *) bsearch(b, start, nstart, sizeof(pcBackend),
+											  pc_backend_cmp);
+		pcGroup	   *groups[2];
+		int			ngroups = 1;
+		int			k;
+
+		groups[0] = pc_get_group(&g, b->backend_type, InvalidOid);
+		if (OidIsValid(b->dbid))
+			groups[ngroups++] = pc_get_group(&g, "", b->dbid);
+
+		for (k = 0; k < ngroups; ++k)
+			groups[k]->nend++;
+
+		/* the same backend at both ends, not a reused pid */
+		if (a == NULL || a->dbid != b->dbid ||
+			strcmp(a->backend_type, b->backend_type) != 0)
+			continue;
+
+#if PG_VERSION_NUM >= 180000
+		/* count only backends whose PostgreSQL reads are known too */
+		if (a->logical < 0 || b->logical < 0)
+			continue;
+#endif
+
+		for (k = 0; k < ngroups; ++k)
+		{
+			groups[k]->nboth++;
+			groups[k]->storage += Max(b->read_bytes - a->read_bytes, 0);
+#if PG_VERSION_NUM >= 180000
+			groups[k]->has_logical = true;
+			groups[k]->logical_start += a->logical;
+			groups[k]->logical_end += b->logical;
+#endif
+		}
+	}
+
+	if (g.ngroups > 0)
+		values = (char ***) palloc(g.ngroups * sizeof(char **));
+	for (i = 0; i < g.ngroups; ++i)
+	{
+		pcGroup	   *group = &g.groups[i];
+		int64		logical = Max(group->logical_end - group->logical_start, 0);
+
+		if (!group->has_logical)
+			continue;
+#if PG_VERSION_NUM < 180000
+		/* the totals cover other backends too unless none came or went */
+		if (group->nstart != group->nboth || group->nend != group->nboth)
+			continue;
+#endif
+
+		values[nrow] = (char **) palloc0(ncol * sizeof(char *));
+		if (OidIsValid(group->dbid))
+		{
+			values[nrow][1] = get_database_name(group->dbid);
+			/* dropped during the interval */
+			if (values[nrow][1] == NULL)
+				continue;
+		}
+		else
+			values[nrow][0] = pstrdup(group->backend_type);
+
+		values[nrow][2] = int64_to_string(logical);
+		values[nrow][3] = int64_to_string(group->storage);
+		if (logical > 0)
+			values[nrow][4] = psprintf("%.6f", (double) group->storage / logical);
+		nrow++;
+	}
+#endif
+
+	return form_srf(fcinfo, values, nrow, ncol, text_text_2_bigint_float8_sig);
+}
@@ -44,6 +44,7 @@
 #include "fileutils.h"
 #include "kdapi.h"
 #include "parseutils.h"
+#include "stats.h"
 
 #define is_hex_digit(ch) ((ch >= '0' && ch <= '9') || (ch >= 'a' && ch <= 'f') || (ch >= 'A' && ch <= 'F'))
 #define hex_value(ch) ((ch >= '0' && ch <= '9') ? (ch & 0x0F) : (ch & 0x0F) + 9) /* assumes ascii */
@@ -74,6 +75,8 @@ read_nlsv(char *ftr, int *nlines)
 		*nlines += 1;
 	}
 
+	stats_lines_parsed(*nlines);
+
 	return lines;
 }
 
@@ -169,6 +172,110 @@ parse_ss_line(char *line, int *ntok)
 	return values;
 }
 
+/*
+ * Parse a /proc/<pid>/stat line. The second field is the command name
+ * in parenthesis, which may itself contain spaces and parenthesis, so
+ * it is delimited by the first "(" and the last ")" rather than split
+ * on spaces like the rest of the line.
+ * Return tokens and set ntok to number found.
+ */
+char **
+parse_pid_stat_line(char *line, int *ntok)
+{
+	char   *ptr1;
+	char   *ptr2;
+	char  **rest;
+	char  **values;
+	int		nrest;
+
+	/* Find start and end positions of the command string */
+	ptr1 = strchr(line, '(');
+	ptr2 = strrchr(line, ')');
+	if (ptr1 == NULL || ptr2 == NULL || ptr2 < ptr1 || ptr1 == line ||
+		ptr2[1] != ' ')
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				errmsg("pgnodemx: malformed pid stat line")));
+
+	/* the rest of the line starts 2 bytes after the closing parenthesis */
+	rest = parse_ss_line(ptr2 + 2, &nrest);
+
+	values = (char **) palloc((nrest + 2) * sizeof(char *));
+
+	/* first column is everything up to the space before the "(" */
+	ptr1[-1] = '\0';
+	values[0] = pstrdup(line);
+
+	/* second column is everything between the parenthesis */
+	ptr2[0] = '\0';
+	values[1] = pstrdup(ptr1 + 1);
+
+	memcpy(values + 2, rest, nrest * sizeof(char *));
+	*ntok = nrest + 2;
+
+	return values;
+}
+
+/*
+ * As parse_pid_stat_line(), but only the first ncol fields flagged in
+ * needed are returned, pointing into line, which is modified in place.
+ * The others are left NULL, and the line is not looked at past the
+ * last field needed. Sets ntok to the number of fields walked, which
+ * does not reach the last field needed only if the line ended first.
+ */
+char **
+parse_pid_stat_fields(char *line, bool *needed, int ncol, int *ntok)
+{
+	char   *ptr1;
+	char   *ptr2;
+	char   *p;
+	char  **values = (char **) palloc0(ncol * sizeof(char *));
+	int		last;
+	int		col;
+
+	for (last = ncol - 1; last >= 0 && !needed[last]; last--)
+		;
+
+	ptr1 = strchr(line, '(');
+	ptr2 = strrchr(line, ')');
+	if (ptr1 == NULL || ptr2 == NULL || ptr2 < ptr1 || ptr1 == line ||
+		ptr2[1] != ' ')
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				errmsg("pgnodemx: malformed pid stat line")));
+
+	ptr1[-1] = '\0';
+	ptr2[0] = '\0';
+	if (last >= 0 && needed[0])
+		values[0] = line;
+	if (last >= 1 && needed[1])
+		values[1] = ptr1 + 1;
+
+	/* the rest of the line starts 2 bytes after the closing parenthesis */
+	p = ptr2 + 2;
+	for (col = 2; col <= last; ++col)
+	{
+		char   *start;
+
+		while (*p == ' ')
+			p++;
+		if (*p == '\0')
+			break;
+
+		start = p;
+		while (*p != ' ' && *p != '\0')
+			p++;
+		if (*p == ' ')
+			*p++ = '\0';
+
+		if (needed[col])
+			values[col] = start;
+	}
+	*ntok = col;
+
+	return values;
+}
+
 /*
  * parse_quoted_string
  *
@@ -42,6 +42,9 @@ extern char **read_nlsv(char *ftr, int *nlines);
 extern char *read_one_nlsv(char *ftr);
 extern kvpairs *parse_nested_keyed_line(char *line);
 extern char **parse_ss_line(char *line, int *ntok);
+extern char **parse_pid_stat_line(char *line, int *ntok);
+extern char **parse_pid_stat_fields(char *line, bool *needed, int ncol,
+									int *ntok);
 extern char *parse_quoted_string(char **source);
 extern char **parse_keqv_line(char *line);
 extern int64 get_int64_from_file(char *ftr);
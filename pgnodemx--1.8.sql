@@ -0,0 +1,820 @@
+/* pgnodemx--1.8.sql */
+
+-- complain if script is sourced in psql, rather than via CREATE EXTENSION
+\echo Use "CREATE EXTENSION pgnodemx" to load this file. \quit
+
+CREATE FUNCTION cgroup_mode()
+RETURNS TEXT
+AS 'MODULE_PATHNAME', 'pgnodemx_cgroup_mode'
+LANGUAGE C STABLE STRICT;
+
+CREATE FUNCTION cgroup_path
+(
+  OUT controller TEXT,
+  OUT path TEXT
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pgnodemx_cgroup_path'
+LANGUAGE C STABLE STRICT ROWS 10;
+
+CREATE FUNCTION cgroup_process_count()
+RETURNS INT4
+AS 'MODULE_PATHNAME', 'pgnodemx_cgroup_process_count'
+LANGUAGE C STABLE STRICT;
+
+CREATE FUNCTION cgroup_scalar_bigint(TEXT)
+RETURNS BIGINT
+AS 'MODULE_PATHNAME', 'pgnodemx_cgroup_scalar_bigint'
+LANGUAGE C STABLE STRICT;
+
+CREATE FUNCTION cgroup_scalar_float8(TEXT)
+RETURNS FLOAT8
+AS 'MODULE_PATHNAME', 'pgnodemx_cgroup_scalar_float8'
+LANGUAGE C STABLE STRICT;
+
+CREATE FUNCTION cgroup_scalar_text(TEXT)
+RETURNS TEXT
+AS 'MODULE_PATHNAME', 'pgnodemx_cgroup_scalar_text'
+LANGUAGE C STABLE STRICT;
+
+CREATE FUNCTION cgroup_setof_bigint(TEXT)
+RETURNS SETOF BIGINT
+AS 'MODULE_PATHNAME', 'pgnodemx_cgroup_setof_bigint'
+LANGUAGE C STABLE STRICT ROWS 100;
+
+CREATE FUNCTION cgroup_setof_text(TEXT)
+RETURNS SETOF TEXT
+AS 'MODULE_PATHNAME', 'pgnodemx_cgroup_setof_text'
+LANGUAGE C STABLE STRICT ROWS 10;
+
+CREATE FUNCTION cgroup_array_text(TEXT)
+RETURNS TEXT[]
+AS 'MODULE_PATHNAME', 'pgnodemx_cgroup_array_text'
+LANGUAGE C STABLE STRICT;
+
+CREATE FUNCTION cgroup_array_bigint(TEXT)
+RETURNS BIGINT[]
+AS 'MODULE_PATHNAME', 'pgnodemx_cgroup_array_bigint'
+LANGUAGE C STABLE STRICT;
+
+CREATE FUNCTION cgroup_setof_kv
+(
+  IN filename TEXT,
+  OUT key TEXT,
+  OUT val BIGINT
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pgnodemx_cgroup_setof_kv'
+LANGUAGE C STABLE STRICT ROWS 50;
+
+CREATE FUNCTION cgroup_setof_ksv
+(
+  IN filename TEXT,
+  OUT key TEXT,
+  OUT subkey TEXT,
+  OUT val BIGINT
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pgnodemx_cgroup_setof_ksv'
+LANGUAGE C STABLE STRICT ROWS 50;
+
+CREATE FUNCTION cgroup_setof_nkv
+(
+  IN filename TEXT,
+  OUT key TEXT,
+  OUT subkey TEXT,
+  OUT val FLOAT8
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pgnodemx_cgroup_setof_nkv'
+LANGUAGE C STABLE STRICT ROWS 10;
+
+CREATE FUNCTION envvar_text(TEXT)
+RETURNS TEXT
+AS 'MODULE_PATHNAME', 'pgnodemx_envvar_text'
+LANGUAGE C STABLE STRICT;
+
+CREATE FUNCTION envvar_bigint(TEXT)
+RETURNS BIGINT
+AS 'MODULE_PATHNAME', 'pgnodemx_envvar_bigint'
+LANGUAGE C STABLE STRICT;
+
+CREATE FUNCTION kdapi_scalar_bigint(TEXT)
+RETURNS BIGINT
+AS 'MODULE_PATHNAME', 'pgnodemx_kdapi_scalar_bigint'
+LANGUAGE C STABLE STRICT;
+
+CREATE FUNCTION kdapi_setof_kv
+(
+  IN filename TEXT,
+  OUT key TEXT,
+  OUT val TEXT
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pgnodemx_kdapi_setof_kv'
+LANGUAGE C STABLE STRICT ROWS 20;
+
+CREATE FUNCTION fips_mode()
+RETURNS BOOL
+AS 'MODULE_PATHNAME', 'pgnodemx_fips_mode'
+LANGUAGE C STABLE STRICT;
+
+CREATE FUNCTION symbol_filename(TEXT)
+RETURNS TEXT
+AS 'MODULE_PATHNAME', 'pgnodemx_symbol_filename'
+LANGUAGE C STABLE STRICT;
+
+CREATE FUNCTION pgnodemx_version()
+RETURNS TEXT
+AS 'MODULE_PATHNAME', 'pgnodemx_version'
+LANGUAGE C STABLE STRICT;
+
+CREATE FUNCTION proc_diskstats
+(
+  OUT major_number BIGINT,
+  OUT minor_number BIGINT,
+  OUT device_name TEXT,
+  OUT reads_completed_successfully NUMERIC,
+  OUT reads_merged NUMERIC,
+  OUT sectors_read NUMERIC,
+  OUT time_spent_reading_ms BIGINT,
+  OUT writes_completed NUMERIC,
+  OUT writes_merged NUMERIC,
+  OUT sectors_written NUMERIC,
+  OUT time_spent_writing_ms BIGINT,
+  OUT ios_currently_in_progress BIGINT,
+  OUT time_spent_doing_ios_ms BIGINT,
+  OUT weighted_time_spent_doing_ios_ms BIGINT,
+  OUT discards_completed_successfully NUMERIC,
+  OUT discards_merged NUMERIC,
+  OUT sectors_discarded NUMERIC,
+  OUT time_spent_discarding BIGINT,
+  OUT flush_requests_completed_successfully NUMERIC,
+  OUT time_spent_flushing BIGINT
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pgnodemx_proc_diskstats'
+LANGUAGE C STABLE STRICT ROWS 20;
+
+CREATE FUNCTION proc_mountinfo
+(
+  OUT mount_id BIGINT,
+  OUT parent_id BIGINT,
+  OUT major_number BIGINT,
+  OUT minor_number BIGINT,
+  OUT root TEXT,
+  OUT mount_point TEXT,
+  OUT mount_options TEXT,
+  OUT fs_type TEXT,
+  OUT mount_source TEXT,
+  OUT super_options TEXT
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pgnodemx_proc_mountinfo'
+LANGUAGE C STABLE STRICT ROWS 30;
+
+CREATE FUNCTION proc_meminfo
+(
+  OUT key TEXT,
+  OUT val BIGINT
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pgnodemx_proc_meminfo'
+LANGUAGE C STABLE STRICT ROWS 50;
+
+CREATE FUNCTION proc_network_stats
+(
+  OUT interface TEXT,
+  OUT rx_bytes BIGINT,
+  OUT rx_packets BIGINT,
+  OUT rx_errs BIGINT,
+  OUT rx_drop BIGINT,
+  OUT rx_fifo BIGINT,
+  OUT rx_frame BIGINT,
+  OUT rx_compressed BIGINT,
+  OUT rx_multicast BIGINT,
+  OUT tx_bytes BIGINT,
+  OUT tx_packets BIGINT,
+  OUT tx_errs BIGINT,
+  OUT tx_drop BIGINT,
+  OUT tx_fifo BIGINT,
+  OUT tx_frame BIGINT,
+  OUT tx_compressed BIGINT,
+  OUT tx_multicast BIGINT
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pgnodemx_network_stats'
+LANGUAGE C STABLE STRICT ROWS 5;
+
+CREATE FUNCTION fsinfo
+(
+  IN pathname TEXT,
+  OUT major_number NUMERIC,
+  OUT minor_number NUMERIC,
+  OUT type TEXT,
+  OUT block_size NUMERIC,
+  OUT blocks NUMERIC,
+  OUT total_bytes NUMERIC,
+  OUT free_blocks NUMERIC,
+  OUT free_bytes NUMERIC,
+  OUT available_blocks NUMERIC,
+  OUT available_bytes NUMERIC,
+  OUT total_file_nodes NUMERIC,
+  OUT free_file_nodes NUMERIC,
+  OUT mount_flags TEXT
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pgnodemx_fsinfo'
+LANGUAGE C STABLE STRICT ROWS 1;
+
+CREATE FUNCTION proc_pid_io(
+  OUT pid INTEGER,
+  OUT rchar NUMERIC,
+  OUT wchar NUMERIC,
+  OUT syscr NUMERIC,
+  OUT syscw NUMERIC,
+  OUT reads NUMERIC,
+  OUT writes NUMERIC,
+  OUT cwrites NUMERIC)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pgnodemx_proc_pid_io'
+LANGUAGE C IMMUTABLE STRICT ROWS 100;
+
+CREATE FUNCTION proc_pid_cmdline(
+  OUT pid INTEGER,
+  OUT fullcomm TEXT,
+  OUT uid INTEGER,
+  OUT username TEXT
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pgnodemx_proc_pid_cmdline'
+LANGUAGE C IMMUTABLE STRICT ROWS 100;
+
+CREATE FUNCTION proc_pid_stat(
+  OUT pid INTEGER,
+  OUT comm TEXT,
+  OUT state TEXT,
+  OUT ppid INTEGER,
+  OUT pgrp INTEGER,
+  OUT session INTEGER,
+  OUT tty_nr INTEGER,
+  OUT tpgid INTEGER,
+  OUT flags BIGINT,
+  OUT minflt NUMERIC,
+  OUT cminflt NUMERIC,
+  OUT majflt NUMERIC,
+  OUT cmajflt NUMERIC,
+  OUT utime NUMERIC,
+  OUT stime NUMERIC,
+  OUT cutime BIGINT,
+  OUT cstime BIGINT,
+  OUT priority BIGINT,
+  OUT nice BIGINT,
+  OUT num_threads BIGINT,
+  OUT itrealvalue BIGINT,
+  OUT starttime NUMERIC,
+  OUT vsize NUMERIC,
+  OUT rss BIGINT,
+  OUT rsslim NUMERIC,
+  OUT startcode NUMERIC,
+  OUT endcode NUMERIC,
+  OUT startstack NUMERIC,
+  OUT kstkesp NUMERIC,
+  OUT kstkeip NUMERIC,
+  OUT signal NUMERIC,
+  OUT blocked NUMERIC,
+  OUT sigignore NUMERIC,
+  OUT sigcatch NUMERIC,
+  OUT wchan NUMERIC,
+  OUT nswap NUMERIC,
+  OUT cnswap NUMERIC,
+  OUT exit_signal INTEGER,
+  OUT processor INTEGER,
+  OUT rt_priority BIGINT,
+  OUT policy BIGINT,
+  OUT delayacct_blkio_ticks NUMERIC,
+  OUT guest_time NUMERIC,
+  OUT cguest_time BIGINT,
+  OUT start_data NUMERIC,
+  OUT end_data NUMERIC,
+  OUT start_brk NUMERIC,
+  OUT arg_start NUMERIC,
+  OUT arg_end NUMERIC,
+  OUT env_start NUMERIC,
+  OUT env_end NUMERIC,
+  OUT exit_code INTEGER)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pgnodemx_proc_pid_stat'
+LANGUAGE C IMMUTABLE STRICT ROWS 100;
+
+CREATE FUNCTION kpages_to_bytes(NUMERIC)
+RETURNS NUMERIC
+AS 'MODULE_PATHNAME', 'pgnodemx_pages_to_bytes'
+LANGUAGE C IMMUTABLE STRICT;
+
+CREATE FUNCTION proc_cputime(
+  OUT "user" BIGINT,
+  OUT nice BIGINT,
+  OUT system BIGINT,
+  OUT idle BIGINT,
+  OUT iowait BIGINT)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pgnodemx_proc_cputime'
+LANGUAGE C IMMUTABLE STRICT ROWS 1;
+
+CREATE FUNCTION proc_loadavg(
+  OUT load1 FLOAT,
+  OUT load5 FLOAT,
+  OUT load15 FLOAT,
+  OUT last_pid INTEGER)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pgnodemx_proc_loadavg'
+LANGUAGE C IMMUTABLE STRICT ROWS 1;
+
+CREATE FUNCTION exec_path()
+RETURNS TEXT
+AS 'MODULE_PATHNAME', 'pgnodemx_exec_path'
+LANGUAGE C IMMUTABLE STRICT;
+
+CREATE FUNCTION stat_file(
+  IN filename TEXT,
+  OUT uid NUMERIC,
+  OUT username TEXT,
+  OUT gid NUMERIC,
+  OUT groupname TEXT,
+  OUT filemode TEXT
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pgnodemx_stat_file'
+LANGUAGE C IMMUTABLE STRICT ROWS 1;
+
+CREATE FUNCTION openssl_version()
+RETURNS TEXT
+AS 'MODULE_PATHNAME', 'pgnodemx_openssl_version'
+LANGUAGE C IMMUTABLE STRICT;
+
+CREATE FUNCTION pgnodemx_stats
+(
+  OUT source TEXT,
+  OUT calls BIGINT,
+  OUT files_opened BIGINT,
+  OUT file_reads BIGINT,
+  OUT bytes_read BIGINT,
+  OUT lines_parsed BIGINT,
+  OUT read_time FLOAT8,
+  OUT parse_time FLOAT8,
+  OUT build_time FLOAT8,
+  OUT total_time FLOAT8,
+  OUT latency_histogram BIGINT[]
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pgnodemx_stats'
+LANGUAGE C VOLATILE STRICT ROWS 20;
+
+CREATE FUNCTION pgnodemx_stats_reset()
+RETURNS VOID
+AS 'MODULE_PATHNAME', 'pgnodemx_stats_reset'
+LANGUAGE C VOLATILE STRICT;
+
+REVOKE ALL ON FUNCTION pgnodemx_stats_reset() FROM PUBLIC;
+
+CREATE FUNCTION pgnodemx_fdw_handler()
+RETURNS fdw_handler
+AS 'MODULE_PATHNAME', 'pgnodemx_fdw_handler'
+LANGUAGE C STRICT;
+
+CREATE FUNCTION pgnodemx_fdw_validator(text[], oid)
+RETURNS void
+AS 'MODULE_PATHNAME', 'pgnodemx_fdw_validator'
+LANGUAGE C STRICT;
+
+CREATE FOREIGN DATA WRAPPER pgnodemx_fdw
+  HANDLER pgnodemx_fdw_handler
+  VALIDATOR pgnodemx_fdw_validator;
+
+CREATE FUNCTION kdapi_value(TEXT, TEXT)
+RETURNS TEXT
+AS 'MODULE_PATHNAME', 'pgnodemx_kdapi_value'
+LANGUAGE C STABLE STRICT;
+
+CREATE FUNCTION envvar_all
+(
+  IN prefix TEXT DEFAULT '',
+  OUT name TEXT,
+  OUT value TEXT,
+  OUT int8_value BIGINT,
+  OUT bool_value BOOLEAN,
+  OUT size_bytes BIGINT
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pgnodemx_envvar_all'
+LANGUAGE C STABLE STRICT ROWS 50;
+
+CREATE FUNCTION proc_task_stat
+(
+  IN backend_pid INTEGER,
+  OUT pid INTEGER,
+  OUT tid INTEGER,
+  OUT comm TEXT,
+  OUT state TEXT,
+  OUT processor INTEGER,
+  OUT utime NUMERIC,
+  OUT stime NUMERIC,
+  OUT minflt NUMERIC,
+  OUT majflt NUMERIC,
+  OUT priority BIGINT,
+  OUT nice BIGINT,
+  OUT starttime NUMERIC,
+  OUT cpu_time_ns NUMERIC,
+  OUT runqueue_wait_ns NUMERIC,
+  OUT timeslices NUMERIC
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pgnodemx_proc_task_stat'
+LANGUAGE C STABLE STRICT ROWS 1;
+
+CREATE FUNCTION proc_pid_schedstat
+(
+  OUT pid INTEGER,
+  OUT cpu_time_ns NUMERIC,
+  OUT runqueue_wait_ns NUMERIC,
+  OUT timeslices NUMERIC,
+  OUT runqueue_wait_pct FLOAT8
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pgnodemx_proc_pid_schedstat'
+LANGUAGE C STABLE STRICT ROWS 100;
+
+CREATE FUNCTION proc_schedstat
+(
+  OUT cpu TEXT,
+  OUT yld_count NUMERIC,
+  OUT sched_count NUMERIC,
+  OUT sched_goidle NUMERIC,
+  OUT ttwu_count NUMERIC,
+  OUT ttwu_local NUMERIC,
+  OUT run_time_ns NUMERIC,
+  OUT runqueue_wait_ns NUMERIC,
+  OUT timeslices NUMERIC,
+  OUT runqueue_wait_pct FLOAT8
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pgnodemx_proc_schedstat'
+LANGUAGE C STABLE STRICT ROWS 16;
+
+CREATE FUNCTION backend_kernel_profile
+(
+  OUT backend_type TEXT,
+  OUT wait_event_type TEXT,
+  OUT wait_event TEXT,
+  OUT state TEXT,
+  OUT wchan TEXT,
+  OUT syscall INTEGER,
+  OUT samples BIGINT
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pgnodemx_backend_kernel_profile'
+LANGUAGE C VOLATILE STRICT ROWS 100;
+
+CREATE FUNCTION backend_kernel_profile_reset()
+RETURNS VOID
+AS 'MODULE_PATHNAME', 'pgnodemx_backend_kernel_profile_reset'
+LANGUAGE C VOLATILE STRICT;
+
+REVOKE ALL ON FUNCTION backend_kernel_profile_reset() FROM PUBLIC;
+
+CREATE FUNCTION proc_pid_status
+(
+  OUT pid INTEGER,
+  OUT vm_hwm BIGINT,
+  OUT vm_rss BIGINT,
+  OUT rss_anon BIGINT,
+  OUT rss_file BIGINT,
+  OUT rss_shmem BIGINT,
+  OUT vm_swap BIGINT,
+  OUT threads BIGINT,
+  OUT voluntary_ctxt_switches BIGINT,
+  OUT nonvoluntary_ctxt_switches BIGINT
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pgnodemx_proc_pid_status'
+LANGUAGE C STABLE STRICT ROWS 100;
+
+CREATE FUNCTION proc_pid_fd_summary
+(
+  classify BOOLEAN DEFAULT true,
+  OUT pid INTEGER,
+  OUT total BIGINT,
+  OUT relation BIGINT,
+  OUT wal BIGINT,
+  OUT temp BIGINT,
+  OUT socket BIGINT,
+  OUT pipe BIGINT,
+  OUT other BIGINT
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pgnodemx_proc_pid_fd_summary'
+LANGUAGE C STABLE STRICT ROWS 100;
+
+CREATE FUNCTION backend_cgroup
+(
+  include_cpu_stat BOOLEAN DEFAULT false,
+  OUT pid INTEGER,
+  OUT cgroup_path TEXT,
+  OUT usage_usec BIGINT,
+  OUT user_usec BIGINT,
+  OUT system_usec BIGINT,
+  OUT nr_throttled BIGINT,
+  OUT throttled_usec BIGINT
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pgnodemx_backend_cgroup'
+LANGUAGE C STABLE STRICT ROWS 100;
+
+CREATE FUNCTION proc_interrupts
+(
+  OUT irq TEXT,
+  OUT cpu INTEGER,
+  OUT count BIGINT,
+  OUT description TEXT
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pgnodemx_proc_interrupts'
+LANGUAGE C STABLE STRICT ROWS 1000;
+
+CREATE FUNCTION proc_softirqs
+(
+  OUT irq TEXT,
+  OUT cpu INTEGER,
+  OUT count BIGINT,
+  OUT description TEXT
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pgnodemx_proc_softirqs'
+LANGUAGE C STABLE STRICT ROWS 100;
+
+CREATE FUNCTION proc_buddyinfo
+(
+  OUT node INTEGER,
+  OUT zone TEXT,
+  OUT page_order INTEGER,
+  OUT free_blocks BIGINT,
+  OUT free_bytes BIGINT,
+  OUT free_bytes_at_or_above BIGINT
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pgnodemx_proc_buddyinfo'
+LANGUAGE C STABLE STRICT ROWS 50;
+
+CREATE FUNCTION proc_zoneinfo
+(
+  OUT node INTEGER,
+  OUT zone TEXT,
+  OUT free_bytes BIGINT,
+  OUT min_bytes BIGINT,
+  OUT low_bytes BIGINT,
+  OUT high_bytes BIGINT,
+  OUT managed_bytes BIGINT
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pgnodemx_proc_zoneinfo'
+LANGUAGE C STABLE STRICT ROWS 5;
+
+CREATE FUNCTION hugepage_status
+(
+  OUT page_size BIGINT,
+  OUT nr_hugepages BIGINT,
+  OUT free_hugepages BIGINT,
+  OUT resv_hugepages BIGINT,
+  OUT surplus_hugepages BIGINT,
+  OUT nr_overcommit_hugepages BIGINT,
+  OUT is_default BOOLEAN,
+  OUT required_hugepages BIGINT
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pgnodemx_hugepage_status'
+LANGUAGE C STABLE STRICT ROWS 2;
+
+CREATE FUNCTION sysctl_snapshot
+(
+  OUT name TEXT,
+  OUT value TEXT,
+  OUT int8_value BIGINT
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pgnodemx_sysctl_snapshot'
+LANGUAGE C STABLE STRICT ROWS 30;
+
+CREATE FUNCTION sysctl_compare
+(
+  OUT name TEXT,
+  OUT value TEXT,
+  OUT recommended TEXT,
+  OUT ok BOOLEAN
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pgnodemx_sysctl_compare'
+LANGUAGE C STABLE STRICT ROWS 10;
+
+CREATE FUNCTION cgroup_members_delta
+(
+  OUT pid BIGINT,
+  OUT change TEXT,
+  OUT comm TEXT
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pgnodemx_cgroup_members_delta'
+LANGUAGE C VOLATILE STRICT ROWS 10;
+
+REVOKE ALL ON FUNCTION cgroup_members_delta() FROM PUBLIC;
+
+CREATE FUNCTION backend_exit_stats
+(
+  OUT dbid OID,
+  OUT userid OID,
+  OUT backend_type TEXT,
+  OUT exits BIGINT,
+  OUT user_usec BIGINT,
+  OUT system_usec BIGINT,
+  OUT blkio_delay_usec BIGINT,
+  OUT minflt BIGINT,
+  OUT majflt BIGINT,
+  OUT nvcsw BIGINT,
+  OUT nivcsw BIGINT,
+  OUT max_rss_bytes BIGINT,
+  OUT rchar BIGINT,
+  OUT wchar BIGINT,
+  OUT syscr BIGINT,
+  OUT syscw BIGINT,
+  OUT read_bytes BIGINT,
+  OUT write_bytes BIGINT,
+  OUT cancelled_write_bytes BIGINT
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pgnodemx_backend_exit_stats'
+LANGUAGE C VOLATILE STRICT ROWS 100;
+
+CREATE FUNCTION backend_exit_stats_reset()
+RETURNS VOID
+AS 'MODULE_PATHNAME', 'pgnodemx_backend_exit_stats_reset'
+LANGUAGE C VOLATILE STRICT;
+
+REVOKE ALL ON FUNCTION backend_exit_stats_reset() FROM PUBLIC;
+
+CREATE FUNCTION query_os_stats
+(
+  OUT queryid BIGINT,
+  OUT dbid OID,
+  OUT userid OID,
+  OUT calls BIGINT,
+  OUT user_usec BIGINT,
+  OUT system_usec BIGINT,
+  OUT minflt BIGINT,
+  OUT majflt BIGINT,
+  OUT nvcsw BIGINT,
+  OUT nivcsw BIGINT,
+  OUT read_bytes BIGINT,
+  OUT write_bytes BIGINT
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pgnodemx_query_os_stats'
+LANGUAGE C VOLATILE STRICT ROWS 1000;
+
+CREATE FUNCTION query_os_stats_reset()
+RETURNS VOID
+AS 'MODULE_PATHNAME', 'pgnodemx_query_os_stats_reset'
+LANGUAGE C VOLATILE STRICT;
+
+REVOKE ALL ON FUNCTION query_os_stats_reset() FROM PUBLIC;
+
+CREATE FUNCTION page_cache_efficiency
+(
+  IN sample_interval INTERVAL DEFAULT '10 seconds',
+  OUT backend_type TEXT,
+  OUT database TEXT,
+  OUT logical_read_bytes BIGINT,
+  OUT storage_read_bytes BIGINT,
+  OUT storage_read_ratio FLOAT8
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pgnodemx_page_cache_efficiency'
+LANGUAGE C VOLATILE STRICT ROWS 20;
+
+CREATE FUNCTION pgnodemx_srf_support(internal)
+RETURNS internal
+AS 'MODULE_PATHNAME', 'pgnodemx_srf_support'
+LANGUAGE C STRICT;
+
+-- planner support functions are only available on PostgreSQL 12 and later
+DO $$
+DECLARE
+  fn TEXT;
+BEGIN
+  IF current_setting('server_version_num')::int >= 120000 THEN
+    FOREACH fn IN ARRAY ARRAY[
+      'cgroup_path()',
+      'cgroup_setof_bigint(TEXT)',
+      'cgroup_setof_text(TEXT)',
+      'cgroup_setof_kv(TEXT)',
+      'cgroup_setof_ksv(TEXT)',
+      'cgroup_setof_nkv(TEXT)',
+      'kdapi_setof_kv(TEXT)',
+      'proc_diskstats()',
+      'proc_mountinfo()',
+      'proc_meminfo()',
+      'proc_network_stats()',
+      'proc_pid_io()',
+      'proc_pid_cmdline()',
+      'proc_pid_stat()',
+      'pgnodemx_stats()',
+      'envvar_all(TEXT)',
+      'proc_task_stat(INTEGER)',
+      'proc_pid_schedstat()',
+      'proc_schedstat()',
+      'backend_kernel_profile()',
+      'proc_pid_status()',
+      'proc_pid_fd_summary(BOOLEAN)',
+      'backend_cgroup(BOOLEAN)',
+      'proc_interrupts()',
+      'proc_softirqs()',
+      'proc_buddyinfo()',
+      'proc_zoneinfo()',
+      'hugepage_status()',
+      'sysctl_snapshot()',
+      'sysctl_compare()',
+      'backend_exit_stats()',
+      'query_os_stats()',
+      'page_cache_efficiency(INTERVAL)'
+    ] LOOP
+      EXECUTE 'ALTER FUNCTION ' || fn || ' SUPPORT pgnodemx_srf_support';
+    END LOOP;
+  END IF;
+END
+$$;
+
+-- all of the above are read only; PARALLEL needs PostgreSQL 9.6 or later
+DO $$
+DECLARE
+  fn TEXT;
+BEGIN
+  IF current_setting('server_version_num')::int >= 90600 THEN
+    FOREACH fn IN ARRAY ARRAY[
+      'cgroup_mode()',
+      'cgroup_path()',
+      'cgroup_process_count()',
+      'cgroup_scalar_bigint(TEXT)',
+      'cgroup_scalar_float8(TEXT)',
+      'cgroup_scalar_text(TEXT)',
+      'cgroup_setof_bigint(TEXT)',
+      'cgroup_setof_text(TEXT)',
+      'cgroup_array_text(TEXT)',
+      'cgroup_array_bigint(TEXT)',
+      'cgroup_setof_kv(TEXT)',
+      'cgroup_setof_ksv(TEXT)',
+      'cgroup_setof_nkv(TEXT)',
+      'envvar_text(TEXT)',
+      'envvar_bigint(TEXT)',
+      'kdapi_scalar_bigint(TEXT)',
+      'kdapi_setof_kv(TEXT)',
+      'fips_mode()',
+      'symbol_filename(TEXT)',
+      'pgnodemx_version()',
+      'proc_diskstats()',
+      'proc_mountinfo()',
+      'proc_meminfo()',
+      'proc_network_stats()',
+      'fsinfo(TEXT)',
+      'proc_pid_io()',
+      'proc_pid_cmdline()',
+      'proc_pid_stat()',
+      'kpages_to_bytes(NUMERIC)',
+      'proc_cputime()',
+      'proc_loadavg()',
+      'exec_path()',
+      'stat_file(TEXT)',
+      'openssl_version()',
+      'pgnodemx_stats()',
+      'kdapi_value(TEXT, TEXT)',
+      'envvar_all(TEXT)',
+      'proc_task_stat(INTEGER)',
+      'proc_pid_schedstat()',
+      'proc_schedstat()',
+      'backend_kernel_profile()',
+      'proc_pid_status()',
+      'proc_pid_fd_summary(BOOLEAN)',
+      'backend_cgroup(BOOLEAN)',
+      'proc_interrupts()',
+      'proc_softirqs()',
+      'proc_buddyinfo()',
+      'proc_zoneinfo()',
+      'hugepage_status()',
+      'sysctl_snapshot()',
+      'sysctl_compare()',
+      'backend_exit_stats()',
+      'query_os_stats()'
+    ] LOOP
+      EXECUTE 'ALTER FUNCTION ' || fn || ' PARALLEL SAFE';
+    END LOOP;
+  END IF;
+END
+$$;
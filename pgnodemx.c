@@ -48,20 +48,31 @@
 #else
 #include "catalog/pg_type.h"
 #endif
+#ifndef INT8ARRAYOID
+#define INT8ARRAYOID 1016
+#endif
 #include "fmgr.h"
 #include "miscadmin.h"
+#if PG_VERSION_NUM >= 120000
+#include "nodes/supportnodes.h"
+#endif
 #include "utils/acl.h"
 #include "utils/builtins.h"
 #include "utils/guc_tables.h"
+#include "utils/lsyscache.h"
 
 #include "cgroup.h"
 #include "envutils.h"
+#include "exitstats.h"
 #include "fileutils.h"
 #include "genutils.h"
 #include "kdapi.h"
 #include "parseutils.h"
 #include "procfunc.h"
+#include "profile.h"
+#include "querystats.h"
 #include "srfsigs.h"
+#include "stats.h"
 
 PG_MODULE_MAGIC;
 
@@ -69,9 +80,14 @@ PG_MODULE_MAGIC;
 Oid text_sig[] = {TEXTOID};
 Oid bigint_sig[] = {INT8OID};
 Oid text_text_sig[] = {TEXTOID, TEXTOID};
+Oid bigint_text_text_sig[] = {INT8OID, TEXTOID, TEXTOID};
+Oid text_text_text_sig[] = {TEXTOID, TEXTOID, TEXTOID};
 Oid text_bigint_sig[] = {TEXTOID, INT8OID};
 Oid text_text_bigint_sig[] = {TEXTOID, TEXTOID, INT8OID};
+Oid text_text_text_bool_sig[] = {TEXTOID, TEXTOID, TEXTOID, BOOLOID};
+Oid text_text_bigint_bool_bigint_sig[] = {TEXTOID, TEXTOID, INT8OID, BOOLOID, INT8OID};
 Oid text_text_float8_sig[] = {TEXTOID, TEXTOID, FLOAT8OID};
+Oid text_text_2_bigint_float8_sig[] = {TEXTOID, TEXTOID, INT8OID, INT8OID, FLOAT8OID};
 Oid _2_numeric_text_9_numeric_text_sig[] = {NUMERICOID, NUMERICOID, TEXTOID, NUMERICOID,
 										  NUMERICOID, NUMERICOID, NUMERICOID, NUMERICOID, NUMERICOID,
 										  NUMERICOID, NUMERICOID, NUMERICOID, TEXTOID};
@@ -82,12 +98,38 @@ Oid text_16_bigint_sig[] = {TEXTOID,
 							INT8OID, INT8OID, INT8OID, INT8OID,
 							INT8OID, INT8OID, INT8OID, INT8OID,
 							INT8OID, INT8OID, INT8OID, INT8OID};
+Oid oid_oid_text_16_bigint_sig[] = {OIDOID, OIDOID, TEXTOID,
+									INT8OID, INT8OID, INT8OID, INT8OID,
+									INT8OID, INT8OID, INT8OID, INT8OID,
+									INT8OID, INT8OID, INT8OID, INT8OID,
+									INT8OID, INT8OID, INT8OID, INT8OID};
+Oid bigint_oid_oid_9_bigint_sig[] = {INT8OID, OIDOID, OIDOID,
+									 INT8OID, INT8OID, INT8OID,
+									 INT8OID, INT8OID, INT8OID,
+									 INT8OID, INT8OID, INT8OID};
 
 Oid _5_bigint_sig[] = { INT8OID, INT8OID, INT8OID, INT8OID, INT8OID };
 
 Oid int_7_numeric_sig[] = { INT4OID, NUMERICOID, NUMERICOID, NUMERICOID,
 							NUMERICOID, NUMERICOID, NUMERICOID, NUMERICOID };
 Oid int_text_int_text_sig[] = { INT4OID, TEXTOID, INT4OID, TEXTOID };
+Oid int_3_numeric_float8_sig[] = { INT4OID, NUMERICOID, NUMERICOID, NUMERICOID,
+								   FLOAT8OID };
+Oid text_8_numeric_float8_sig[] = { TEXTOID,
+									NUMERICOID, NUMERICOID, NUMERICOID, NUMERICOID,
+									NUMERICOID, NUMERICOID, NUMERICOID, NUMERICOID,
+									FLOAT8OID };
+Oid int_text_int_3_bigint_sig[] = { INT4OID, TEXTOID, INT4OID,
+									 INT8OID, INT8OID, INT8OID };
+Oid text_int_bigint_text_sig[] = { TEXTOID, INT4OID, INT8OID, TEXTOID };
+Oid int_text_5_bigint_sig[] = { INT4OID, TEXTOID, INT8OID, INT8OID, INT8OID,
+								INT8OID, INT8OID };
+Oid int_7_bigint_sig[] = { INT4OID, INT8OID, INT8OID, INT8OID, INT8OID,
+						   INT8OID, INT8OID, INT8OID };
+Oid int_9_bigint_sig[] = { INT4OID, INT8OID, INT8OID, INT8OID, INT8OID,
+						   INT8OID, INT8OID, INT8OID, INT8OID, INT8OID };
+Oid text_5_int_bigint_sig[] = { TEXTOID, TEXTOID, TEXTOID, TEXTOID, TEXTOID,
+							   INT4OID, INT8OID };
 Oid load_avg_sig[] = { FLOAT8OID, FLOAT8OID, FLOAT8OID, INT4OID };
 
 /* proc_diskstats is unique enough to have its own sig */
@@ -117,6 +159,22 @@ Oid proc_pid_stat_sig[] = {INT4OID, TEXTOID, TEXTOID,
 Oid num_text_num_2_text_sig[] = {NUMERICOID, TEXTOID,
 								 NUMERICOID, TEXTOID, TEXTOID};
 
+/* proc_task_stat is unique enough to have its own sig */
+Oid proc_task_stat_sig[] = {INT4OID, INT4OID, TEXTOID, TEXTOID, INT4OID,
+							NUMERICOID, NUMERICOID, NUMERICOID, NUMERICOID,
+							INT8OID, INT8OID, NUMERICOID,
+							NUMERICOID, NUMERICOID, NUMERICOID};
+
+/* hugepage_status is unique enough to have its own sig */
+Oid hugepage_status_sig[] = {INT8OID, INT8OID, INT8OID, INT8OID, INT8OID,
+							 INT8OID, BOOLOID, INT8OID};
+
+/* pgnodemx_stats is unique enough to have its own sig */
+Oid pgnodemx_stats_sig[] = {TEXTOID,
+							INT8OID, INT8OID, INT8OID, INT8OID, INT8OID,
+							FLOAT8OID, FLOAT8OID, FLOAT8OID, FLOAT8OID,
+							INT8ARRAYOID};
+
 void _PG_init(void);
 Datum pgnodemx_cgroup_mode(PG_FUNCTION_ARGS);
 Datum pgnodemx_cgroup_path(PG_FUNCTION_ARGS);
@@ -131,10 +189,15 @@ Datum pgnodemx_cgroup_array_bigint(PG_FUNCTION_ARGS);
 Datum pgnodemx_cgroup_setof_kv(PG_FUNCTION_ARGS);
 Datum pgnodemx_cgroup_setof_ksv(PG_FUNCTION_ARGS);
 Datum pgnodemx_cgroup_setof_nkv(PG_FUNCTION_ARGS);
+Datum pgnodemx_backend_cgroup(PG_FUNCTION_ARGS);
+Datum pgnodemx_cgroup_members_delta(PG_FUNCTION_ARGS);
 Datum pgnodemx_envvar_text(PG_FUNCTION_ARGS);
 Datum pgnodemx_envvar_bigint(PG_FUNCTION_ARGS);
+Datum pgnodemx_envvar_all(PG_FUNCTION_ARGS);
 Datum pgnodemx_kdapi_setof_kv(PG_FUNCTION_ARGS);
 Datum pgnodemx_kdapi_scalar_bigint(PG_FUNCTION_ARGS);
+Datum pgnodemx_kdapi_value(PG_FUNCTION_ARGS);
+Datum pgnodemx_srf_support(PG_FUNCTION_ARGS);
 
 bool proc_enabled = false;
 
@@ -167,7 +230,12 @@ _PG_init(void)
 
 	DefineCustomStringVariable("pgnodemx.cgrouproot",
 							   "Path to root cgroup",
-							   NULL, &cgrouproot, "/sys/fs/cgroup", PGC_POSTMASTER,
+							   NULL, &cgrouproot, CGROUPROOT, PGC_POSTMASTER,
+							   0, NULL, NULL, NULL);
+
+	DefineCustomStringVariable("pgnodemx.procroot",
+							   "Path to root of procfs",
+							   NULL, &procroot, PROCFS, PGC_POSTMASTER,
 							   0, NULL, NULL, NULL);
 
 	DefineCustomBoolVariable("pgnodemx.kdapi_enabled",
@@ -180,6 +248,52 @@ _PG_init(void)
 							   NULL, &kdapi_path, "/etc/podinfo", PGC_POSTMASTER,
 							   0, NULL, NULL, NULL);
 
+	DefineCustomBoolVariable("pgnodemx.kdapi_cache",
+							 "True if parsed Kubernetes Downward API files are cached per backend",
+							 NULL, &kdapi_cache, true, PGC_USERSET,
+							 0, NULL, NULL, NULL);
+
+	DefineCustomBoolVariable("pgnodemx.stats_enabled",
+							 "True if pgnodemx tracks its own file access and parsing overhead",
+							 NULL, &stats_enabled, true, PGC_SUSET,
+							 0, NULL, NULL, NULL);
+
+	DefineCustomBoolVariable("pgnodemx.profile_enabled",
+							 "True if the backend wait event and kernel state profiler is started",
+							 NULL, &profile_enabled, false, PGC_POSTMASTER,
+							 0, NULL, NULL, NULL);
+
+	DefineCustomIntVariable("pgnodemx.profile_hz",
+							"Samples per second taken of backend wait events and kernel state",
+							"Zero pauses the profiler.",
+							&profile_hz, 10, 0, 1000, PGC_SIGHUP,
+							0, NULL, NULL, NULL);
+
+	DefineCustomBoolVariable("pgnodemx.query_stats_enabled",
+							 "True if per query operating system resource usage can be tracked",
+							 NULL, &query_stats_enabled, false, PGC_POSTMASTER,
+							 0, NULL, NULL, NULL);
+
+	DefineCustomBoolVariable("pgnodemx.track_queries",
+							 "True if operating system resource usage is tracked per query",
+							 NULL, &track_queries, false, PGC_SUSET,
+							 0, NULL, NULL, NULL);
+
+	/* shared memory for pgnodemx_stats() */
+	stats_init();
+
+	/* background worker and shared memory for backend_kernel_profile() */
+	profile_init();
+
+	/* shared memory for cgroup_members_delta() */
+	cgmembers_init();
+
+	/* shared memory and exit callback for backend_exit_stats() */
+	exitstats_init();
+
+	/* shared memory and executor hooks for query_os_stats(), if enabled */
+	qstats_init();
+
 	/* don't try to set cgmode unless cgroup is enabled */
 	if (set_cgmode())
 	{
@@ -269,13 +383,16 @@ PG_FUNCTION_INFO_V1(pgnodemx_cgroup_process_count);
 Datum
 pgnodemx_cgroup_process_count(PG_FUNCTION_ARGS)
 {
-	int64	   *cgpids;
+	int			result;
 
 	if (!cgroup_enabled)
 		PG_RETURN_NULL();
 
-	/* cgmembers returns pid count */
-	PG_RETURN_INT32(cgmembers(&cgpids));
+	/* cgmembers returns pid count; the pids themselves are not needed */
+	result = cgmembers(NULL);
+	stats_flush(fcinfo);
+
+	PG_RETURN_INT32(result);
 }
 
 PG_FUNCTION_INFO_V1(pgnodemx_cgroup_scalar_bigint);
@@ -283,13 +400,16 @@ Datum
 pgnodemx_cgroup_scalar_bigint(PG_FUNCTION_ARGS)
 {
 	char   *fqpath;
+	int64	result;
 
 	if (!cgroup_enabled)
 		PG_RETURN_NULL();
 
 	fqpath = get_fq_cgroup_path(fcinfo);
+	result = get_int64_from_file(fqpath);
+	stats_flush(fcinfo);
 
-	PG_RETURN_INT64(get_int64_from_file(fqpath));
+	PG_RETURN_INT64(result);
 }
 
 PG_FUNCTION_INFO_V1(pgnodemx_cgroup_scalar_float8);
@@ -297,13 +417,16 @@ Datum
 pgnodemx_cgroup_scalar_float8(PG_FUNCTION_ARGS)
 {
 	char   *fqpath;
+	double	result;
 
 	if (!cgroup_enabled)
 		PG_RETURN_NULL();
 
 	fqpath = get_fq_cgroup_path(fcinfo);
+	result = get_double_from_file(fqpath);
+	stats_flush(fcinfo);
 
-	PG_RETURN_FLOAT8(get_double_from_file(fqpath));
+	PG_RETURN_FLOAT8(result);
 }
 
 PG_FUNCTION_INFO_V1(pgnodemx_cgroup_scalar_text);
@@ -311,13 +434,16 @@ Datum
 pgnodemx_cgroup_scalar_text(PG_FUNCTION_ARGS)
 {
 	char   *fqpath;
+	char   *result;
 
 	if (!cgroup_enabled)
 		PG_RETURN_NULL();
 
 	fqpath = get_fq_cgroup_path(fcinfo);
+	result = get_string_from_file(fqpath);
+	stats_flush(fcinfo);
 
-	PG_RETURN_TEXT_P(cstring_to_text(get_string_from_file(fqpath)));
+	PG_RETURN_TEXT_P(cstring_to_text(result));
 }
 
 PG_FUNCTION_INFO_V1(pgnodemx_cgroup_setof_bigint);
@@ -362,6 +488,8 @@ pgnodemx_cgroup_array_text(PG_FUNCTION_ARGS)
 	fqpath = get_fq_cgroup_path(fcinfo);
 
 	values = parse_space_sep_val_file(fqpath, &nvals);
+	stats_flush(fcinfo);
+
 	dvalue = string_get_array_datum(values, nvals, TEXTOID, &isnull);
 	if (!isnull)
 		return dvalue;
@@ -386,6 +514,7 @@ pgnodemx_cgroup_array_bigint(PG_FUNCTION_ARGS)
 	fqpath = get_fq_cgroup_path(fcinfo);
 
 	values = parse_space_sep_val_file(fqpath, &nvals);
+	stats_flush(fcinfo);
 
 	/* deal with "max" */
 	for (i = 0; i < nvals; ++i)
@@ -578,6 +707,40 @@ pgnodemx_cgroup_setof_nkv(PG_FUNCTION_ARGS)
 	return (Datum) 0;
 }
 
+/*
+ * The cgroup of each backend, which may differ from the postmaster's
+ * where e.g. systemd delegation moves some roles' backends into child
+ * cgroups, and optionally the cpu usage of those cgroups.
+ */
+PG_FUNCTION_INFO_V1(pgnodemx_backend_cgroup);
+Datum
+pgnodemx_backend_cgroup(PG_FUNCTION_ARGS)
+{
+	bool		include_cpu_stat = PG_GETARG_BOOL(0);
+	int			nrow;
+	char	 ***values;
+
+	if (!cgroup_enabled || !proc_enabled)
+		return form_srf(fcinfo, NULL, 0, BACKEND_CGROUP_NCOL, int_text_5_bigint_sig);
+
+	values = backend_cgroup_rows(include_cpu_stat, &nrow);
+	return form_srf(fcinfo, values, nrow, BACKEND_CGROUP_NCOL, int_text_5_bigint_sig);
+}
+
+PG_FUNCTION_INFO_V1(pgnodemx_cgroup_members_delta);
+Datum
+pgnodemx_cgroup_members_delta(PG_FUNCTION_ARGS)
+{
+	int			nrow;
+	char	 ***values;
+
+	if (!cgroup_enabled)
+		return form_srf(fcinfo, NULL, 0, CGROUP_MEMBERS_DELTA_NCOL, bigint_text_text_sig);
+
+	values = cgroup_members_delta_rows(&nrow);
+	return form_srf(fcinfo, values, nrow, CGROUP_MEMBERS_DELTA_NCOL, bigint_text_text_sig);
+}
+
 PG_FUNCTION_INFO_V1(pgnodemx_envvar_text);
 Datum
 pgnodemx_envvar_text(PG_FUNCTION_ARGS)
@@ -622,59 +785,78 @@ pgnodemx_envvar_bigint(PG_FUNCTION_ARGS)
 	PG_RETURN_INT64(result);
 }
 
+PG_FUNCTION_INFO_V1(pgnodemx_envvar_all);
+Datum
+pgnodemx_envvar_all(PG_FUNCTION_ARGS)
+{
+	char	   *prefix = text_to_cstring(PG_GETARG_TEXT_PP(0));
+	char	 ***values;
+	int			nrow;
+
+	/* Limit use to members of special role */
+	pgnodemx_check_role();
+
+	values = get_env_rows(prefix, &nrow);
+
+	return form_srf(fcinfo, values, nrow, ENVVAR_ALL_NCOL,
+					text_text_bigint_bool_bigint_sig);
+}
+
 PG_FUNCTION_INFO_V1(pgnodemx_kdapi_setof_kv);
 Datum
 pgnodemx_kdapi_setof_kv(PG_FUNCTION_ARGS)
 {
 	char	   *fqpath;
-	int			nlines;
-	char	  **lines;
+	int			nrow;
+	char	 ***values;
 	int			ncol = 2;
 
 	if (!kdapi_enabled)
 		return form_srf(fcinfo, NULL, 0, ncol, text_text_sig);
 
 	fqpath = get_fq_kdapi_path(fcinfo);
-	lines = read_nlsv(fqpath, &nlines);
-	if (nlines > 0)
-	{
-		char	 ***values;
-		int			nrow = nlines;
-		int			i;
+	values = kdapi_get_kv(fqpath, &nrow);
 
-		values = (char ***) palloc(nrow * sizeof(char **));
-		for (i = 0; i < nrow; ++i)
-		{
-			/*
-			 * parse_keqv_line always returns two tokens
-			 * or throws an error if it cannot.
-			 */
-			values[i] = parse_keqv_line(lines[i]);
-		}
+	return form_srf(fcinfo, values, nrow, ncol, text_text_sig);
+}
 
-		return form_srf(fcinfo, values, nrow, ncol, text_text_sig);
-	}
+PG_FUNCTION_INFO_V1(pgnodemx_kdapi_scalar_bigint);
+Datum
+pgnodemx_kdapi_scalar_bigint(PG_FUNCTION_ARGS)
+{
+	char   *fqpath;
+	int64	result;
 
-	ereport(ERROR,
-			(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
-			errmsg("pgnodemx: no lines in Kubernetes Downward API file: %s ", fqpath)));
+	if (!kdapi_enabled)
+		PG_RETURN_NULL();
 
-	/* never reached */
-	return (Datum) 0;
+	fqpath = get_fq_kdapi_path(fcinfo);
+	result = kdapi_get_int64(fqpath);
+	stats_flush(fcinfo);
+
+	PG_RETURN_INT64(result);
 }
 
-PG_FUNCTION_INFO_V1(pgnodemx_kdapi_scalar_bigint);
+PG_FUNCTION_INFO_V1(pgnodemx_kdapi_value);
 Datum
-pgnodemx_kdapi_scalar_bigint(PG_FUNCTION_ARGS)
+pgnodemx_kdapi_value(PG_FUNCTION_ARGS)
 {
 	char   *fqpath;
+	char   *key;
+	char   *value;
 
 	if (!kdapi_enabled)
 		PG_RETURN_NULL();
 
 	fqpath = get_fq_kdapi_path(fcinfo);
+	key = text_to_cstring(PG_GETARG_TEXT_PP(1));
+	value = kdapi_get_value(fqpath, key);
+	stats_flush(fcinfo);
+
+	if (value == NULL)
+		PG_RETURN_NULL();
 
-	PG_RETURN_INT64(get_int64_from_file(fqpath));
+	PG_RETURN_TEXT_P(cstring_to_text(value));
 }
 
 PG_FUNCTION_INFO_V1(pgnodemx_fips_mode);
@@ -761,3 +943,84 @@ pgnodemx_version(PG_FUNCTION_ARGS)
 {
 	PG_RETURN_TEXT_P(cstring_to_text(GIT_HASH));
 }
+
+#if PG_VERSION_NUM >= 120000
+/*
+ * Row estimate for an SRF, or -1 to fall back to the declared ROWS.
+ * Nothing here reads the files the function itself would parse.
+ */
+static double
+srf_default_rows(const char *fname)
+{
+	static int	nblockdevs = -1;
+	static int	nnetdevs = -1;
+
+	if (strcmp(fname, "proc_pid_io") == 0 ||
+		strcmp(fname, "proc_pid_cmdline") == 0 ||
+		strcmp(fname, "proc_pid_stat") == 0 ||
+		strcmp(fname, "proc_pid_schedstat") == 0 ||
+		strcmp(fname, "proc_pid_status") == 0 ||
+		strcmp(fname, "proc_pid_fd_summary") == 0 ||
+		strcmp(fname, "backend_cgroup") == 0)
+		return MaxBackends;
+
+	if (strcmp(fname, "proc_schedstat") == 0)
+		return sysconf(_SC_NPROCESSORS_CONF);
+
+	/* one row per cpu for each of the ten softirq types */
+	if (strcmp(fname, "proc_softirqs") == 0)
+		return 10 * sysconf(_SC_NPROCESSORS_ONLN);
+
+	/* diskstats lists partitions too, as does /sys/class/block */
+	if (strcmp(fname, "proc_diskstats") == 0)
+	{
+		if (nblockdevs < 0)
+			nblockdevs = count_dir_entries("/sys/class/block");
+		return nblockdevs;
+	}
+
+	if (strcmp(fname, "proc_network_stats") == 0)
+	{
+		if (nnetdevs < 0)
+			nnetdevs = count_dir_entries("/sys/class/net");
+		return nnetdevs;
+	}
+
+	if (strcmp(fname, "cgroup_path") == 0 && cgpath != NULL)
+		return cgpath->nkvp;
+
+	return -1;
+}
+#endif
+
+/*
+ * Planner support function for the SRFs. Answers SupportRequestRows
+ * with a cheap estimate of the row count for the functions whose output
+ * size follows from the size of the system.
+ */
+PG_FUNCTION_INFO_V1(pgnodemx_srf_support);
+Datum
+pgnodemx_srf_support(PG_FUNCTION_ARGS)
+{
+#if PG_VERSION_NUM >= 120000
+	Node	   *rawreq = (Node *) PG_GETARG_POINTER(0);
+
+	if (IsA(rawreq, SupportRequestRows))
+	{
+		SupportRequestRows *req = (SupportRequestRows *) rawreq;
+		double		rows = -1;
+		char	   *fname;
+
+		if ((fname = get_func_name(req->funcid)) != NULL)
+			rows = srf_default_rows(fname);
+
+		if (rows >= 0)
+		{
+			req->rows = Max(rows, 1);
+			PG_RETURN_POINTER(req);
+		}
+	}
+#endif
+
+	PG_RETURN_POINTER(NULL);
+}
@@ -36,23 +36,29 @@
 #include <string.h>
 #include <sys/param.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 #include <sys/vfs.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "fmgr.h"
 #include "funcapi.h"
 #include "miscadmin.h"
 #include "access/htup_details.h"
+#include "catalog/catalog.h"
 #include "utils/tuplestore.h"
 #include "storage/fd.h"
 #include "utils/builtins.h"
+#include "utils/guc.h"
+#include "utils/hsearch.h"
 
 #include "fileutils.h"
 #include "genutils.h"
 #include "parseutils.h"
 #include "procfunc.h"
 #include "srfsigs.h"
+#include "stats.h"
 
 Datum pgnodemx_proc_meminfo(PG_FUNCTION_ARGS);
 Datum pgnodemx_fsinfo(PG_FUNCTION_ARGS);
@@ -60,9 +66,26 @@ Datum pgnodemx_network_stats(PG_FUNCTION_ARGS);
 Datum pgnodemx_proctab(PG_FUNCTION_ARGS);
 Datum pgnodemx_proc_cputime(PG_FUNCTION_ARGS);
 Datum pgnodemx_proc_loadavg(PG_FUNCTION_ARGS);
+Datum pgnodemx_proc_task_stat(PG_FUNCTION_ARGS);
+Datum pgnodemx_proc_pid_schedstat(PG_FUNCTION_ARGS);
+Datum pgnodemx_proc_schedstat(PG_FUNCTION_ARGS);
+Datum pgnodemx_proc_pid_status(PG_FUNCTION_ARGS);
+Datum pgnodemx_proc_pid_fd_summary(PG_FUNCTION_ARGS);
+Datum pgnodemx_proc_interrupts(PG_FUNCTION_ARGS);
+Datum pgnodemx_proc_softirqs(PG_FUNCTION_ARGS);
+Datum pgnodemx_proc_buddyinfo(PG_FUNCTION_ARGS);
+Datum pgnodemx_proc_zoneinfo(PG_FUNCTION_ARGS);
+Datum pgnodemx_hugepage_status(PG_FUNCTION_ARGS);
 
 static char *get_fullcmd(char *pid);
 static void get_uid_username( char *pid, char **uid, char **username );
+static void check_backend_pid(int pid);
+static int tid_cmp(const void *p1, const void *p2);
+static char *sched_wait_pct(int64 id, const char *wait_ns);
+static int classify_fd_target(const char *target);
+static Datum proc_irq_matrix(FunctionCallInfo fcinfo, const char *fname,
+							 bool has_totals);
+static int hugepage_size_cmp(const void *p1, const void *p2);
 
 /* human readable to bytes */
 #if PG_VERSION_NUM < 90600
@@ -72,21 +95,35 @@ static void get_uid_username( char *pid, char **uid, char **username );
   DatumGetInt64(DirectFunctionCall1(pg_size_bytes, PointerGetDatum(cstring_to_text(arg1))))
 #endif
 
-/* various /proc/ source files */
-#define PROCFS "/proc"
-#define diskstats		PROCFS "/diskstats"
-#define mountinfo		PROCFS "/self/mountinfo"
-#define meminfo			PROCFS "/meminfo"
-#define procstat		PROCFS "/stat"
-#define loadavg			PROCFS "/loadavg"
-#define netstat			PROCFS "/self/net/dev"
-#define pidiofmt		PROCFS "/%s/io"
-#define pidcmdfmt		PROCFS "/%s/cmdline"
-#define childpidsfmt	PROCFS "/%d/task/%d/children"
-#define pidstatfmt		PROCFS "/%s/stat"
+/* various /proc/ source files, relative to procroot */
+#define diskstats		"diskstats"
+#define mountinfo		"self/mountinfo"
+#define meminfo			"meminfo"
+#define procstat		"stat"
+#define loadavg			"loadavg"
+#define netstat			"self/net/dev"
+#define pidiofmt		"%s/%s/io"
+#define pidcmdfmt		"%s/%s/cmdline"
+#define childpidsfmt	"%s/%d/task/%d/children"
+#define pidstatfmt		"%s/%s/stat"
+#define pidtaskfmt		"%s/%d/task"
+#define pidschedstatfmt	"%s/%s/schedstat"
+#define pidstatusfmt	"%s/%s/status"
+#define pidfdfmt		"%s/%s/fd"
+#define schedstat		"schedstat"
+#define interrupts		"interrupts"
+#define softirqs		"softirqs"
+#define buddyinfo		"buddyinfo"
+#define zoneinfo		"zoneinfo"
+
+/* not under procroot */
+#define hugepagesdir	"/sys/kernel/mm/hugepages"
 
 extern bool proc_enabled;
 
+/* custom GUC vars */
+char *procroot = NULL;
+
 /*
  * "/proc" files: these files have all kinds of formats. For now
  * at least do not try to create generic parsing functions. Just
@@ -94,6 +131,21 @@ extern bool proc_enabled;
  * interesting (to us) files.
  */
 
+/*
+ * Concatenate the procfs relative filename with procroot. The returned
+ * value is a "fully qualified" path to the file of interest for the
+ * purposes of the "/proc" functions.
+ */
+char *
+get_fq_proc_path(const char *fname)
+{
+	StringInfo	ftr = makeStringInfo();
+
+	appendStringInfo(ftr, "%s/%s", procroot, fname);
+
+	return ftr->data;
+}
+
 /*
  * Check to see if procfs exists
  */
@@ -102,11 +154,27 @@ check_procfs(void)
 {
 	struct statfs sb;
 
-	/* Check if /proc is mounted. */
-	if (statfs(PROCFS, &sb) < 0 || sb.f_type != PROC_SUPER_MAGIC)
+	/* Check if procroot exists at all */
+	if (statfs(procroot, &sb) < 0)
 		return false;
-	else
+
+	/* Check if procroot is a real procfs mount */
+	if (sb.f_type == PROC_SUPER_MAGIC)
 		return true;
+
+	/*
+	 * The default location must be a real procfs mount. Anything else
+	 * was explicitly configured, presumably to point at a captured
+	 * snapshot of a procfs tree, so allow it.
+	 */
+	if (strcmp(procroot, PROCFS) == 0)
+		return false;
+
+	ereport(LOG,
+			(errmsg("pgnodemx: procroot %s is not a procfs mount", procroot),
+			 errdetail("treating it as a captured snapshot of procfs")));
+
+	return true;
 }
 
 /*
@@ -148,16 +216,35 @@ Datum
 pgnodemx_proc_diskstats(PG_FUNCTION_ARGS)
 {
 	int			nrow = 0;
-	int			ncol = 20;
+	char	 ***values;
+
+	if (!proc_enabled)
+		return form_srf(fcinfo, NULL, 0, PROC_DISKSTATS_NCOL, proc_diskstats_sig);
+
+	values = proc_diskstats_rows(NIL, NULL, &nrow);
+
+	return form_srf(fcinfo, values, nrow, PROC_DISKSTATS_NCOL, proc_diskstats_sig);
+}
+
+/*
+ * Build the rows for proc_diskstats. If devices is not NIL, only
+ * lines for the listed device names are returned. If needed is not
+ * NULL, columns not flagged in it are left NULL.
+ */
+char ***
+proc_diskstats_rows(List *devices, bool *needed, int *nrow)
+{
+	int			ncol = PROC_DISKSTATS_NCOL;
 	char	 ***values = (char ***) palloc(0);
 	char	  **lines;
 	int			nlines;
+	char	   *fqpath;
 
-	if (!proc_enabled)
-		return form_srf(fcinfo, NULL, 0, ncol, proc_diskstats_sig);
+	*nrow = 0;
 
 	/* read /proc/diskstats file */
-	lines = read_nlsv(diskstats, &nlines);
+	fqpath = get_fq_proc_path(diskstats);
+	lines = read_nlsv(fqpath, &nlines);
 
 	/*
 	 * These files have either 14,18, or 20 fields per line.
@@ -170,37 +257,39 @@ pgnodemx_proc_diskstats(PG_FUNCTION_ARGS)
 		int			j;
 		char	  **toks;
 
-		nrow = nlines;
-		values = (char ***) repalloc(values, nrow * sizeof(char **));
-		for (j = 0; j < nrow; ++j)
+		values = (char ***) repalloc(values, nlines * sizeof(char **));
+		for (j = 0; j < nlines; ++j)
 		{
 			int			ntok;
 			int			k;
 
-			values[j] = (char **) palloc(ncol * sizeof(char *));
-
 			toks = parse_ss_line(lines[j], &ntok);
 			if (ntok != 14 && ntok != 18  && ntok != 20)
 				ereport(ERROR,
 						(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
 						errmsg("pgnodemx: unexpected number of tokens, %d, in file %s, line %d",
-							   ntok, diskstats, j + 1)));
+							   ntok, fqpath, j + 1)));
 
+			if (devices != NIL && !cstring_in_list(toks[2], devices))
+				continue;
+
+			values[*nrow] = (char **) palloc(ncol * sizeof(char *));
 			for (k = 0; k < ncol; ++k)
 			{
-				if (k < ntok)
-					values[j][k] = pstrdup(toks[k]);
+				if (k < ntok && (needed == NULL || needed[k]))
+					values[*nrow][k] = toks[k];
 				else
-					values[j][k] = NULL;
+					values[*nrow][k] = NULL;
 			}
+			*nrow += 1;
 		}
 	}
 	else
 		ereport(ERROR,
 				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
-				errmsg("pgnodemx: no data in file: %s ", diskstats)));
+				errmsg("pgnodemx: no data in file: %s ", fqpath)));
 
-	return form_srf(fcinfo, values, nrow, ncol, proc_diskstats_sig);
+	return values;
 }
 
 /*
@@ -245,12 +334,14 @@ pgnodemx_proc_mountinfo(PG_FUNCTION_ARGS)
 	char	 ***values = (char ***) palloc(0);
 	char	  **lines;
 	int			nlines;
+	char	   *fqpath;
 
 	if (!proc_enabled)
 		return form_srf(fcinfo, NULL, 0, ncol, _4_bigint_6_text_sig);
 
 	/* read /proc/self/mountinfo file */
-	lines = read_nlsv(mountinfo, &nlines);
+	fqpath = get_fq_proc_path(mountinfo);
+	lines = read_nlsv(fqpath, &nlines);
 
 	/*
 	 * These files are complicated - see above.
@@ -277,7 +368,7 @@ pgnodemx_proc_mountinfo(PG_FUNCTION_ARGS)
 				ereport(ERROR,
 						(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
 						errmsg("pgnodemx: unexpected number of tokens, %d, in file %s, line %d",
-							   ntok, mountinfo, j + 1)));
+							   ntok, fqpath, j + 1)));
 
 			/* iterate all found columns and keep the ones we want */
 			for (k = 0; k < ntok; ++k)
@@ -300,7 +391,7 @@ pgnodemx_proc_mountinfo(PG_FUNCTION_ARGS)
 							ereport(ERROR,
 									(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
 									errmsg("pgnodemx: missing \":\" in file %s, line %d",
-										   mountinfo, j + 1)));
+										   fqpath, j + 1)));
 
 						len = (p - toks[k]);
 						values[j][c] = pnstrdup(toks[k], len);
@@ -324,13 +415,13 @@ pgnodemx_proc_mountinfo(PG_FUNCTION_ARGS)
 				ereport(ERROR,
 						(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
 						errmsg("pgnodemx: malformed line in file %s, line %d",
-							   mountinfo, j + 1)));
+							   fqpath, j + 1)));
 		}
 	}
 	else
 		ereport(ERROR,
 				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
-				errmsg("pgnodemx: no data in file: %s ", mountinfo)));
+				errmsg("pgnodemx: no data in file: %s ", fqpath)));
 
 	return form_srf(fcinfo, values, nrow, ncol, _4_bigint_6_text_sig);
 }
@@ -338,32 +429,47 @@ pgnodemx_proc_mountinfo(PG_FUNCTION_ARGS)
 PG_FUNCTION_INFO_V1(pgnodemx_proc_meminfo);
 Datum
 pgnodemx_proc_meminfo(PG_FUNCTION_ARGS)
+{
+	int			nrow = 0;
+	char	 ***values;
+
+	if (!proc_enabled)
+		return form_srf(fcinfo, NULL, 0, PROC_MEMINFO_NCOL, text_bigint_sig);
+
+	values = proc_meminfo_rows(NIL, NULL, &nrow);
+
+	return form_srf(fcinfo, values, nrow, PROC_MEMINFO_NCOL, text_bigint_sig);
+}
+
+/*
+ * Build the rows for proc_meminfo. If keys is not NIL, only the
+ * listed keys are returned. If needed is not NULL and does not flag
+ * the value column, the unit conversion is skipped and it is left NULL.
+ */
+char ***
+proc_meminfo_rows(List *keys, bool *needed, int *nrow)
 {
 	int			nlines;
 	char	  **lines;
-	int			ncol = 2;
+	int			ncol = PROC_MEMINFO_NCOL;
+	char	   *fqpath;
 
-	if (!proc_enabled)
-		return form_srf(fcinfo, NULL, 0, ncol, text_bigint_sig);
+	*nrow = 0;
 
-	lines = read_nlsv(meminfo, &nlines);
+	fqpath = get_fq_proc_path(meminfo);
+	lines = read_nlsv(fqpath, &nlines);
 	if (nlines > 0)
 	{
 		char	 ***values;
-		int			nrow = nlines;
 		int			i;
 		char	  **fkl;
 
-		values = (char ***) palloc(nrow * sizeof(char **));
-		for (i = 0; i < nrow; ++i)
+		values = (char ***) palloc(nlines * sizeof(char **));
+		for (i = 0; i < nlines; ++i)
 		{
 			size_t		len;
-			StringInfo	hbytes = makeStringInfo();
-			int64		nbytes;
 			int			ntok;
 
-			values[i] = (char **) palloc(ncol * sizeof(char *));
-
 			/*
 			 * These lines look like "<key>:_some_spaces_<val>_<unit>
 			 * We usually get back 3 tokens but sometimes 2 (no unit).
@@ -374,33 +480,43 @@ pgnodemx_proc_meminfo(PG_FUNCTION_ARGS)
 				ereport(ERROR,
 						(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
 						errmsg("pgnodemx: unexpected number of tokens, %d, in file %s, line %d",
-							   ntok, meminfo, i + 1)));
+							   ntok, fqpath, i + 1)));
 
 			/* token 1 will end with an extraneous colon - strip that */
 			len = strlen(fkl[0]) - 1;
 			fkl[0][len] = '\0';
-			values[i][0] = pstrdup(fkl[0]);
+
+			if (keys != NIL && !cstring_in_list(fkl[0], keys))
+				continue;
+
+			values[*nrow] = (char **) palloc(ncol * sizeof(char *));
+			values[*nrow][0] = fkl[0];
 
 			/* reconstruct tok 2 and 3 and then convert to bytes */
-			if (ntok == 3)
+			if (needed != NULL && !needed[1])
+				values[*nrow][1] = NULL;
+			else if (ntok == 3)
 			{
+				StringInfo	hbytes = makeStringInfo();
+
 				appendStringInfo(hbytes, "%s %s", fkl[1], fkl[2]);
-				nbytes = h2b(hbytes->data);
-				values[i][1] = int64_to_string(nbytes);
+				values[*nrow][1] = int64_to_string(h2b(hbytes->data));
 			}
 			else
-				values[i][1] = fkl[1];
+				values[*nrow][1] = fkl[1];
+
+			*nrow += 1;
 		}
 
-		return form_srf(fcinfo, values, nrow, ncol, text_bigint_sig);
+		return values;
 	}
 
 	ereport(ERROR,
 			(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
-			errmsg("pgnodemx: no lines in file: %s ", meminfo)));
+			errmsg("pgnodemx: no lines in file: %s ", fqpath)));
 
 	/* never reached */
-	return (Datum) 0;
+	return NULL;
 }
 
 PG_FUNCTION_INFO_V1(pgnodemx_fsinfo);
@@ -429,12 +545,14 @@ pgnodemx_network_stats(PG_FUNCTION_ARGS)
 	char	 ***values = (char ***) palloc(0);
 	char	  **lines;
 	int			nlines;
+	char	   *fqpath;
 
 	if (!proc_enabled)
 		return form_srf(fcinfo, NULL, 0, ncol, text_16_bigint_sig);
 
 	/* read /proc/self/net/dev file */
-	lines = read_nlsv(netstat, &nlines);
+	fqpath = get_fq_proc_path(netstat);
+	lines = read_nlsv(fqpath, &nlines);
 
 	/*
 	 * These files have two rows we want to skip at the top.
@@ -463,7 +581,7 @@ pgnodemx_network_stats(PG_FUNCTION_ARGS)
 				ereport(ERROR,
 						(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
 						errmsg("pgnodemx: unexpected number of tokens, %d, in file %s, line %d",
-							   ntok, netstat, j + 1)));
+							   ntok, fqpath, j + 1)));
 
 			/* token 1 will end with an extraneous colon - strip that */
 			len = strlen(toks[0]) - 1;
@@ -478,250 +596,778 @@ pgnodemx_network_stats(PG_FUNCTION_ARGS)
 	else
 		ereport(ERROR,
 				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
-				errmsg("pgnodemx: no data in file: %s ", netstat)));
+				errmsg("pgnodemx: no data in file: %s ", fqpath)));
 
 	return form_srf(fcinfo, values, nrow, ncol, text_16_bigint_sig);
 }
 
-PG_FUNCTION_INFO_V1(pgnodemx_proc_pid_io);
-Datum pgnodemx_proc_pid_io(PG_FUNCTION_ARGS)
+/*
+ * Returns the pids of all postgres backends, i.e. the children of the
+ * postmaster, as strings. Sets npids to the number found. Uses
+ * PostmasterPid rather than getppid() so that the result is the same
+ * whatever process asks, e.g. a parallel worker.
+ */
+char **
+get_backend_pids(int *npids)
+{
+	StringInfo	fname = makeStringInfo();
+	pid_t		ppid = PostmasterPid;
+
+	appendStringInfo(fname, childpidsfmt, procroot, ppid, ppid);
+	/* read /proc/<ppid>/task/<ppid>/children file */
+	return parse_space_sep_val_file(fname->data, npids);
+}
+
+/*
+ * Common body of the SRFs returning one row per backend pid. needed
+ * is passed through to rowfn.
+ */
+static Datum
+pid_rows_srf(FunctionCallInfo fcinfo, pid_row_fn rowfn, int ncol, Oid *srf_sig,
+			 bool *needed)
 {
 	int			nrow = 0;
-	int			ncol = 8;
 	char	  **child_pids;
-	pid_t		ppid;
-	char	 ***values = (char ***) palloc(0);
-	StringInfo	fname = makeStringInfo();
+	char	 ***values;
+	int			j;
 
 	if (!proc_enabled)
-		return form_srf(fcinfo, NULL, 0, ncol, int_7_numeric_sig);
+		return form_srf(fcinfo, NULL, 0, ncol, srf_sig);
 
 	/* Get pid of all client connections. */
-	ppid = getppid();
-	appendStringInfo(fname, childpidsfmt, ppid, ppid);
-	/* read /proc/<ppid>/task/<ppid>/children file */
-	child_pids = parse_space_sep_val_file(fname->data, &nrow);
+	child_pids = get_backend_pids(&nrow);
+	if (nrow < 1)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				errmsg("pgnodemx: no postmaster child pids found")));
 
-	if (nrow > 0)
-	{
-		int j;
+	/* nrow is the number of child pids we will be getting stats for */
+	values = (char ***) palloc(nrow * sizeof(char **));
+	for (j = 0; j < nrow; ++j)
+		values[j] = rowfn(child_pids[j], needed);
 
-		/* nrow is the number of child pids we will be getting stats for */
-		values = (char ***) repalloc(values, nrow * sizeof(char **));
+	return form_srf(fcinfo, values, nrow, ncol, srf_sig);
+}
 
-		/* iterate through child pids */
-		for (j = 0; j < nrow; ++j)
-		{
-			int		nlines;
-			char ***iostat;
-			int		i;
-			int		k = 0;
+PG_FUNCTION_INFO_V1(pgnodemx_proc_pid_io);
+Datum pgnodemx_proc_pid_io(PG_FUNCTION_ARGS)
+{
+	return pid_rows_srf(fcinfo, proc_pid_io_row,
+						PROC_PID_IO_NCOL, int_7_numeric_sig, NULL);
+}
 
-			values[j] = (char **) palloc(ncol * sizeof(char *));
+/*
+ * One proc_pid_io row, from "/proc/<pid>/io". If needed is given, the
+ * file is walked in place and only the values of columns flagged in it
+ * are kept; the others are left NULL.
+ */
+char **
+proc_pid_io_row(char *pid, bool *needed)
+{
+	int			ncol = PROC_PID_IO_NCOL;
+	char	  **values;
+	StringInfo	fname = makeStringInfo();
+	int			nlines;
+	char	 ***iostat;
+	int			i;
+	int			k = 0;
 
-			/* read io for current child pid */
-			resetStringInfo(fname);
-			appendStringInfo(fname, pidiofmt, child_pids[j]);
-			/* read "/proc/<child-pid>/io file" */
-			iostat = read_kv_file(fname->data, &nlines);
+	appendStringInfo(fname, pidiofmt, procroot, pid);
 
-			if (nlines != ncol - 1)
-				ereport(ERROR,
-						(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
-						errmsg("pgnodemx: expected %d tokens, got %d in keyed file %s",
-							   ncol - 1, nlines, fname->data)));
+	if (needed != NULL)
+	{
+		char	   *line;
+		char	   *next;
+
+		values = (char **) palloc0(ncol * sizeof(char *));
+		values[0] = pstrdup(pid);
 
-			/* inject the current child pid number as first column */
-			values[j][k++] = pstrdup(child_pids[j]);
-			for (i = 0; i < nlines ; i++ )
+		nlines = 0;
+		for (line = read_vfs(fname->data); *line != '\0'; line = next)
+		{
+			if ((next = strchr(line, '\n')) != NULL)
+				*next++ = '\0';
+			else
+				next = line + strlen(line);
+
+			if (*line == '\0')
+				continue;
+
+			/* column 0 is the pid, so line n is column n + 1 */
+			if (++nlines < ncol && needed[nlines])
 			{
-				/*
-				 * We only care about the values, not the keys
-				 * because each key gets its own column in the
-				 * output.
-				 */
-				values[j][k++] = pstrdup(iostat[i][1]);
+				char	   *val = strchr(line, ' ');
+
+				if (val == NULL)
+					ereport(ERROR,
+							(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+							errmsg("pgnodemx: incorrect format for key value line"),
+							errdetail("pgnodemx: expected 2 tokens, found 1, file %s",
+									  fname->data)));
+				while (*val == ' ')
+					val++;
+				values[nlines] = val;
 			}
 		}
+		stats_lines_parsed(nlines);
 
-		return form_srf(fcinfo, values, nrow, ncol, int_7_numeric_sig);
+		if (nlines != ncol - 1)
+			ereport(ERROR,
+					(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+					errmsg("pgnodemx: expected %d tokens, got %d in keyed file %s",
+						   ncol - 1, nlines, fname->data)));
+
+		return values;
 	}
-	ereport(ERROR,
-			(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
-			errmsg("pgnodemx: no lines in flat keyed file: %s ", fname->data)));
 
-	/* never reached */
-	return (Datum) 0;
+	values = (char **) palloc(ncol * sizeof(char *));
+	/* read "/proc/<child-pid>/io file" */
+	iostat = read_kv_file(fname->data, &nlines);
+
+	if (nlines != ncol - 1)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				errmsg("pgnodemx: expected %d tokens, got %d in keyed file %s",
+					   ncol - 1, nlines, fname->data)));
+
+	/* inject the current child pid number as first column */
+	values[k++] = pstrdup(pid);
+	for (i = 0; i < nlines ; i++ )
+	{
+		/*
+		 * We only care about the values, not the keys
+		 * because each key gets its own column in the
+		 * output.
+		 */
+		values[k++] = iostat[i][1];
+	}
+
+	return values;
 }
 
 PG_FUNCTION_INFO_V1(pgnodemx_proc_pid_cmdline);
 Datum pgnodemx_proc_pid_cmdline(PG_FUNCTION_ARGS)
 {
-	int			nrow = 0;
-	int			ncol = 4;
-	char	  **child_pids;
-	pid_t		ppid;
-	char	 ***values = (char ***) palloc(0);
+	return pid_rows_srf(fcinfo, proc_pid_cmdline_row,
+						PROC_PID_CMDLINE_NCOL, int_text_int_text_sig, NULL);
+}
+
+/*
+ * One proc_pid_cmdline row. The command line and the owner lookups
+ * are skipped for columns not flagged in needed, if given.
+ */
+char **
+proc_pid_cmdline_row(char *pid, bool *needed)
+{
+	int			ncol = PROC_PID_CMDLINE_NCOL;
+	char	  **values = (char **) palloc0(ncol * sizeof(char *));
+
+	/* inject the current child pid number as first column */
+	values[0] = pstrdup(pid);
+
+	/* full command line as second column */
+	if (needed == NULL || needed[1])
+		values[1] = get_fullcmd(pid);
+
+	/* get uid and username for process */
+	if (needed == NULL || needed[2] || needed[3])
+		get_uid_username(pid, &values[2], &values[3]);
+
+	return values;
+}
+
+PG_FUNCTION_INFO_V1(pgnodemx_proc_pid_stat);
+Datum pgnodemx_proc_pid_stat(PG_FUNCTION_ARGS)
+{
+	return pid_rows_srf(fcinfo, proc_pid_stat_row,
+						PROC_PID_STAT_NCOL, proc_pid_stat_sig, NULL);
+}
+
+/*
+ * One proc_pid_stat row, from "/proc/<pid>/stat". If needed is given,
+ * only the fields of columns flagged in it are split out, and the line
+ * is not parsed past the last of them; the others are left NULL.
+ */
+char **
+proc_pid_stat_row(char *pid, bool *needed)
+{
+	int			ncol = PROC_PID_STAT_NCOL;
 	StringInfo	fname = makeStringInfo();
+	char	   *rawstr;
+	char	  **values;
+	int			ntok;
+
+	appendStringInfo(fname, pidstatfmt, procroot, pid);
+	/* read "/proc/<child-pid>/stat file" */
+	rawstr = get_string_from_file(fname->data);
+
+	if (needed != NULL)
+	{
+		int			last;
+
+		for (last = ncol - 1; last >= 0 && !needed[last]; last--)
+			;
+
+		values = parse_pid_stat_fields(rawstr, needed, ncol, &ntok);
+		if (ntok <= last)
+			ereport(ERROR,
+					(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+					errmsg("pgnodemx: expected %d tokens, got %d in space separated file %s",
+						   ncol, ntok, fname->data)));
+
+		return values;
+	}
+
+	values = parse_pid_stat_line(rawstr, &ntok);
+	if (ntok != ncol)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				errmsg("pgnodemx: expected %d tokens, got %d in space separated file %s",
+					   ncol, ntok, fname->data)));
+
+	return values;
+}
+
+PG_FUNCTION_INFO_V1(pgnodemx_proc_task_stat);
+Datum
+pgnodemx_proc_task_stat(PG_FUNCTION_ARGS)
+{
+	int			pid = PG_GETARG_INT32(0);
+	int			ncol = PROC_TASK_STAT_NCOL;
+	StringInfo	taskdir = makeStringInfo();
+	DIR		   *dir;
+	struct dirent *de;
+	char	  **tids = (char **) palloc(0);
+	int			ntids = 0;
+	char	 ***values;
+	int			nrow = 0;
+	int			i;
 
 	if (!proc_enabled)
-		return form_srf(fcinfo, NULL, 0, ncol, int_text_int_text_sig);
+		return form_srf(fcinfo, NULL, 0, ncol, proc_task_stat_sig);
 
-	/* Get pid of all client connections. */
-	ppid = getppid();
-	appendStringInfo(fname, childpidsfmt, ppid, ppid);
-	/* read /proc/<ppid>/task/<ppid>/children file */
-	child_pids = parse_space_sep_val_file(fname->data, &nrow);
+	check_backend_pid(pid);
+
+	appendStringInfo(taskdir, pidtaskfmt, procroot, pid);
+	if ((dir = AllocateDir(taskdir->data)) == NULL)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("pgnodemx: could not open directory \"%s\": %m",
+						taskdir->data)));
+	while ((de = ReadDir(dir, taskdir->data)) != NULL)
+	{
+		if (!isdigit((unsigned char) de->d_name[0]))
+			continue;
+		tids = (char **) repalloc(tids, (ntids + 1) * sizeof(char *));
+		tids[ntids++] = pstrdup(de->d_name);
+	}
+	FreeDir(dir);
+	qsort(tids, ntids, sizeof(char *), tid_cmp);
 
-	if (nrow > 0)
+	values = (char ***) palloc(Max(ntids, 1) * sizeof(char **));
+	for (i = 0; i < ntids; ++i)
 	{
-		int j;
+		StringInfo	fname = makeStringInfo();
+		char	   *rawstr;
+		char	  **stat;
+		int			ntok;
+		char	  **row;
+
+		/* a thread may exit while we look; just leave it out */
+		appendStringInfo(fname, "%s/%s/stat", taskdir->data, tids[i]);
+		if ((rawstr = read_file_or_null(fname->data)) == NULL)
+			continue;
+
+		stat = parse_pid_stat_line(rawstr, &ntok);
+		if (ntok < 39)
+			ereport(ERROR,
+					(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+					errmsg("pgnodemx: expected at least %d tokens, got %d in space separated file %s",
+						   39, ntok, fname->data)));
+
+		row = (char **) palloc0(ncol * sizeof(char *));
+		row[0] = psprintf("%d", pid);
+		row[1] = stat[0];		/* tid */
+		row[2] = stat[1];		/* comm */
+		row[3] = stat[2];		/* state */
+		row[4] = stat[38];		/* processor */
+		row[5] = stat[13];		/* utime */
+		row[6] = stat[14];		/* stime */
+		row[7] = stat[9];		/* minflt */
+		row[8] = stat[11];		/* majflt */
+		row[9] = stat[17];		/* priority */
+		row[10] = stat[18];		/* nice */
+		row[11] = stat[21];		/* starttime */
+
+		/* schedstat needs CONFIG_SCHED_INFO; NULL without it */
+		resetStringInfo(fname);
+		appendStringInfo(fname, "%s/%s/schedstat", taskdir->data, tids[i]);
+		if ((rawstr = read_file_or_null(fname->data)) != NULL)
+		{
+			char  **sched = parse_ss_line(rawstr, &ntok);
 
-		/* nrow is the number of child pids we will be getting stats for */
-		values = (char ***) repalloc(values, nrow * sizeof(char **));
+			if (ntok == 3)
+			{
+				row[12] = sched[0];		/* ns on cpu */
+				row[13] = sched[1];		/* ns waiting on a runqueue */
+				row[14] = sched[2];		/* timeslices */
+			}
+		}
 
-		/* iterate through child pids */
-		for (j = 0; j < nrow; ++j)
+		values[nrow++] = row;
+	}
+
+	return form_srf(fcinfo, values, nrow, ncol, proc_task_stat_sig);
+}
+
+PG_FUNCTION_INFO_V1(pgnodemx_proc_pid_schedstat);
+Datum pgnodemx_proc_pid_schedstat(PG_FUNCTION_ARGS)
+{
+	return pid_rows_srf(fcinfo, proc_pid_schedstat_row,
+						PROC_PID_SCHEDSTAT_NCOL, int_3_numeric_float8_sig, NULL);
+}
+
+/*
+ * One proc_pid_schedstat row, from "/proc/<pid>/schedstat": time on
+ * cpu and waiting on a runqueue in ns, and the number of timeslices.
+ * All but the pid are NULL if the kernel does not provide the file.
+ */
+char **
+proc_pid_schedstat_row(char *pid, bool *needed)
+{
+	int			ncol = PROC_PID_SCHEDSTAT_NCOL;
+	char	  **values = (char **) palloc0(ncol * sizeof(char *));
+	StringInfo	fname = makeStringInfo();
+	char	   *rawstr;
+
+	values[0] = pstrdup(pid);
+
+	appendStringInfo(fname, pidschedstatfmt, procroot, pid);
+	if ((rawstr = read_file_or_null(fname->data)) != NULL)
+	{
+		int		ntok;
+		char  **toks = parse_ss_line(rawstr, &ntok);
+
+		if (ntok == 3)
 		{
-			char   *uid;
-			char   *username;
+			values[1] = toks[0];
+			values[2] = toks[1];
+			values[3] = toks[2];
+			values[4] = sched_wait_pct(atoi(pid), toks[1]);
+		}
+	}
 
-			values[j] = (char **) palloc(ncol * sizeof(char *));
+	return values;
+}
+
+PG_FUNCTION_INFO_V1(pgnodemx_proc_pid_status);
+Datum pgnodemx_proc_pid_status(PG_FUNCTION_ARGS)
+{
+	return pid_rows_srf(fcinfo, proc_pid_status_row,
+						PROC_PID_STATUS_NCOL, int_9_bigint_sig, NULL);
+}
+
+/*
+ * One proc_pid_status row, from "/proc/<pid>/status". Only the keys
+ * below are looked at, by a switch on their first character, and
+ * those not flagged in needed are skipped. Sizes are converted from kB
+ * to bytes. Keys the kernel does not provide, e.g. RssShmem before
+ * 4.5, are left NULL, as is the whole row if the process has exited.
+ */
+char **
+proc_pid_status_row(char *pid, bool *needed)
+{
+	int			ncol = PROC_PID_STATUS_NCOL;
+	char	  **values = (char **) palloc0(ncol * sizeof(char *));
+	StringInfo	fname = makeStringInfo();
+	char	   *rawstr;
+	char	   *line;
+	char	   *next;
 
-			/* inject the current child pid number as first column */
-			values[j][0] = pstrdup(child_pids[j]);
+	values[0] = pstrdup(pid);
 
-			/* full command line as second column */
-			values[j][1] = get_fullcmd(child_pids[j]);
+	appendStringInfo(fname, pidstatusfmt, procroot, pid);
+	if ((rawstr = read_file_or_null(fname->data)) == NULL)
+		return values;
 
-			/* get uid and username for process */
-			get_uid_username(child_pids[j], &uid, &username);
-			values[j][2] = pstrdup(uid);
-			values[j][3] = pstrdup(username);
+	for (line = rawstr; line != NULL && *line != '\0'; line = next)
+	{
+		char	   *val;
+		char	   *endptr;
+		int64		result;
+		int			col = -1;
+		bool		kb = true;
+
+		if ((next = strchr(line, '\n')) != NULL)
+			*next++ = '\0';
+		if ((val = strchr(line, ':')) == NULL)
+			continue;
+		*val++ = '\0';
+
+		switch (line[0])
+		{
+			case 'V':
+				if (strcmp(line, "VmHWM") == 0)
+					col = 1;
+				else if (strcmp(line, "VmRSS") == 0)
+					col = 2;
+				else if (strcmp(line, "VmSwap") == 0)
+					col = 6;
+				break;
+			case 'R':
+				if (strcmp(line, "RssAnon") == 0)
+					col = 3;
+				else if (strcmp(line, "RssFile") == 0)
+					col = 4;
+				else if (strcmp(line, "RssShmem") == 0)
+					col = 5;
+				break;
+			case 'T':
+				if (strcmp(line, "Threads") == 0)
+					col = 7, kb = false;
+				break;
+			case 'v':
+				if (strcmp(line, "voluntary_ctxt_switches") == 0)
+					col = 8, kb = false;
+				break;
+			case 'n':
+				if (strcmp(line, "nonvoluntary_ctxt_switches") == 0)
+					col = 9, kb = false;
+				break;
 		}
 
-		return form_srf(fcinfo, values, nrow, ncol, int_text_int_text_sig);
+		if (col < 0 || (needed != NULL && !needed[col]))
+			continue;
+
+		errno = 0;
+		result = strtoll(val, &endptr, 10);
+		if (errno != 0 || endptr == val)
+			ereport(ERROR,
+					(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+					errmsg("pgnodemx: invalid value for %s in file %s",
+						   line, fname->data)));
+
+		values[col] = int64_to_string(kb ? result * 1024 : result);
 	}
-	ereport(ERROR,
-			(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
-			errmsg("pgnodemx: no lines in space separated file: %s ", fname->data)));
 
-	/* never reached */
-	return (Datum) 0;
+	return values;
 }
 
-PG_FUNCTION_INFO_V1(pgnodemx_proc_pid_stat);
-Datum pgnodemx_proc_pid_stat(PG_FUNCTION_ARGS)
+/* not exported by older glibc */
+typedef struct pgnxDirent64
 {
-	int			nrow = 0;
-	int			ncol = 52;
-	char	  **child_pids;
-	pid_t		ppid;
-	char	 ***values = (char ***) palloc(0);
+	uint64			d_ino;
+	int64			d_off;
+	unsigned short	d_reclen;
+	unsigned char	d_type;
+	char			d_name[FLEXIBLE_ARRAY_MEMBER];
+} pgnxDirent64;
+
+/* before PostgreSQL 11 this is private to fd.c */
+#ifndef PG_TEMP_FILES_DIR
+#define PG_TEMP_FILES_DIR "pgsql_tmp"
+#endif
+
+/* proc_pid_fd_summary column of each class, after pid and total */
+#define FD_CLASS_RELATION	2
+#define FD_CLASS_WAL		3
+#define FD_CLASS_TEMP		4
+#define FD_CLASS_SOCKET		5
+#define FD_CLASS_PIPE		6
+#define FD_CLASS_OTHER		7
+
+/*
+ * Open file descriptor counts per backend, optionally broken down by
+ * what they point to. Not classifying saves a readlink per descriptor.
+ */
+PG_FUNCTION_INFO_V1(pgnodemx_proc_pid_fd_summary);
+Datum pgnodemx_proc_pid_fd_summary(PG_FUNCTION_ARGS)
+{
+	bool		classify = PG_GETARG_BOOL(0);
+	bool		needed[PROC_PID_FD_SUMMARY_NCOL];
+	int			i;
+
+	for (i = 0; i < PROC_PID_FD_SUMMARY_NCOL; ++i)
+		needed[i] = classify || i < FD_CLASS_RELATION;
+
+	return pid_rows_srf(fcinfo, proc_pid_fd_summary_row,
+						PROC_PID_FD_SUMMARY_NCOL, int_7_bigint_sig, needed);
+}
+
+/*
+ * One proc_pid_fd_summary row, from the "/proc/<pid>/fd" directory.
+ * The entries are listed with getdents64 into a fixed buffer, and each
+ * link is only read, with readlinkat, if a class column is needed, so
+ * the link targets are never collected. All but the pid are NULL if
+ * the process has exited.
+ */
+char **
+proc_pid_fd_summary_row(char *pid, bool *needed)
+{
+	int			ncol = PROC_PID_FD_SUMMARY_NCOL;
+	char	  **values = (char **) palloc0(ncol * sizeof(char *));
+	int64		counts[PROC_PID_FD_SUMMARY_NCOL];
 	StringInfo	fname = makeStringInfo();
+	bool		classify = false;
+	long		buf[1024];
+	char		target[MAXPGPATH];
+	size_t		nbytes = 0;
+	int			nreads = 0;
+	int			dirfd;
+	int			i;
+
+	values[0] = pstrdup(pid);
+
+	for (i = FD_CLASS_RELATION; i < ncol; ++i)
+		classify |= (needed == NULL || needed[i]);
+
+	appendStringInfo(fname, pidfdfmt, procroot, pid);
+	/* through fd.c, so the descriptor is closed on error and counted */
+#if PG_VERSION_NUM >= 110000
+	dirfd = OpenTransientFile(fname->data, O_RDONLY | O_DIRECTORY);
+#else
+	dirfd = OpenTransientFile(fname->data, O_RDONLY | O_DIRECTORY, 0);
+#endif
+	if (dirfd < 0)
+		return values;
+	stats_read_begin();
+
+	memset(counts, 0, sizeof(counts));
+	for (;;)
+	{
+		long		nread;
+		long		off;
+
+		nread = syscall(SYS_getdents64, dirfd, buf, sizeof(buf));
+		if (nread < 0)
+		{
+			CloseTransientFile(dirfd);
+			stats_read_end(nbytes, nreads);
+			return values;
+		}
+		if (nread == 0)
+			break;
+
+		nbytes += nread;
+		nreads += 1;
+		for (off = 0; off < nread; )
+		{
+			pgnxDirent64   *d = (pgnxDirent64 *) ((char *) buf + off);
+			ssize_t			len;
+
+			off += d->d_reclen;
+			if (d->d_name[0] == '.')
+				continue;
+
+			counts[1] += 1;
+			if (!classify)
+				continue;
+
+			/* the descriptor may have been closed since it was listed */
+			len = readlinkat(dirfd, d->d_name, target, sizeof(target) - 1);
+			if (len < 0)
+				continue;
+			target[len] = '\0';
+			counts[classify_fd_target(target)] += 1;
+		}
+	}
+	CloseTransientFile(dirfd);
+	stats_read_end(nbytes, nreads);
+
+	for (i = 1; i < ncol; ++i)
+	{
+		if (needed == NULL || needed[i])
+			values[i] = int64_to_string(counts[i]);
+	}
+
+	return values;
+}
+
+/*
+ * Classify the target of a /proc/<pid>/fd link. The link shows the
+ * path after any symlinks are resolved, e.g. a relocated pg_wal or a
+ * tablespace, so the path is matched by its last components rather
+ * than by the data directory.
+ */
+static int
+classify_fd_target(const char *target)
+{
+	const char *base;
+
+	if (strncmp(target, "socket:", 7) == 0)
+		return FD_CLASS_SOCKET;
+	if (strncmp(target, "pipe:", 5) == 0)
+		return FD_CLASS_PIPE;
+	if (target[0] != '/')
+		return FD_CLASS_OTHER;
+
+	if (strstr(target, "/" PG_TEMP_FILES_DIR) != NULL)
+		return FD_CLASS_TEMP;
+
+	/* WAL segment names are 24 hex digits */
+	base = strrchr(target, '/') + 1;
+	if (strlen(base) == 24 && strspn(base, "0123456789ABCDEF") == 24)
+		return FD_CLASS_WAL;
+
+	if (strstr(target, "/base/") != NULL ||
+		strstr(target, "/global/") != NULL ||
+		strstr(target, "/" TABLESPACE_VERSION_DIRECTORY "/") != NULL)
+		return FD_CLASS_RELATION;
+
+	return FD_CLASS_OTHER;
+}
+
+/*
+ * Per cpu totals from "/proc/schedstat". The domain lines are skipped.
+ */
+PG_FUNCTION_INFO_V1(pgnodemx_proc_schedstat);
+Datum
+pgnodemx_proc_schedstat(PG_FUNCTION_ARGS)
+{
+	int			ncol = PROC_SCHEDSTAT_NCOL;
+	char	   *fname;
+	char	  **lines;
+	int			nlines;
+	char	 ***values;
+	int			nrow = 0;
+	int			i;
 
 	if (!proc_enabled)
-		return form_srf(fcinfo, NULL, 0, ncol, proc_pid_stat_sig);
+		return form_srf(fcinfo, NULL, 0, ncol, text_8_numeric_float8_sig);
 
-	/* Get pid of all client connections. */
-	ppid = getppid();
-	appendStringInfo(fname, childpidsfmt, ppid, ppid);
-	/* read /proc/<ppid>/task/<ppid>/children file */
-	child_pids = parse_space_sep_val_file(fname->data, &nrow);
+	fname = get_fq_proc_path(schedstat);
+	lines = read_nlsv(fname, &nlines);
+	values = (char ***) palloc(Max(nlines, 1) * sizeof(char **));
+	for (i = 0; i < nlines; ++i)
+	{
+		char  **toks;
+		int		ntok;
+		char  **row;
+
+		if (strncmp(lines[i], "cpu", 3) != 0 || !isdigit((unsigned char) lines[i][3]))
+			continue;
+
+		toks = parse_ss_line(lines[i], &ntok);
+		if (ntok != ncol)
+			ereport(ERROR,
+					(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+					errmsg("pgnodemx: expected %d tokens, got %d in space separated file %s",
+						   ncol, ntok, fname)));
+
+		/*
+		 * Fields are yld_count, a legacy zero, sched_count, sched_goidle,
+		 * ttwu_count, ttwu_local, run time, wait time, and timeslices.
+		 * The legacy field is dropped; cpus get negative sample ids.
+		 */
+		row = (char **) palloc(ncol * sizeof(char *));
+		row[0] = toks[0];
+		row[1] = toks[1];
+		memcpy(&row[2], &toks[3], (ncol - 3) * sizeof(char *));
+		row[ncol - 1] = sched_wait_pct(-1 - atoi(toks[0] + 3), toks[8]);
+		values[nrow++] = row;
+	}
+
+	return form_srf(fcinfo, values, nrow, ncol, text_8_numeric_float8_sig);
+}
+
+/*
+ * Backend-local previous samples of the runqueue wait counters, by
+ * pid, or by -1 - cpu number for cpus.
+ */
+typedef struct schedSample
+{
+	int64		id;			/* hash key */
+	uint64		wait_ns;
+	uint64		sampled_ns;
+} schedSample;
+
+static HTAB *sched_samples = NULL;
 
-	if (nrow > 0)
+/* start over rather than let exited pids accumulate without bound */
+#define SCHED_SAMPLES_MAX	8192
+
+/*
+ * Percentage of the wall clock time since the previous sample of id
+ * in this backend that was spent waiting on a runqueue, or NULL for
+ * the first sample. For a cpu, the waits of all its tasks are summed,
+ * so the result can exceed 100.
+ */
+static char *
+sched_wait_pct(int64 id, const char *wait_ns)
+{
+	struct timespec	ts;
+	uint64			now;
+	uint64			wait = strtoull(wait_ns, NULL, 10);
+	schedSample	   *sample;
+	bool			found;
+	char		   *result = NULL;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	now = (uint64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+
+	if (sched_samples != NULL &&
+		hash_get_num_entries(sched_samples) >= SCHED_SAMPLES_MAX)
+	{
+		hash_destroy(sched_samples);
+		sched_samples = NULL;
+	}
+	if (sched_samples == NULL)
 	{
-		int j;
+		HASHCTL		ctl;
 
-		/* nrow is the number of child pids we will be getting stats for */
-		values = (char ***) repalloc(values, nrow * sizeof(char **));
+		memset(&ctl, 0, sizeof(ctl));
+		ctl.keysize = sizeof(int64);
+		ctl.entrysize = sizeof(schedSample);
+		sched_samples = hash_create("pgnodemx schedstat samples", 256, &ctl,
+									HASH_ELEM | HASH_BLOBS);
+	}
 
-		/* iterate through child pids */
-		for (j = 0; j < nrow; ++j)
-		{
-			int		ntok;
-			char  **toks;
-			int		k;
-			char   *rawstr;
-			char   *line;
-			char   *ptr1;
-			char   *ptr2;
-			int		ch1 = '(';
-			int		ch2 = ')';
-
-			/* read stats for current child pid */
-			resetStringInfo(fname);
-			appendStringInfo(fname, pidstatfmt, child_pids[j]);
-			/* read "/proc/<child-pid>/stat file" */
-			rawstr = get_string_from_file(fname->data);
+	sample = (schedSample *) hash_search(sched_samples, &id, HASH_ENTER, &found);
 
-			/*
-			 * Find the end of the first two fields, and 
-			 * advance line pointer to correct position in rawstr
-			 * for the rest. While at it, also find the first "("
-			 */
- 
-			/* Find start position of the command string */
-			ptr1 = strchr(rawstr, ch1 );
- 
-			/* Find end position of the command string */
-			ptr2 = strrchr(rawstr, ch2 );
+	/* a lower count means the pid was reused */
+	if (found && now > sample->sampled_ns && wait >= sample->wait_ns)
+		result = psprintf("%.3f", 100.0 * (double) (wait - sample->wait_ns) /
+						  (double) (now - sample->sampled_ns));
 
-			/*
-			 * The rest of the line starts 2 bytes after
-			 * the command ending parenthesis
-			 */
-			line = ptr2 + 2;
+	sample->wait_ns = wait;
+	sample->sampled_ns = now;
 
-			/* parse the rest */
-			toks = parse_ss_line(line, &ntok);
+	return result;
+}
 
-			/* there should be two columns less in the parsed rest-of-line */
-			if ((ntok + 2) != ncol)
-				ereport(ERROR,
-						(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
-						errmsg("pgnodemx: expected %d tokens, got %d in space separated file %s",
-							   ncol, ntok + 2, fname->data)));
+/*
+ * Functions taking a pid argument only look at postgres processes:
+ * the postmaster and its children.
+ */
+static void
+check_backend_pid(int pid)
+{
+	char	  **pids;
+	int			npids;
+	int			i;
 
-			values[j] = (char **) palloc(ncol * sizeof(char *));
-			
-			for (k = 0; k < ncol; ++k) 
-			{
-				if ( k == 0 ) 
-				{
-					char   *p = ptr1 - 1;
-
-					/*
-					 * first column starts at 0 and goes through
-					 * ptr1 - 1
-					 */
-					p[0] = '\0';
-					values[j][k] = pstrdup(rawstr);
-				}
-				else if ( k == 1 ) 
-				{
-					char   *p = ptr1 + 1;
-
-					/*
-					 * second column (command) is everything inbetween
-					 * ptr1 + 1 to ptr2 (which should be a NULL terminator)
-					 */
-					ptr2[0] = '\0';
-					values[j][k] = pstrdup(p);
-				}
-				else 	
-					values[j][k] = pstrdup(toks[k - 2]);
-			}
-		}
+	if (pid == PostmasterPid)
+		return;
 
-		return form_srf(fcinfo, values, nrow, ncol, proc_pid_stat_sig);
+	pids = get_backend_pids(&npids);
+	for (i = 0; i < npids; ++i)
+	{
+		if (atoi(pids[i]) == pid)
+			return;
 	}
+
 	ereport(ERROR,
-			(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
-			errmsg("pgnodemx: no lines in flat keyed file: %s ", fname->data)));
+			(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+			 errmsg("pgnodemx: pid %d is not a PostgreSQL process", pid)));
+}
 
-	/* never reached */
-	return (Datum) 0;
+static int
+tid_cmp(const void *p1, const void *p2)
+{
+	int			t1 = atoi(*(char **) p1);
+	int			t2 = atoi(*(char **) p2);
+
+	return (t1 > t2) - (t1 < t2);
 }
 
 /*
@@ -739,7 +1385,7 @@ get_fullcmd(char *pid)
 	StringInfo	fname = makeStringInfo();
 
 	/* calculate filename of interest */
-	appendStringInfo(fname, pidcmdfmt, pid);
+	appendStringInfo(fname, pidcmdfmt, procroot, pid);
 
 	/* read /proc/<ppid>/cmdline file */
 	return get_string_from_file(fname->data);
@@ -751,11 +1397,12 @@ get_uid_username( char *pid, char **uid, char **username )
 {
 	struct stat stat_struct;
 	char tmp[INTEGER_LEN];
+	char *pidpath = get_fq_proc_path(pid);
+
 	/* Get the uid and username of the pid's owner. */
-	snprintf(tmp, sizeof(tmp) - 1, "%s/%s", PROCFS, pid);
-	if (stat(tmp, &stat_struct) < 0)
+	if (stat(pidpath, &stat_struct) < 0)
 	{
-		elog(ERROR, "'%s' not found", tmp);
+		elog(ERROR, "'%s' not found", pidpath);
 		*uid = pstrdup("-1");
 		*username = NULL;
 	}
@@ -785,22 +1432,24 @@ Datum pgnodemx_proc_cputime(PG_FUNCTION_ARGS)
 	int			nlines;
 	char	  **tokens;
 	int			ntok;
+	char	   *fqpath;
 
 	if (!proc_enabled)
 		return form_srf(fcinfo, NULL, 0, ncol, _5_bigint_sig);
 
-	lines = read_nlsv(procstat, &nlines);
+	fqpath = get_fq_proc_path(procstat);
+	lines = read_nlsv(fqpath, &nlines);
 	/* currently only interested in the first part of the first line */
 	if (nlines < 1)
 		ereport(ERROR,
 				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
-				errmsg("pgnodemx: got too few lines in file %s", procstat)));
+				errmsg("pgnodemx: got too few lines in file %s", fqpath)));
 
 	tokens = parse_ss_line(lines[0], &ntok);
 	if (ntok < (ncol + 1))
 		ereport(ERROR,
 				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
-				errmsg("pgnodemx: got too few values in file %s", procstat)));
+				errmsg("pgnodemx: got too few values in file %s", fqpath)));
 
 	values = (char ***) repalloc(values, nrow * sizeof(char **));
 	values[0] = (char **) palloc(ncol * sizeof(char *));
@@ -822,16 +1471,18 @@ Datum pgnodemx_proc_loadavg(PG_FUNCTION_ARGS)
 	char	   *rawstr;
 	char	  **tokens;
 	int			ntok;
+	char	   *fqpath;
 
 	if (!proc_enabled)
 		return form_srf(fcinfo, NULL, 0, ncol, load_avg_sig);
 
-	rawstr = read_one_nlsv(loadavg);
+	fqpath = get_fq_proc_path(loadavg);
+	rawstr = read_one_nlsv(fqpath);
 	tokens = parse_ss_line(rawstr, &ntok);
 	if (ntok < (ncol + 1))
 		ereport(ERROR,
 				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
-				errmsg("pgnodemx: got too few values in file %s", loadavg)));
+				errmsg("pgnodemx: got too few values in file %s", fqpath)));
 
 	values = (char ***) repalloc(values, nrow * sizeof(char **));
 	values[0] = (char **) palloc(ncol * sizeof(char *));
@@ -843,3 +1494,382 @@ Datum pgnodemx_proc_loadavg(PG_FUNCTION_ARGS)
 
 	return form_srf(fcinfo, values, nrow, ncol, load_avg_sig);
 }
+
+PG_FUNCTION_INFO_V1(pgnodemx_proc_interrupts);
+Datum
+pgnodemx_proc_interrupts(PG_FUNCTION_ARGS)
+{
+	return proc_irq_matrix(fcinfo, interrupts, true);
+}
+
+PG_FUNCTION_INFO_V1(pgnodemx_proc_softirqs);
+Datum
+pgnodemx_proc_softirqs(PG_FUNCTION_ARGS)
+{
+	return proc_irq_matrix(fcinfo, softirqs, false);
+}
+
+/*
+ * Turn the per cpu matrix of "/proc/interrupts" or "/proc/softirqs"
+ * into (irq, cpu, count, description) rows. The header names the cpu
+ * of each column, and is read once to map column positions to cpu
+ * numbers, since offline cpus are left out. Each line is then walked
+ * once: the irq name, up to one count per header column, and for
+ * interrupts the chip and device names as the description.
+ *
+ * If has_totals, lines with a named rather than numbered irq and no
+ * description, such as ERR and MIS on x86 or Err on arm, are totals,
+ * which are returned with a NULL cpu. They are told apart by that and
+ * not by their single count, which matches the number of cpus on a one
+ * cpu host. Any other line with fewer counts than cpus is taken as a
+ * total too.
+ */
+static Datum
+proc_irq_matrix(FunctionCallInfo fcinfo, const char *fname, bool has_totals)
+{
+	int			ncol = PROC_IRQ_NCOL;
+	char	   *fqpath;
+	char	  **lines;
+	int			nlines;
+	int		   *cpus;
+	int			ncpus = 0;
+	char	  **counts;
+	char	   *p;
+	char	 ***values;
+	int			nrow = 0;
+	int			maxrow;
+	int			i;
+
+	if (!proc_enabled)
+		return form_srf(fcinfo, NULL, 0, ncol, text_int_bigint_text_sig);
+
+	fqpath = get_fq_proc_path(fname);
+	lines = read_nlsv(fqpath, &nlines);
+	if (nlines < 1)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				errmsg("pgnodemx: no lines in file: %s ", fqpath)));
+
+	/* header: "CPU0 CPU1 ..." */
+	cpus = (int *) palloc(strlen(lines[0]) * sizeof(int));
+	for (p = lines[0]; *p != '\0'; )
+	{
+		while (*p == ' ')
+			p++;
+		if (strncmp(p, "CPU", 3) != 0)
+			break;
+		cpus[ncpus++] = (int) strtol(p + 3, &p, 10);
+	}
+	if (ncpus == 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				errmsg("pgnodemx: no cpus in header of file %s", fqpath)));
+
+	counts = (char **) palloc(ncpus * sizeof(char *));
+	maxrow = (nlines - 1) * ncpus;
+	values = (char ***) palloc(Max(maxrow, 1) * sizeof(char **));
+	for (i = 1; i < nlines; ++i)
+	{
+		char	   *irq;
+		char	   *desc = NULL;
+		int			ncounts = 0;
+		bool		total;
+		int			j;
+
+		/* "<irq>:" */
+		for (p = lines[i]; *p == ' '; p++)
+			;
+		irq = p;
+		if ((p = strchr(p, ':')) == NULL)
+			continue;
+		*p++ = '\0';
+
+		while (ncounts < ncpus)
+		{
+			char	   *start;
+
+			while (*p == ' ')
+				p++;
+			if (!isdigit((unsigned char) *p))
+				break;
+			start = p;
+			while (isdigit((unsigned char) *p))
+				p++;
+			if (*p != '\0')
+				*p++ = '\0';
+			counts[ncounts++] = start;
+		}
+
+		while (*p == ' ')
+			p++;
+		if (*p != '\0')
+			desc = p;
+
+		total = ncounts < ncpus ||
+			(has_totals && desc == NULL && !isdigit((unsigned char) irq[0]));
+
+		for (j = 0; j < ncounts; ++j)
+		{
+			char  **row = (char **) palloc(ncol * sizeof(char *));
+
+			row[0] = irq;
+			row[1] = total ? NULL : psprintf("%d", cpus[j]);
+			row[2] = counts[j];
+			row[3] = desc;
+			values[nrow++] = row;
+		}
+	}
+
+	return form_srf(fcinfo, values, nrow, ncol, text_int_bigint_text_sig);
+}
+
+/*
+ * "/proc/buddyinfo" in long format: the free blocks of each order in
+ * each zone, their size in bytes, and the bytes free in blocks of that
+ * order or larger, i.e. what is available for an allocation of that
+ * order without compaction.
+ */
+PG_FUNCTION_INFO_V1(pgnodemx_proc_buddyinfo);
+Datum
+pgnodemx_proc_buddyinfo(PG_FUNCTION_ARGS)
+{
+	int			ncol = PROC_BUDDYINFO_NCOL;
+	char	   *fqpath;
+	char	  **lines;
+	int			nlines;
+	char	 ***values;
+	int			nrow = 0;
+	int64		pagesize = sysconf(_SC_PAGESIZE);
+	int			i;
+
+	if (!proc_enabled)
+		return form_srf(fcinfo, NULL, 0, ncol, int_text_int_3_bigint_sig);
+
+	fqpath = get_fq_proc_path(buddyinfo);
+	lines = read_nlsv(fqpath, &nlines);
+	values = (char ***) palloc(Max(nlines, 1) * 16 * sizeof(char **));
+	for (i = 0; i < nlines; ++i)
+	{
+		/* "Node 0, zone   Normal   <free blocks of order 0> ..." */
+		int			ntok;
+		char	  **toks = parse_ss_line(lines[i], &ntok);
+		int			norders = ntok - 4;
+		int64		above = 0;
+		int			order;
+
+		if (ntok < 5 || strcmp(toks[0], "Node") != 0 || norders > 16)
+			ereport(ERROR,
+					(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+					errmsg("pgnodemx: unexpected line in file %s, line %d",
+						   fqpath, i + 1)));
+
+		/* walk down from the largest order to sum what is at or above */
+		for (order = norders - 1; order >= 0; --order)
+		{
+			char  **row = (char **) palloc(ncol * sizeof(char *));
+			int64	nfree = strtoll(toks[4 + order], NULL, 10);
+			int64	nbytes = (nfree * pagesize) << order;
+
+			above += nbytes;
+			row[0] = psprintf("%d", atoi(toks[1]));
+			row[1] = toks[3];
+			row[2] = psprintf("%d", order);
+			row[3] = toks[4 + order];
+			row[4] = int64_to_string(nbytes);
+			row[5] = int64_to_string(above);
+			values[nrow + order] = row;
+		}
+		nrow += norders;
+	}
+
+	return form_srf(fcinfo, values, nrow, ncol, int_text_int_3_bigint_sig);
+}
+
+/*
+ * A summary of "/proc/zoneinfo": free pages and the min, low, and high
+ * watermarks of each zone, with the pages the buddy allocator manages,
+ * all in bytes. Reclaim starts below low and allocations stall below
+ * min. Only lines starting with those keys are tokenized; the per cpu
+ * "high:" lines have a colon and are not matched.
+ */
+PG_FUNCTION_INFO_V1(pgnodemx_proc_zoneinfo);
+Datum
+pgnodemx_proc_zoneinfo(PG_FUNCTION_ARGS)
+{
+	int			ncol = PROC_ZONEINFO_NCOL;
+	char	   *fqpath;
+	char	  **lines;
+	int			nlines;
+	char	 ***values;
+	char	  **row = NULL;
+	int			nrow = 0;
+	int64		pagesize = sysconf(_SC_PAGESIZE);
+	int			i;
+
+	if (!proc_enabled)
+		return form_srf(fcinfo, NULL, 0, ncol, int_text_5_bigint_sig);
+
+	fqpath = get_fq_proc_path(zoneinfo);
+	lines = read_nlsv(fqpath, &nlines);
+	values = (char ***) palloc(Max(nlines, 1) * sizeof(char **));
+	for (i = 0; i < nlines; ++i)
+	{
+		char	   *p = lines[i];
+		int			col;
+
+		if (strncmp(p, "Node ", 5) == 0)
+		{
+			/* "Node 0, zone   Normal" starts a new zone */
+			int			ntok;
+			char	  **toks = parse_ss_line(p, &ntok);
+
+			if (ntok != 4)
+				ereport(ERROR,
+						(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+						errmsg("pgnodemx: unexpected line in file %s, line %d",
+							   fqpath, i + 1)));
+
+			row = (char **) palloc0(ncol * sizeof(char *));
+			row[0] = psprintf("%d", atoi(toks[1]));
+			row[1] = toks[3];
+			values[nrow++] = row;
+			continue;
+		}
+		if (row == NULL)
+			continue;
+
+		while (*p == ' ')
+			p++;
+		if (strncmp(p, "pages free ", 11) == 0)
+			col = 2, p += 11;
+		else if (strncmp(p, "min ", 4) == 0)
+			col = 3, p += 4;
+		else if (strncmp(p, "low ", 4) == 0)
+			col = 4, p += 4;
+		else if (strncmp(p, "high ", 5) == 0)
+			col = 5, p += 5;
+		else if (strncmp(p, "managed ", 8) == 0)
+			col = 6, p += 8;
+		else
+			continue;
+
+		row[col] = int64_to_string(strtoll(p, NULL, 10) * pagesize);
+	}
+
+	return form_srf(fcinfo, values, nrow, ncol, int_text_5_bigint_sig);
+}
+
+/*
+ * Huge page pools, one row per page size from
+ * "/sys/kernel/mm/hugepages/hugepages-<size>kB". Where that is not
+ * available, e.g. in some containers, the default size pool is taken
+ * from the HugePages_* lines of /proc/meminfo instead. The default
+ * size row also has the number of huge pages the server's shared
+ * memory needs, on PostgreSQL 15 and later.
+ */
+PG_FUNCTION_INFO_V1(pgnodemx_hugepage_status);
+Datum
+pgnodemx_hugepage_status(PG_FUNCTION_ARGS)
+{
+	int			ncol = HUGEPAGE_STATUS_NCOL;
+	static const char *const poolfiles[] = {
+		"nr_hugepages", "free_hugepages", "resv_hugepages",
+		"surplus_hugepages", "nr_overcommit_hugepages"
+	};
+	static const char *const meminfokeys[] = {
+		"HugePages_Total", "HugePages_Free", "HugePages_Rsvd",
+		"HugePages_Surp"
+	};
+	char	 ***values;
+	int			nrow = 0;
+	char	 ***meminfo;
+	int			nmeminfo;
+	char	   *defsize = NULL;
+	char	   *required = NULL;
+	DIR		   *dir;
+	struct dirent *de;
+	int			i;
+
+	if (!proc_enabled)
+		return form_srf(fcinfo, NULL, 0, ncol, hugepage_status_sig);
+
+	meminfo = proc_meminfo_rows(NIL, NULL, &nmeminfo);
+	for (i = 0; i < nmeminfo; ++i)
+	{
+		if (strcmp(meminfo[i][0], "Hugepagesize") == 0)
+			defsize = meminfo[i][1];
+	}
+
+#if PG_VERSION_NUM >= 150000
+	required = (char *) GetConfigOption("shared_memory_size_in_huge_pages",
+										true, false);
+	if (required != NULL && strcmp(required, "-1") == 0)
+		required = NULL;
+#endif
+
+	values = (char ***) palloc(sizeof(char **));
+	if ((dir = AllocateDir(hugepagesdir)) != NULL)
+	{
+		while ((de = ReadDir(dir, hugepagesdir)) != NULL)
+		{
+			char	  **row;
+			int64		kb;
+
+			if (sscanf(de->d_name, "hugepages-" INT64_FORMAT "kB", &kb) != 1)
+				continue;
+
+			row = (char **) palloc0(ncol * sizeof(char *));
+			row[0] = int64_to_string(kb * 1024);
+			for (i = 0; i < lengthof(poolfiles); ++i)
+			{
+				char   *fname = psprintf("%s/%s/%s", hugepagesdir,
+										 de->d_name, poolfiles[i]);
+
+				row[i + 1] = read_file_or_null(fname);
+			}
+
+			values = (char ***) repalloc(values, (nrow + 1) * sizeof(char **));
+			values[nrow++] = row;
+		}
+		FreeDir(dir);
+	}
+
+	if (nrow == 0 && defsize != NULL)
+	{
+		char	  **row = (char **) palloc0(ncol * sizeof(char *));
+		int			k;
+
+		row[0] = defsize;
+		for (k = 0; k < lengthof(meminfokeys); ++k)
+		{
+			for (i = 0; i < nmeminfo; ++i)
+			{
+				if (strcmp(meminfo[i][0], meminfokeys[k]) == 0)
+					row[k + 1] = meminfo[i][1];
+			}
+		}
+		values[nrow++] = row;
+	}
+
+	for (i = 0; i < nrow; ++i)
+	{
+		bool	isdefault = defsize != NULL && strcmp(values[i][0], defsize) == 0;
+
+		values[i][6] = isdefault ? "t" : "f";
+		if (isdefault)
+			values[i][7] = required;
+	}
+
+	qsort(values, nrow, sizeof(char **), hugepage_size_cmp);
+
+	return form_srf(fcinfo, values, nrow, ncol, hugepage_status_sig);
+}
+
+static int
+hugepage_size_cmp(const void *p1, const void *p2)
+{
+	int64		s1 = strtoll((*(char ***) p1)[0], NULL, 10);
+	int64		s2 = strtoll((*(char ***) p2)[0], NULL, 10);
+
+	return (s1 > s2) - (s1 < s2);
+}
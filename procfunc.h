@@ -28,6 +28,41 @@
 #ifndef _PROCFUNC_H_
 #define _PROCFUNC_H_
 
+#include "nodes/pg_list.h"
+
+#define PROCFS "/proc"
+
+/* column counts of the row generators shared by the SRFs and the FDW */
+#define PROC_DISKSTATS_NCOL		20
+#define PROC_MEMINFO_NCOL		2
+#define PROC_PID_IO_NCOL		8
+#define PROC_PID_CMDLINE_NCOL	4
+#define PROC_PID_STAT_NCOL		52
+#define PROC_TASK_STAT_NCOL		15
+#define PROC_PID_SCHEDSTAT_NCOL	5
+#define PROC_SCHEDSTAT_NCOL		10
+#define PROC_PID_STATUS_NCOL	10
+#define PROC_PID_FD_SUMMARY_NCOL	8
+#define PROC_IRQ_NCOL			4
+#define PROC_BUDDYINFO_NCOL		6
+#define PROC_ZONEINFO_NCOL		7
+#define HUGEPAGE_STATUS_NCOL	8
+
+typedef char **(*pid_row_fn) (char *pid, bool *needed);
+
+extern char *get_fq_proc_path(const char *fname);
 extern bool check_procfs(void);
+extern char **get_backend_pids(int *npids);
+extern char ***proc_diskstats_rows(List *devices, bool *needed, int *nrow);
+extern char ***proc_meminfo_rows(List *keys, bool *needed, int *nrow);
+extern char **proc_pid_io_row(char *pid, bool *needed);
+extern char **proc_pid_cmdline_row(char *pid, bool *needed);
+extern char **proc_pid_stat_row(char *pid, bool *needed);
+extern char **proc_pid_schedstat_row(char *pid, bool *needed);
+extern char **proc_pid_status_row(char *pid, bool *needed);
+extern char **proc_pid_fd_summary_row(char *pid, bool *needed);
+
+/* exported globals */
+extern char *procroot;
 
 #endif /* _PROCFUNC_H_ */
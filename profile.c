@@ -0,0 +1,470 @@
+/*
+ * profile.c
+ *
+ * Sampling profiler of backend wait events and kernel state
+ *
+ * This code is released under the PostgreSQL license.
+ *
+ * Copyright 2020-2025 Crunchy Data Solutions, Inc.
+ *
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation for any purpose, without fee, and without a written
+ * agreement is hereby granted, provided that the above copyright notice
+ * and this paragraph and the following two paragraphs appear in all copies.
+ *
+ * IN NO EVENT SHALL CRUNCHY DATA SOLUTIONS, INC. BE LIABLE TO ANY PARTY
+ * FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING LOST PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS
+ * DOCUMENTATION, EVEN IF THE CRUNCHY DATA SOLUTIONS, INC. HAS BEEN ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THE CRUNCHY DATA SOLUTIONS, INC. SPECIFICALLY DISCLAIMS ANY WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE. THE SOFTWARE PROVIDED HEREUNDER IS
+ * ON AN "AS IS" BASIS, AND THE CRUNCHY DATA SOLUTIONS, INC. HAS NO
+ * OBLIGATIONS TO PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR
+ * MODIFICATIONS.
+ */
+
+#include "postgres.h"
+
+#include <ctype.h>
+#include <unistd.h>
+
+#include "fmgr.h"
+#include "miscadmin.h"
+#include "pgstat.h"
+#include "postmaster/bgworker.h"
+#include "storage/ipc.h"
+#include "storage/latch.h"
+#include "storage/lwlock.h"
+#include "storage/proc.h"
+#include "storage/procarray.h"
+#include "storage/shmem.h"
+#include "tcop/tcopprot.h"
+#include "utils/builtins.h"
+#include "utils/guc.h"
+#include "utils/hsearch.h"
+#include "utils/memutils.h"
+
+#include "fileutils.h"
+#include "genutils.h"
+#include "procfunc.h"
+#include "profile.h"
+#include "srfsigs.h"
+
+/*
+ * A background worker wakes up pgnodemx.profile_hz times per second
+ * and, for every process in the backend status table, takes one sample
+ * of its wait event together with the kernel's view of it: the state
+ * field of /proc/<pid>/stat, the function it sleeps in from
+ * /proc/<pid>/wchan, and the syscall it is blocked in from
+ * /proc/<pid>/syscall. Samples are counted in a shared hash keyed by
+ * all of those, so time spent in D state under fsync, faulting in
+ * shared_buffers, or throttled by memory.high shows up even though
+ * the wait event is empty.
+ *
+ * The worker and its shared memory exist only if profile_enabled is
+ * on at server start; profile_hz may then be changed with a reload,
+ * and zero pauses sampling. It needs PostgreSQL 10 or later for the
+ * backend type and wait event of other processes.
+ */
+#define PGNX_PROFILE_MAX_ENTRIES	1024
+#define PGNX_PROFILE_TRANCHE		"pgnodemx profile"
+#define PGNX_PROFILE_NCOL			7
+
+/* syscall of a process which is running, or unreadable */
+#define PGNX_PROFILE_NO_SYSCALL		(-2)
+
+/* all fields are zero padded, for HASH_BLOBS */
+typedef struct pgnxProfileKey
+{
+	char		backend_type[NAMEDATALEN];
+	char		wait_event_type[NAMEDATALEN];
+	char		wait_event[NAMEDATALEN];
+	char		wchan[NAMEDATALEN];
+	int32		syscall;
+	char		state;
+} pgnxProfileKey;
+
+typedef struct pgnxProfileEntry
+{
+	pgnxProfileKey	key;
+	int64			samples;
+} pgnxProfileEntry;
+
+typedef struct pgnxProfileShared
+{
+	LWLock		   *lock;		/* protects the hash */
+} pgnxProfileShared;
+
+/* custom GUC vars */
+bool profile_enabled = false;
+int profile_hz = 10;
+
+#if PG_VERSION_NUM >= 100000
+static pgnxProfileShared *pgnx_profile = NULL;
+static HTAB *pgnx_profile_hash = NULL;
+
+#if PG_VERSION_NUM >= 150000
+static shmem_request_hook_type prev_shmem_request_hook = NULL;
+#endif
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+
+static volatile sig_atomic_t got_sighup = false;
+
+static void profile_shmem_request(void);
+static void profile_shmem_startup(void);
+static void profile_sighup(SIGNAL_ARGS);
+static void profile_sample(void);
+static bool profile_sample_pid(int pid, pgnxProfileKey *key);
+
+PGDLLEXPORT void pgnodemx_profile_main(Datum main_arg);
+#endif
+
+Datum pgnodemx_backend_kernel_profile(PG_FUNCTION_ARGS);
+Datum pgnodemx_backend_kernel_profile_reset(PG_FUNCTION_ARGS);
+
+/*
+ * Register the profiler and its shared memory if it is enabled.
+ * Must be called from _PG_init().
+ */
+void
+profile_init(void)
+{
+#if PG_VERSION_NUM >= 100000
+	BackgroundWorker	worker;
+
+	if (!profile_enabled)
+		return;
+
+#if PG_VERSION_NUM >= 150000
+	prev_shmem_request_hook = shmem_request_hook;
+	shmem_request_hook = profile_shmem_request;
+#else
+	profile_shmem_request();
+#endif
+	prev_shmem_startup_hook = shmem_startup_hook;
+	shmem_startup_hook = profile_shmem_startup;
+
+	memset(&worker, 0, sizeof(worker));
+	worker.bgw_flags = BGWORKER_SHMEM_ACCESS;
+	worker.bgw_start_time = BgWorkerStart_ConsistentState;
+	worker.bgw_restart_time = 10;
+	snprintf(worker.bgw_library_name, BGW_MAXLEN, "pgnodemx");
+	snprintf(worker.bgw_function_name, BGW_MAXLEN, "pgnodemx_profile_main");
+	snprintf(worker.bgw_name, BGW_MAXLEN, "pgnodemx profiler");
+#if PG_VERSION_NUM >= 110000
+	snprintf(worker.bgw_type, BGW_MAXLEN, "pgnodemx profiler");
+#endif
+	RegisterBackgroundWorker(&worker);
+#endif
+}
+
+#if PG_VERSION_NUM >= 100000
+static void
+profile_shmem_request(void)
+{
+#if PG_VERSION_NUM >= 150000
+	if (prev_shmem_request_hook)
+		prev_shmem_request_hook();
+#endif
+
+	RequestAddinShmemSpace(add_size(MAXALIGN(sizeof(pgnxProfileShared)),
+									hash_estimate_size(PGNX_PROFILE_MAX_ENTRIES,
+													   sizeof(pgnxProfileEntry))));
+	RequestNamedLWLockTranche(PGNX_PROFILE_TRANCHE, 1);
+}
+
+static void
+profile_shmem_startup(void)
+{
+	bool		found;
+	HASHCTL		info;
+
+	if (prev_shmem_startup_hook)
+		prev_shmem_startup_hook();
+
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+	pgnx_profile = ShmemInitStruct("pgnodemx profile",
+								   sizeof(pgnxProfileShared), &found);
+	if (!found)
+		pgnx_profile->lock = &(GetNamedLWLockTranche(PGNX_PROFILE_TRANCHE))->lock;
+
+	memset(&info, 0, sizeof(info));
+	info.keysize = sizeof(pgnxProfileKey);
+	info.entrysize = sizeof(pgnxProfileEntry);
+	pgnx_profile_hash = ShmemInitHash("pgnodemx profile hash",
+									  PGNX_PROFILE_MAX_ENTRIES,
+									  PGNX_PROFILE_MAX_ENTRIES,
+									  &info, HASH_ELEM | HASH_BLOBS);
+
+	LWLockRelease(AddinShmemInitLock);
+}
+
+static void
+profile_sighup(SIGNAL_ARGS)
+{
+	int			save_errno = errno;
+
+	got_sighup = true;
+	SetLatch(MyLatch);
+
+	errno = save_errno;
+}
+
+void
+pgnodemx_profile_main(Datum main_arg)
+{
+	MemoryContext	sample_cxt;
+
+	pqsignal(SIGHUP, profile_sighup);
+	pqsignal(SIGTERM, die);
+	BackgroundWorkerUnblockSignals();
+
+	sample_cxt = AllocSetContextCreate(TopMemoryContext,
+									   "pgnodemx profile",
+									   ALLOCSET_DEFAULT_SIZES);
+
+	for (;;)
+	{
+		int			rc;
+		int			events = WL_LATCH_SET | WL_POSTMASTER_DEATH;
+		long		timeout = -1;
+
+		/* profile_hz of zero pauses sampling until the next reload */
+		if (profile_hz > 0)
+		{
+			events |= WL_TIMEOUT;
+			timeout = Max(1000L / profile_hz, 1);
+		}
+
+		rc = WaitLatch(MyLatch, events, timeout, PG_WAIT_EXTENSION);
+		ResetLatch(MyLatch);
+
+		if (rc & WL_POSTMASTER_DEATH)
+			proc_exit(1);
+
+		CHECK_FOR_INTERRUPTS();
+
+		if (got_sighup)
+		{
+			got_sighup = false;
+			ProcessConfigFile(PGC_SIGHUP);
+		}
+
+		if (rc & WL_TIMEOUT)
+		{
+			MemoryContext	oldcxt = MemoryContextSwitchTo(sample_cxt);
+
+			profile_sample();
+
+			MemoryContextSwitchTo(oldcxt);
+			MemoryContextReset(sample_cxt);
+		}
+	}
+}
+
+/*
+ * Take one sample of every process in the backend status table. The
+ * files are read before the lock is taken, so the lock is held only
+ * for the hash updates.
+ */
+static void
+profile_sample(void)
+{
+	pgnxProfileKey *keys;
+	int				nkeys = 0;
+	int				nbackends;
+	int				i;
+
+	pgstat_clear_snapshot();
+	nbackends = pgstat_fetch_stat_numbackends();
+	if (nbackends < 1)
+		return;
+
+	keys = (pgnxProfileKey *) palloc0(nbackends * sizeof(pgnxProfileKey));
+	for (i = 1; i <= nbackends; ++i)
+	{
+		LocalPgBackendStatus   *local;
+		PgBackendStatus		   *beentry;
+		PGPROC				   *proc;
+		pgnxProfileKey		   *key = &keys[nkeys];
+		const char			   *desc;
+		uint32					raw_wait_event;
+
+#if PG_VERSION_NUM >= 170000
+		local = pgstat_get_local_beentry_by_index(i);
+#else
+		local = pgstat_fetch_stat_local_beentry(i);
+#endif
+		if (local == NULL)
+			continue;
+
+		beentry = &local->backendStatus;
+		if (beentry->st_procpid <= 0 || beentry->st_procpid == MyProcPid)
+			continue;
+
+		proc = BackendPidGetProc(beentry->st_procpid);
+		if (proc == NULL)
+			proc = AuxiliaryPidGetProc(beentry->st_procpid);
+		if (proc == NULL)
+			continue;
+
+		/* the kernel's view of the process, skipped if it has exited */
+		if (!profile_sample_pid(beentry->st_procpid, key))
+			continue;
+
+#if PG_VERSION_NUM >= 130000
+		desc = GetBackendTypeDesc(beentry->st_backendType);
+#else
+		desc = pgstat_get_backend_desc(beentry->st_backendType);
+#endif
+		strlcpy(key->backend_type, desc, NAMEDATALEN);
+
+		raw_wait_event = *((volatile uint32 *) &proc->wait_event_info);
+		if ((desc = pgstat_get_wait_event_type(raw_wait_event)) != NULL)
+			strlcpy(key->wait_event_type, desc, NAMEDATALEN);
+		if ((desc = pgstat_get_wait_event(raw_wait_event)) != NULL)
+			strlcpy(key->wait_event, desc, NAMEDATALEN);
+
+		nkeys++;
+	}
+
+	LWLockAcquire(pgnx_profile->lock, LW_EXCLUSIVE);
+	for (i = 0; i < nkeys; ++i)
+	{
+		pgnxProfileEntry   *entry;
+		bool				found;
+
+		/*
+		 * New combinations are not counted once the limit is reached; a
+		 * shared hash would otherwise keep growing into spare shared memory.
+		 */
+		entry = (pgnxProfileEntry *) hash_search(pgnx_profile_hash, &keys[i],
+												 HASH_FIND, &found);
+		if (entry == NULL &&
+			hash_get_num_entries(pgnx_profile_hash) < PGNX_PROFILE_MAX_ENTRIES)
+			entry = (pgnxProfileEntry *) hash_search(pgnx_profile_hash, &keys[i],
+													 HASH_ENTER_NULL, &found);
+		if (entry == NULL)
+			continue;
+		if (!found)
+			entry->samples = 0;
+		entry->samples += 1;
+	}
+	LWLockRelease(pgnx_profile->lock);
+}
+
+/*
+ * Fill in the state, wchan, and syscall of key from procfs. Returns
+ * false if the process is gone.
+ */
+static bool
+profile_sample_pid(int pid, pgnxProfileKey *key)
+{
+	char		fname[MAXPGPATH];
+	char		buf[1024];
+	char	   *p;
+
+	snprintf(fname, MAXPGPATH, "%s/%d/stat", procroot, pid);
+	if (!read_small_file(fname, buf, sizeof(buf)))
+		return false;
+
+	/* the command name may contain anything, so look past its last ")" */
+	p = strrchr(buf, ')');
+	if (p == NULL || p[1] != ' ' || p[2] == '\0')
+		return false;
+	key->state = p[2];
+
+	/* "0" means not sleeping, or that the kernel hides the address */
+	snprintf(fname, MAXPGPATH, "%s/%d/wchan", procroot, pid);
+	if (read_small_file(fname, buf, sizeof(buf)) && strcmp(buf, "0") != 0)
+		strlcpy(key->wchan, buf, NAMEDATALEN);
+
+	/*
+	 * Either "running", "-1 <sp> <pc>" when blocked outside of a syscall,
+	 * or the syscall number followed by its arguments. Reading it needs
+	 * ptrace access, which Yama may deny.
+	 */
+	key->syscall = PGNX_PROFILE_NO_SYSCALL;
+	snprintf(fname, MAXPGPATH, "%s/%d/syscall", procroot, pid);
+	if (read_small_file(fname, buf, sizeof(buf)) &&
+		(buf[0] == '-' || isdigit((unsigned char) buf[0])))
+		key->syscall = (int32) strtol(buf, NULL, 10);
+
+	return true;
+}
+
+#endif	/* PG_VERSION_NUM >= 100000 */
+
+PG_FUNCTION_INFO_V1(pgnodemx_backend_kernel_profile);
+Datum
+pgnodemx_backend_kernel_profile(PG_FUNCTION_ARGS)
+{
+	int					nrow = 0;
+	int					ncol = PGNX_PROFILE_NCOL;
+	char			 ***values = NULL;
+#if PG_VERSION_NUM >= 100000
+	pgnxProfileEntry   *entries;
+	pgnxProfileEntry   *entry;
+	HASH_SEQ_STATUS		status;
+	int					i;
+
+	if (pgnx_profile == NULL)
+		return form_srf(fcinfo, NULL, 0, ncol, text_5_int_bigint_sig);
+
+	/* take a consistent copy, then format it without holding the lock */
+	LWLockAcquire(pgnx_profile->lock, LW_SHARED);
+	entries = (pgnxProfileEntry *)
+		palloc(Max(hash_get_num_entries(pgnx_profile_hash), 1) * sizeof(pgnxProfileEntry));
+	hash_seq_init(&status, pgnx_profile_hash);
+	while ((entry = (pgnxProfileEntry *) hash_seq_search(&status)) != NULL)
+		entries[nrow++] = *entry;
+	LWLockRelease(pgnx_profile->lock);
+
+	if (nrow > 0)
+		values = (char ***) palloc(nrow * sizeof(char **));
+	for (i = 0; i < nrow; ++i)
+	{
+		pgnxProfileKey *key = &entries[i].key;
+
+		values[i] = (char **) palloc0(ncol * sizeof(char *));
+		values[i][0] = pstrdup(key->backend_type);
+		if (key->wait_event_type[0] != '\0')
+			values[i][1] = pstrdup(key->wait_event_type);
+		if (key->wait_event[0] != '\0')
+			values[i][2] = pstrdup(key->wait_event);
+		values[i][3] = psprintf("%c", key->state);
+		if (key->wchan[0] != '\0')
+			values[i][4] = pstrdup(key->wchan);
+		if (key->syscall != PGNX_PROFILE_NO_SYSCALL)
+			values[i][5] = psprintf("%d", key->syscall);
+		values[i][6] = int64_to_string(entries[i].samples);
+	}
+#endif
+
+	return form_srf(fcinfo, values, nrow, ncol, text_5_int_bigint_sig);
+}
+
+PG_FUNCTION_INFO_V1(pgnodemx_backend_kernel_profile_reset);
+Datum
+pgnodemx_backend_kernel_profile_reset(PG_FUNCTION_ARGS)
+{
+#if PG_VERSION_NUM >= 100000
+	pgnxProfileEntry   *entry;
+	HASH_SEQ_STATUS		status;
+
+	if (pgnx_profile == NULL)
+		PG_RETURN_VOID();
+
+	LWLockAcquire(pgnx_profile->lock, LW_EXCLUSIVE);
+	hash_seq_init(&status, pgnx_profile_hash);
+	while ((entry = (pgnxProfileEntry *) hash_seq_search(&status)) != NULL)
+		hash_search(pgnx_profile_hash, &entry->key, HASH_REMOVE, NULL);
+	LWLockRelease(pgnx_profile->lock);
+#endif
+
+	PG_RETURN_VOID();
+}
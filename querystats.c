@@ -0,0 +1,489 @@
+/*
+ * querystats.c
+ *
+ * Operating system resource usage attributed to queries
+ *
+ * This code is released under the PostgreSQL license.
+ *
+ * Copyright 2020-2025 Crunchy Data Solutions, Inc.
+ *
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation for any purpose, without fee, and without a written
+ * agreement is hereby granted, provided that the above copyright notice
+ * and this paragraph and the following two paragraphs appear in all copies.
+ *
+ * IN NO EVENT SHALL CRUNCHY DATA SOLUTIONS, INC. BE LIABLE TO ANY PARTY
+ * FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING LOST PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS
+ * DOCUMENTATION, EVEN IF THE CRUNCHY DATA SOLUTIONS, INC. HAS BEEN ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THE CRUNCHY DATA SOLUTIONS, INC. SPECIFICALLY DISCLAIMS ANY WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE. THE SOFTWARE PROVIDED HEREUNDER IS
+ * ON AN "AS IS" BASIS, AND THE CRUNCHY DATA SOLUTIONS, INC. HAS NO
+ * OBLIGATIONS TO PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR
+ * MODIFICATIONS.
+ */
+
+#include "postgres.h"
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "access/parallel.h"
+#include "access/xact.h"
+#include "executor/executor.h"
+#include "fmgr.h"
+#include "miscadmin.h"
+#include "storage/fd.h"
+#if PG_VERSION_NUM >= 160000
+#include "nodes/queryjumble.h"
+#elif PG_VERSION_NUM >= 140000
+#include "utils/queryjumble.h"
+#endif
+#include "storage/ipc.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "storage/spin.h"
+#include "utils/builtins.h"
+#include "utils/hsearch.h"
+
+#include "genutils.h"
+#include "procfunc.h"
+#include "querystats.h"
+#include "srfsigs.h"
+
+/*
+ * With pgnodemx.track_queries on, ExecutorStart takes a snapshot of
+ * the backend's getrusage() and "/proc/<pid>/io" counters and
+ * ExecutorEnd adds the difference to shared counters keyed by query
+ * id, database and role, much as pg_stat_kcache does. Only the
+ * outermost query being executed is tracked, so the usage of nested
+ * queries is included in the statement which ran them.
+ *
+ * The hooks and shared memory exist only if pgnodemx.query_stats_enabled
+ * is on at server start, and only then, on PostgreSQL 14 and later, are
+ * query ids requested from the core, so that they are computed with
+ * compute_query_id left at auto. Loading pgnodemx otherwise costs
+ * queries nothing. A query without an id (compute_query_id off) is not
+ * tracked.
+ *
+ * The io file is opened once per backend and then read with pread(),
+ * so each tracked query costs two getrusage() and two pread() calls.
+ * With track_queries off the hooks do nothing but test the setting.
+ */
+#define PGNX_QSTATS_MAX_ENTRIES		4096
+#define PGNX_QSTATS_TRANCHE			"pgnodemx query stats"
+
+/* all fields are zero padded, for HASH_BLOBS */
+typedef struct pgnxQueryStatsKey
+{
+	uint64		queryid;
+	Oid			dbid;
+	Oid			userid;
+} pgnxQueryStatsKey;
+
+/* in the order of the query_os_stats() columns after the key */
+typedef struct pgnxQueryStatsCounters
+{
+	int64		calls;
+	int64		user_usec;
+	int64		system_usec;
+	int64		minflt;
+	int64		majflt;
+	int64		nvcsw;
+	int64		nivcsw;
+	int64		read_bytes;
+	int64		write_bytes;
+} pgnxQueryStatsCounters;
+
+#define PGNX_QSTATS_NCOUNTERS	(sizeof(pgnxQueryStatsCounters) / sizeof(int64))
+#define PGNX_QSTATS_NCOL		(3 + PGNX_QSTATS_NCOUNTERS)
+
+typedef struct pgnxQueryStatsEntry
+{
+	pgnxQueryStatsKey		key;
+	slock_t					mutex;		/* protects the counters only */
+	pgnxQueryStatsCounters	counters;
+} pgnxQueryStatsEntry;
+
+typedef struct pgnxQueryStatsShared
+{
+	LWLock		   *lock;		/* protects the hash */
+} pgnxQueryStatsShared;
+
+/* custom GUC vars */
+bool query_stats_enabled = false;
+bool track_queries = false;
+
+static pgnxQueryStatsShared *pgnx_qstats = NULL;
+static HTAB *pgnx_qstats_hash = NULL;
+
+/* the query being tracked in this backend, and its starting counters */
+static QueryDesc *tracked_query = NULL;
+static SubTransactionId tracked_subxid = InvalidSubTransactionId;
+static pgnxQueryStatsCounters tracked_start;
+static bool xact_callbacks_registered = false;
+
+/* "/proc/<pid>/io", kept open once tracking is first used; -2 if unusable */
+static int qstats_io_fd = -1;
+
+#if PG_VERSION_NUM >= 150000
+static shmem_request_hook_type prev_shmem_request_hook = NULL;
+#endif
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+static ExecutorStart_hook_type prev_ExecutorStart = NULL;
+static ExecutorEnd_hook_type prev_ExecutorEnd = NULL;
+
+static void qstats_shmem_request(void);
+static void qstats_shmem_startup(void);
+static void qstats_ExecutorStart(QueryDesc *queryDesc, int eflags);
+static void qstats_ExecutorEnd(QueryDesc *queryDesc);
+static void qstats_xact_callback(XactEvent event, void *arg);
+static void qstats_subxact_callback(SubXactEvent event, SubTransactionId mySubid,
+									SubTransactionId parentSubid, void *arg);
+static void qstats_snapshot(pgnxQueryStatsCounters *counters);
+static void qstats_accumulate(QueryDesc *queryDesc, pgnxQueryStatsCounters *delta);
+
+Datum pgnodemx_query_os_stats(PG_FUNCTION_ARGS);
+Datum pgnodemx_query_os_stats_reset(PG_FUNCTION_ARGS);
+
+/*
+ * Install the shared memory and executor hooks if query stats are
+ * enabled. Must be called from _PG_init().
+ */
+void
+qstats_init(void)
+{
+	if (!query_stats_enabled)
+		return;
+
+#if PG_VERSION_NUM >= 150000
+	prev_shmem_request_hook = shmem_request_hook;
+	shmem_request_hook = qstats_shmem_request;
+#else
+	qstats_shmem_request();
+#endif
+	prev_shmem_startup_hook = shmem_startup_hook;
+	shmem_startup_hook = qstats_shmem_startup;
+
+	prev_ExecutorStart = ExecutorStart_hook;
+	ExecutorStart_hook = qstats_ExecutorStart;
+	prev_ExecutorEnd = ExecutorEnd_hook;
+	ExecutorEnd_hook = qstats_ExecutorEnd;
+
+#if PG_VERSION_NUM >= 140000
+	/* have compute_query_id = auto compute them, as pg_stat_statements does */
+	EnableQueryId();
+#endif
+}
+
+static void
+qstats_shmem_request(void)
+{
+#if PG_VERSION_NUM >= 150000
+	if (prev_shmem_request_hook)
+		prev_shmem_request_hook();
+#endif
+
+	RequestAddinShmemSpace(add_size(MAXALIGN(sizeof(pgnxQueryStatsShared)),
+									hash_estimate_size(PGNX_QSTATS_MAX_ENTRIES,
+													   sizeof(pgnxQueryStatsEntry))));
+#if PG_VERSION_NUM >= 90600
+	RequestNamedLWLockTranche(PGNX_QSTATS_TRANCHE, 1);
+#else
+	RequestAddinLWLocks(1);
+#endif
+}
+
+static void
+qstats_shmem_startup(void)
+{
+	bool		found;
+	HASHCTL		info;
+
+	if (prev_shmem_startup_hook)
+		prev_shmem_startup_hook();
+
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+	pgnx_qstats = ShmemInitStruct("pgnodemx query stats",
+								  sizeof(pgnxQueryStatsShared), &found);
+	if (!found)
+	{
+#if PG_VERSION_NUM >= 90600
+		pgnx_qstats->lock = &(GetNamedLWLockTranche(PGNX_QSTATS_TRANCHE))->lock;
+#else
+		pgnx_qstats->lock = LWLockAssign();
+#endif
+	}
+
+	memset(&info, 0, sizeof(info));
+	info.keysize = sizeof(pgnxQueryStatsKey);
+	info.entrysize = sizeof(pgnxQueryStatsEntry);
+	pgnx_qstats_hash = ShmemInitHash("pgnodemx query stats hash",
+									 PGNX_QSTATS_MAX_ENTRIES,
+									 PGNX_QSTATS_MAX_ENTRIES,
+									 &info, HASH_ELEM | HASH_BLOBS);
+
+	LWLockRelease(AddinShmemInitLock);
+}
+
+static void
+qstats_ExecutorStart(QueryDesc *queryDesc, int eflags)
+{
+	if (prev_ExecutorStart)
+		prev_ExecutorStart(queryDesc, eflags);
+	else
+		standard_ExecutorStart(queryDesc, eflags);
+
+	if (!track_queries || tracked_query != NULL || pgnx_qstats == NULL ||
+		queryDesc->plannedstmt->queryId == 0 ||
+		(eflags & EXEC_FLAG_EXPLAIN_ONLY))
+		return;
+
+	/* forget the query if it is aborted before ExecutorEnd */
+	if (!xact_callbacks_registered)
+	{
+		RegisterXactCallback(qstats_xact_callback, NULL);
+		RegisterSubXactCallback(qstats_subxact_callback, NULL);
+		xact_callbacks_registered = true;
+	}
+
+	qstats_snapshot(&tracked_start);
+	tracked_query = queryDesc;
+	tracked_subxid = GetCurrentSubTransactionId();
+}
+
+static void
+qstats_ExecutorEnd(QueryDesc *queryDesc)
+{
+	if (queryDesc == tracked_query)
+	{
+		pgnxQueryStatsCounters	delta;
+		int64				   *d = (int64 *) &delta;
+		int64				   *s = (int64 *) &tracked_start;
+		int						i;
+
+		tracked_query = NULL;
+		qstats_snapshot(&delta);
+		for (i = 0; i < PGNX_QSTATS_NCOUNTERS; ++i)
+			d[i] -= s[i];
+		/* a parallel worker's usage is added to its leader's call */
+		delta.calls = IsParallelWorker() ? 0 : 1;
+
+		qstats_accumulate(queryDesc, &delta);
+	}
+
+	if (prev_ExecutorEnd)
+		prev_ExecutorEnd(queryDesc);
+	else
+		standard_ExecutorEnd(queryDesc);
+}
+
+static void
+qstats_xact_callback(XactEvent event, void *arg)
+{
+	if (event == XACT_EVENT_ABORT || event == XACT_EVENT_PARALLEL_ABORT)
+		tracked_query = NULL;
+}
+
+static void
+qstats_subxact_callback(SubXactEvent event, SubTransactionId mySubid,
+						SubTransactionId parentSubid, void *arg)
+{
+	if (event == SUBXACT_EVENT_ABORT_SUB && mySubid == tracked_subxid)
+		tracked_query = NULL;
+}
+
+/*
+ * Current cumulative counters of this backend. The first call opens
+ * the io file; if that fails, read_bytes and write_bytes stay zero.
+ */
+static void
+qstats_snapshot(pgnxQueryStatsCounters *counters)
+{
+	struct rusage	ru;
+	char			buf[256];
+	ssize_t			nbytes;
+	char		   *p;
+
+	memset(counters, 0, sizeof(pgnxQueryStatsCounters));
+
+#ifdef RUSAGE_THREAD
+	if (getrusage(RUSAGE_THREAD, &ru) == 0)
+#else
+	if (getrusage(RUSAGE_SELF, &ru) == 0)
+#endif
+	{
+		counters->user_usec = (int64) ru.ru_utime.tv_sec * 1000000 + ru.ru_utime.tv_usec;
+		counters->system_usec = (int64) ru.ru_stime.tv_sec * 1000000 + ru.ru_stime.tv_usec;
+		counters->minflt = ru.ru_minflt;
+		counters->majflt = ru.ru_majflt;
+		counters->nvcsw = ru.ru_nvcsw;
+		counters->nivcsw = ru.ru_nivcsw;
+	}
+
+	if (qstats_io_fd == -1)
+	{
+		char		fname[MAXPGPATH];
+
+		qstats_io_fd = -2;
+		snprintf(fname, MAXPGPATH, "%s/%d/io", procroot, MyProcPid);
+#if PG_VERSION_NUM >= 130000
+		if (AcquireExternalFD())
+		{
+			qstats_io_fd = open(fname, O_RDONLY | O_CLOEXEC);
+			if (qstats_io_fd < 0)
+			{
+				ReleaseExternalFD();
+				qstats_io_fd = -2;
+			}
+		}
+#else
+		qstats_io_fd = open(fname, O_RDONLY | O_CLOEXEC);
+		if (qstats_io_fd < 0)
+			qstats_io_fd = -2;
+#endif
+	}
+	if (qstats_io_fd < 0)
+		return;
+
+	nbytes = pread(qstats_io_fd, buf, sizeof(buf) - 1, 0);
+	if (nbytes <= 0)
+		return;
+	buf[nbytes] = '\0';
+
+	/* the leading newline keeps cancelled_write_bytes from matching */
+	if ((p = strstr(buf, "\nread_bytes:")) != NULL)
+		counters->read_bytes = strtoll(p + 12, NULL, 10);
+	if ((p = strstr(buf, "\nwrite_bytes:")) != NULL)
+		counters->write_bytes = strtoll(p + 13, NULL, 10);
+}
+
+static void
+qstats_accumulate(QueryDesc *queryDesc, pgnxQueryStatsCounters *delta)
+{
+	pgnxQueryStatsKey		key;
+	pgnxQueryStatsEntry	   *entry;
+	int64				   *dst;
+	int64				   *src = (int64 *) delta;
+	int						i;
+
+	memset(&key, 0, sizeof(key));
+	key.queryid = (uint64) queryDesc->plannedstmt->queryId;
+	key.dbid = MyDatabaseId;
+	key.userid = GetUserId();
+
+	/* the entry may only be used while the lock is held, a reset may remove it */
+	LWLockAcquire(pgnx_qstats->lock, LW_SHARED);
+	entry = (pgnxQueryStatsEntry *) hash_search(pgnx_qstats_hash, &key,
+												HASH_FIND, NULL);
+	if (entry == NULL)
+	{
+		bool		found;
+
+		LWLockRelease(pgnx_qstats->lock);
+		LWLockAcquire(pgnx_qstats->lock, LW_EXCLUSIVE);
+
+		/*
+		 * New queries are not counted once the limit is reached; a shared
+		 * hash would otherwise keep growing into the spare shared memory.
+		 */
+		entry = (pgnxQueryStatsEntry *) hash_search(pgnx_qstats_hash, &key,
+													HASH_FIND, NULL);
+		if (entry == NULL &&
+			hash_get_num_entries(pgnx_qstats_hash) < PGNX_QSTATS_MAX_ENTRIES)
+		{
+			entry = (pgnxQueryStatsEntry *) hash_search(pgnx_qstats_hash, &key,
+														HASH_ENTER_NULL, &found);
+			if (entry != NULL && !found)
+			{
+				SpinLockInit(&entry->mutex);
+				memset(&entry->counters, 0, sizeof(pgnxQueryStatsCounters));
+			}
+		}
+	}
+
+	if (entry != NULL)
+	{
+		SpinLockAcquire(&entry->mutex);
+		dst = (int64 *) &entry->counters;
+		for (i = 0; i < PGNX_QSTATS_NCOUNTERS; ++i)
+			dst[i] += src[i];
+		SpinLockRelease(&entry->mutex);
+	}
+
+	LWLockRelease(pgnx_qstats->lock);
+}
+
+PG_FUNCTION_INFO_V1(pgnodemx_query_os_stats);
+Datum
+pgnodemx_query_os_stats(PG_FUNCTION_ARGS)
+{
+	int						nrow = 0;
+	int						ncol = PGNX_QSTATS_NCOL;
+	char				 ***values = NULL;
+	pgnxQueryStatsKey	   *keys;
+	pgnxQueryStatsCounters *counters;
+	pgnxQueryStatsEntry	   *entry;
+	HASH_SEQ_STATUS			status;
+	int						i;
+	int						j;
+
+	if (pgnx_qstats == NULL)
+		return form_srf(fcinfo, NULL, 0, ncol, bigint_oid_oid_9_bigint_sig);
+
+	/* take a copy, then format it without holding the lock */
+	LWLockAcquire(pgnx_qstats->lock, LW_SHARED);
+	i = Max(hash_get_num_entries(pgnx_qstats_hash), 1);
+	keys = (pgnxQueryStatsKey *) palloc(i * sizeof(pgnxQueryStatsKey));
+	counters = (pgnxQueryStatsCounters *) palloc(i * sizeof(pgnxQueryStatsCounters));
+	hash_seq_init(&status, pgnx_qstats_hash);
+	while ((entry = (pgnxQueryStatsEntry *) hash_seq_search(&status)) != NULL)
+	{
+		keys[nrow] = entry->key;
+		SpinLockAcquire(&entry->mutex);
+		counters[nrow] = entry->counters;
+		SpinLockRelease(&entry->mutex);
+		nrow++;
+	}
+	LWLockRelease(pgnx_qstats->lock);
+
+	if (nrow > 0)
+		values = (char ***) palloc(nrow * sizeof(char **));
+	for (i = 0; i < nrow; ++i)
+	{
+		int64	   *c = (int64 *) &counters[i];
+
+		values[i] = (char **) palloc(ncol * sizeof(char *));
+		values[i][0] = int64_to_string((int64) keys[i].queryid);
+		values[i][1] = psprintf("%u", keys[i].dbid);
+		values[i][2] = psprintf("%u", keys[i].userid);
+		for (j = 0; j < PGNX_QSTATS_NCOUNTERS; ++j)
+			values[i][3 + j] = int64_to_string(c[j]);
+	}
+
+	return form_srf(fcinfo, values, nrow, ncol, bigint_oid_oid_9_bigint_sig);
+}
+
+PG_FUNCTION_INFO_V1(pgnodemx_query_os_stats_reset);
+Datum
+pgnodemx_query_os_stats_reset(PG_FUNCTION_ARGS)
+{
+	pgnxQueryStatsEntry	   *entry;
+	HASH_SEQ_STATUS			status;
+
+	if (pgnx_qstats == NULL)
+		PG_RETURN_VOID();
+
+	LWLockAcquire(pgnx_qstats->lock, LW_EXCLUSIVE);
+	hash_seq_init(&status, pgnx_qstats_hash);
+	while ((entry = (pgnxQueryStatsEntry *) hash_seq_search(&status)) != NULL)
+		hash_search(pgnx_qstats_hash, &entry->key, HASH_REMOVE, NULL);
+	LWLockRelease(pgnx_qstats->lock);
+
+	PG_RETURN_VOID();
+}
@@ -8,6 +8,14 @@ CREATE EXTENSION pgnodemx;
 SELECT cgroup_mode();
 SELECT * FROM cgroup_path();
 SELECT cgroup_process_count();
+SELECT count(*) > 0 FROM backend_cgroup();
+SELECT count(DISTINCT cgroup_path) > 0, bool_and(usage_usec >= 0) FROM backend_cgroup(true);
+-- take a baseline, then reconnect so that a new backend enters the cgroup
+SELECT count(*) >= 0 FROM cgroup_members_delta();
+\c
+SELECT bool_or(pid = pg_backend_pid() AND change = 'entered' AND comm IS NOT NULL),
+       bool_and(change IN ('entered', 'left'))
+FROM cgroup_members_delta();
 SELECT current_setting('pgnodemx.containerized');
 SELECT current_setting('pgnodemx.cgroup_enabled');
 
@@ -54,6 +62,8 @@ SELECT * FROM cgroup_setof_nkv('cpu.pressure');
 
 SELECT envvar_text('PGDATA');
 SELECT envvar_bigint('PGPORT');
+SELECT name, value, int8_value, bool_value, size_bytes FROM envvar_all('PGDATA');
+SELECT count(*) > 0 FROM envvar_all();
 
 SELECT * FROM proc_diskstats();
 
@@ -81,6 +91,12 @@ SELECT * FROM kdapi_scalar_bigint('cpu_limit');
 SELECT * FROM kdapi_scalar_bigint('cpu_request');
 SELECT * FROM kdapi_scalar_bigint('mem_limit');
 SELECT * FROM kdapi_scalar_bigint('mem_request');
+SELECT count(*) FROM kdapi_setof_kv('labels');
+SET pgnodemx.kdapi_cache = off;
+SELECT count(*) FROM kdapi_setof_kv('labels');
+RESET pgnodemx.kdapi_cache;
+SELECT kdapi_value('labels', (SELECT key FROM kdapi_setof_kv('labels') LIMIT 1)) IS NOT NULL;
+SELECT kdapi_value('labels', 'no-such-label') IS NULL;
 
 SELECT *
 FROM proc_mountinfo() m
@@ -153,5 +169,81 @@ JOIN proc_pid_cmdline() c
 ON s.pid = c.pid
 JOIN proc_pid_io() i
 ON c.pid = i.pid;
+SELECT pid = pg_backend_pid() AS self, tid = pg_backend_pid() AS main_thread, state FROM proc_task_stat(pg_backend_pid());
+SELECT count(*) > 0 FROM proc_pid_schedstat() WHERE pid = pg_backend_pid();
+SELECT threads, voluntary_ctxt_switches >= 0 FROM proc_pid_status() WHERE pid = pg_backend_pid();
+SELECT total > 0, relation >= 0 FROM proc_pid_fd_summary() WHERE pid = pg_backend_pid();
+SELECT total > 0, relation IS NULL FROM proc_pid_fd_summary(false) WHERE pid = pg_backend_pid();
+SELECT count(*) > 0 FROM proc_schedstat();
+SELECT count(*) > 0 FROM proc_interrupts();
+SELECT bool_and(cpu IS NULL) IS NOT FALSE FROM proc_interrupts() WHERE irq IN ('ERR', 'MIS', 'Err');
+SELECT count(DISTINCT cpu) > 0 FROM proc_softirqs() WHERE irq = 'NET_RX';
+SELECT count(*) > 0 FROM proc_buddyinfo() WHERE page_order = 0;
+SELECT count(*) > 0, bool_and(min_bytes <= high_bytes) FROM proc_zoneinfo();
+SELECT count(*) > 0, count(*) FILTER (WHERE is_default) = 1,
+       bool_and(page_size > 0 AND free_hugepages <= nr_hugepages),
+       bool_and(required_hugepages IS NULL OR is_default)
+FROM hugepage_status();
+SELECT count(*) > 0 FROM sysctl_snapshot() WHERE name = 'vm.swappiness' AND int8_value IS NOT NULL;
+SELECT count(*) > 0 FROM sysctl_compare();
 
 SELECT exec_path(), * FROM stat_file(exec_path());
+
+SELECT source, calls, files_opened, bytes_read, lines_parsed FROM pgnodemx_stats() ORDER BY source;
+SELECT pgnodemx_stats_reset();
+SELECT current_setting('pgnodemx.profile_enabled')::bool
+       AND current_setting('pgnodemx.profile_hz')::int > 0
+       AND current_setting('server_version_num')::int >= 100000 AS kernel_profile \gset
+\if :kernel_profile
+SELECT backend_kernel_profile_reset();
+SELECT pg_sleep(1);
+SELECT count(*) > 0, bool_and(samples > 0),
+       bool_or(backend_type = 'client backend' AND wait_event = 'PgSleep' AND state = 'S')
+FROM backend_kernel_profile();
+\endif
+SELECT backend_kernel_profile_reset();
+SELECT backend_exit_stats_reset();
+-- reconnect, so that the previous session exits, and wait for its exit to be counted
+\c
+DO $$
+BEGIN
+  FOR i IN 1..50 LOOP
+    EXIT WHEN EXISTS (SELECT 1 FROM backend_exit_stats()
+                      WHERE dbid = (SELECT oid FROM pg_database WHERE datname = current_database()));
+    PERFORM pg_sleep(0.1);
+  END LOOP;
+END
+$$;
+SELECT count(*) > 0, bool_and(exits > 0), bool_and(user_usec + system_usec >= 0)
+FROM backend_exit_stats()
+WHERE dbid = (SELECT oid FROM pg_database WHERE datname = current_database());
+SELECT backend_exit_stats_reset();
+SELECT current_setting('pgnodemx.query_stats_enabled')::bool
+       AND current_setting('server_version_num')::int >= 140000 AS query_stats \gset
+\if :query_stats
+SET pgnodemx.track_queries = on;
+SELECT query_os_stats_reset();
+SELECT count(*) > 0 FROM pg_class WHERE relname = 'pg_proc';
+SELECT count(*) > 0 FROM pg_class WHERE relname = 'pg_proc';
+SELECT count(*) > 0, max(calls) >= 2, bool_and(user_usec + system_usec >= 0)
+FROM query_os_stats()
+WHERE dbid = (SELECT oid FROM pg_database WHERE datname = current_database())
+AND userid = (SELECT oid FROM pg_roles WHERE rolname = current_user);
+RESET pgnodemx.track_queries;
+\endif
+SELECT query_os_stats_reset();
+SELECT count(*) > 0,
+       bool_and(logical_read_bytes >= 0 AND storage_read_bytes >= 0),
+       bool_and((storage_read_ratio IS NULL) = (logical_read_bytes = 0)),
+       bool_and((backend_type IS NULL) <> (database IS NULL))
+FROM page_cache_efficiency('10 milliseconds');
+
+CREATE SERVER pgnodemx FOREIGN DATA WRAPPER pgnodemx_fdw;
+CREATE SCHEMA nodemx;
+IMPORT FOREIGN SCHEMA pgnodemx FROM SERVER pgnodemx INTO nodemx;
+SELECT pid, comm, utime FROM nodemx.proc_pid_stat WHERE pid = pg_backend_pid();
+SELECT count(*) > 0 FROM nodemx.cgroup_files;
+
+SELECT proname, prorows FROM pg_proc WHERE proname IN ('proc_meminfo', 'proc_pid_stat') ORDER BY proname;
+SELECT proname, proparallel FROM pg_proc WHERE proname IN ('proc_pid_stat', 'pgnodemx_stats_reset') ORDER BY proname;
+SELECT count(*) > 0, sum(rss) > 0 FROM nodemx.proc_pid_stat;
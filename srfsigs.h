@@ -32,19 +32,37 @@
 extern Oid text_sig[];
 extern Oid bigint_sig[];
 extern Oid text_text_sig[];
+extern Oid bigint_text_text_sig[];
+extern Oid text_text_text_sig[];
 extern Oid text_bigint_sig[];
 extern Oid text_text_bigint_sig[];
+extern Oid text_text_text_bool_sig[];
+extern Oid text_text_bigint_bool_bigint_sig[];
 extern Oid text_text_float8_sig[];
+extern Oid text_text_2_bigint_float8_sig[];
 extern Oid _2_numeric_text_9_numeric_text_sig[];
 extern Oid _4_bigint_6_text_sig[];
 extern Oid text_16_bigint_sig[];
+extern Oid oid_oid_text_16_bigint_sig[];
+extern Oid bigint_oid_oid_9_bigint_sig[];
 extern Oid _5_bigint_sig[];
 extern Oid int_7_numeric_sig[];
 extern Oid int_text_int_text_sig[];
 extern Oid num_text_num_2_text_sig[];
 
+extern Oid int_3_numeric_float8_sig[];
+extern Oid text_8_numeric_float8_sig[];
+extern Oid int_text_int_3_bigint_sig[];
+extern Oid text_int_bigint_text_sig[];
+extern Oid int_text_5_bigint_sig[];
+extern Oid int_7_bigint_sig[];
+extern Oid int_9_bigint_sig[];
+extern Oid text_5_int_bigint_sig[];
 extern Oid load_avg_sig[];
 extern Oid proc_diskstats_sig[];
 extern Oid proc_pid_stat_sig[];
+extern Oid proc_task_stat_sig[];
+extern Oid hugepage_status_sig[];
+extern Oid pgnodemx_stats_sig[];
 
 #endif /* _SRFSIGS_H_ */
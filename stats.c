@@ -0,0 +1,527 @@
+/*
+ * stats.c
+ *
+ * Self-instrumentation of pgnodemx file access and parsing
+ *
+ * This code is released under the PostgreSQL license.
+ *
+ * Copyright 2020-2025 Crunchy Data Solutions, Inc.
+ *
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation for any purpose, without fee, and without a written
+ * agreement is hereby granted, provided that the above copyright notice
+ * and this paragraph and the following two paragraphs appear in all copies.
+ *
+ * IN NO EVENT SHALL CRUNCHY DATA SOLUTIONS, INC. BE LIABLE TO ANY PARTY
+ * FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING LOST PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS
+ * DOCUMENTATION, EVEN IF THE CRUNCHY DATA SOLUTIONS, INC. HAS BEEN ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THE CRUNCHY DATA SOLUTIONS, INC. SPECIFICALLY DISCLAIMS ANY WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE. THE SOFTWARE PROVIDED HEREUNDER IS
+ * ON AN "AS IS" BASIS, AND THE CRUNCHY DATA SOLUTIONS, INC. HAS NO
+ * OBLIGATIONS TO PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR
+ * MODIFICATIONS.
+ */
+
+#include "postgres.h"
+
+#include "access/xact.h"
+#include "lib/stringinfo.h"
+#include "miscadmin.h"
+#include "portability/instr_time.h"
+#include "storage/ipc.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "storage/spin.h"
+#include "utils/builtins.h"
+#include "utils/hsearch.h"
+#include "utils/lsyscache.h"
+#include "utils/timestamp.h"
+
+#include "genutils.h"
+#include "srfsigs.h"
+#include "stats.h"
+
+/*
+ * Counters are kept per source, i.e. per SQL function name, in a fixed
+ * size array in shared memory. Sources beyond PGNX_STATS_MAX_SOURCES
+ * are silently not tracked.
+ *
+ * Call latency goes into a log2 histogram of microseconds: bucket 0
+ * holds calls under 2us, bucket i holds [2^i, 2^(i+1)) us, and the last
+ * bucket is open ended.
+ */
+#define PGNX_STATS_MAX_SOURCES	128
+#define PGNX_STATS_NBUCKETS		24
+#define PGNX_STATS_TRANCHE		"pgnodemx"
+
+typedef struct pgnxStatsCounters
+{
+	int64		calls;
+	int64		files_opened;
+	int64		file_reads;
+	int64		bytes_read;
+	int64		lines_parsed;
+	double		read_time;		/* all times in msec */
+	double		parse_time;
+	double		build_time;
+	double		total_time;
+	int64		hist[PGNX_STATS_NBUCKETS];
+} pgnxStatsCounters;
+
+typedef struct pgnxStatsEntry
+{
+	char				source[NAMEDATALEN];
+	slock_t				mutex;		/* protects the counters only */
+	pgnxStatsCounters	counters;
+} pgnxStatsEntry;
+
+typedef struct pgnxStatsShared
+{
+	LWLock		   *lock;		/* protects nentries and source names */
+	int				nentries;
+	pgnxStatsEntry	entries[PGNX_STATS_MAX_SOURCES];
+} pgnxStatsShared;
+
+/*
+ * Backend local counters for the call in progress. They are started by
+ * the first instrumented event of a call and pushed to shared memory by
+ * stats_flush(), which form_srf() does for every SRF and the scalar
+ * functions which read files do themselves. If a call errors out, what
+ * it accumulated is discarded at the start of the next statement.
+ */
+typedef struct pgnxPendingStats
+{
+	bool			active;
+	TimestampTz		stmt_start;
+	instr_time		start;
+	instr_time		read_start;
+	instr_time		read_time;
+	instr_time		build_start;
+	bool			building;
+	int64			files_opened;
+	int64			file_reads;
+	int64			bytes_read;
+	int64			lines_parsed;
+} pgnxPendingStats;
+
+/*
+ * Backend local map from a function oid to its shared entry, so that the
+ * function name is looked up once per backend rather than on every call.
+ * Shared entries are never removed, so the pointers stay valid. A NULL
+ * entry means the shared table was full.
+ */
+typedef struct pgnxStatsFuncEntry
+{
+	Oid				funcid;		/* hash key, must be first */
+	pgnxStatsEntry *entry;
+} pgnxStatsFuncEntry;
+
+/* custom GUC vars */
+bool stats_enabled = true;
+
+static pgnxStatsShared *pgnx_stats = NULL;
+static pgnxPendingStats pending;
+static HTAB *stats_funcs = NULL;
+
+#if PG_VERSION_NUM >= 150000
+static shmem_request_hook_type prev_shmem_request_hook = NULL;
+#endif
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+
+static void stats_shmem_request(void);
+static void stats_shmem_startup(void);
+static void stats_pending_start(void);
+static int stats_bucket(double usec);
+static pgnxStatsEntry *stats_get_entry(const char *source);
+static pgnxStatsEntry *stats_get_func_entry(Oid funcid);
+static void stats_flush_entry(pgnxStatsEntry *entry);
+
+Datum pgnodemx_stats(PG_FUNCTION_ARGS);
+Datum pgnodemx_stats_reset(PG_FUNCTION_ARGS);
+
+/*
+ * Install the shared memory hooks. Must be called from _PG_init().
+ */
+void
+stats_init(void)
+{
+#if PG_VERSION_NUM >= 150000
+	prev_shmem_request_hook = shmem_request_hook;
+	shmem_request_hook = stats_shmem_request;
+#else
+	stats_shmem_request();
+#endif
+	prev_shmem_startup_hook = shmem_startup_hook;
+	shmem_startup_hook = stats_shmem_startup;
+}
+
+static void
+stats_shmem_request(void)
+{
+#if PG_VERSION_NUM >= 150000
+	if (prev_shmem_request_hook)
+		prev_shmem_request_hook();
+#endif
+
+	RequestAddinShmemSpace(MAXALIGN(sizeof(pgnxStatsShared)));
+#if PG_VERSION_NUM >= 90600
+	RequestNamedLWLockTranche(PGNX_STATS_TRANCHE, 1);
+#else
+	RequestAddinLWLocks(1);
+#endif
+}
+
+static void
+stats_shmem_startup(void)
+{
+	bool		found;
+
+	if (prev_shmem_startup_hook)
+		prev_shmem_startup_hook();
+
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+	pgnx_stats = ShmemInitStruct("pgnodemx stats",
+								 sizeof(pgnxStatsShared), &found);
+	if (!found)
+	{
+		int		i;
+
+		memset(pgnx_stats, 0, sizeof(pgnxStatsShared));
+#if PG_VERSION_NUM >= 90600
+		pgnx_stats->lock = &(GetNamedLWLockTranche(PGNX_STATS_TRANCHE))->lock;
+#else
+		pgnx_stats->lock = LWLockAssign();
+#endif
+		for (i = 0; i < PGNX_STATS_MAX_SOURCES; ++i)
+			SpinLockInit(&pgnx_stats->entries[i].mutex);
+	}
+
+	LWLockRelease(AddinShmemInitLock);
+}
+
+/*
+ * Begin a new set of pending counters if none are active for the
+ * current statement.
+ */
+static void
+stats_pending_start(void)
+{
+	TimestampTz	stmt_start = GetCurrentStatementStartTimestamp();
+
+	if (pending.active && pending.stmt_start == stmt_start)
+		return;
+
+	memset(&pending, 0, sizeof(pending));
+	pending.active = true;
+	pending.stmt_start = stmt_start;
+	INSTR_TIME_SET_CURRENT(pending.start);
+}
+
+void
+stats_read_begin(void)
+{
+	if (!stats_enabled || pgnx_stats == NULL)
+		return;
+
+	stats_pending_start();
+	INSTR_TIME_SET_CURRENT(pending.read_start);
+}
+
+void
+stats_read_end(size_t nbytes, int nreads)
+{
+	instr_time	now;
+
+	if (!stats_enabled || !pending.active)
+		return;
+
+	INSTR_TIME_SET_CURRENT(now);
+	INSTR_TIME_SUBTRACT(now, pending.read_start);
+	INSTR_TIME_ADD(pending.read_time, now);
+
+	pending.files_opened += 1;
+	pending.file_reads += nreads;
+	pending.bytes_read += nbytes;
+}
+
+void
+stats_lines_parsed(int nlines)
+{
+	if (!stats_enabled || !pending.active)
+		return;
+
+	pending.lines_parsed += nlines;
+}
+
+void
+stats_build_begin(void)
+{
+	if (!stats_enabled || pgnx_stats == NULL)
+		return;
+
+	stats_pending_start();
+	INSTR_TIME_SET_CURRENT(pending.build_start);
+	pending.building = true;
+}
+
+/*
+ * Attribute the pending counters to the SQL function being called,
+ * and start over.
+ */
+void
+stats_flush(FunctionCallInfo fcinfo)
+{
+	pgnxStatsEntry *entry = NULL;
+
+	if (!stats_enabled || pgnx_stats == NULL)
+		return;
+
+	if (fcinfo != NULL && fcinfo->flinfo != NULL)
+		entry = stats_get_func_entry(fcinfo->flinfo->fn_oid);
+
+	stats_flush_entry(entry);
+}
+
+/*
+ * As above, for callers which are not SQL functions. A NULL source
+ * discards the pending counters.
+ */
+void
+stats_flush_source(const char *source)
+{
+	if (!stats_enabled || pgnx_stats == NULL)
+		return;
+
+	stats_flush_entry(source != NULL ? stats_get_entry(source) : NULL);
+}
+
+/*
+ * Add the pending counters to entry, or just discard them if entry
+ * is NULL, and start over.
+ */
+static void
+stats_flush_entry(pgnxStatsEntry *entry)
+{
+	instr_time		now;
+	instr_time		total;
+	double			total_ms;
+	double			read_ms;
+	double			build_ms = 0;
+	int				bucket;
+
+	stats_pending_start();
+	pending.active = false;
+
+	INSTR_TIME_SET_CURRENT(now);
+	total = now;
+	INSTR_TIME_SUBTRACT(total, pending.start);
+	total_ms = INSTR_TIME_GET_MILLISEC(total);
+	read_ms = INSTR_TIME_GET_MILLISEC(pending.read_time);
+	if (pending.building)
+	{
+		INSTR_TIME_SUBTRACT(now, pending.build_start);
+		build_ms = INSTR_TIME_GET_MILLISEC(now);
+	}
+
+	if (entry == NULL)
+		return;
+
+	bucket = stats_bucket(total_ms * 1000.0);
+
+	SpinLockAcquire(&entry->mutex);
+	entry->counters.calls += 1;
+	entry->counters.files_opened += pending.files_opened;
+	entry->counters.file_reads += pending.file_reads;
+	entry->counters.bytes_read += pending.bytes_read;
+	entry->counters.lines_parsed += pending.lines_parsed;
+	entry->counters.read_time += read_ms;
+	entry->counters.parse_time += Max(total_ms - read_ms - build_ms, 0);
+	entry->counters.build_time += build_ms;
+	entry->counters.total_time += total_ms;
+	entry->counters.hist[bucket] += 1;
+	SpinLockRelease(&entry->mutex);
+}
+
+static int
+stats_bucket(double usec)
+{
+	uint64		v = (uint64) usec;
+	int			bucket = 0;
+
+	while ((v >>= 1) != 0 && bucket < PGNX_STATS_NBUCKETS - 1)
+		bucket++;
+
+	return bucket;
+}
+
+/*
+ * Find the shared entry for source, adding it if there is room.
+ * Returns NULL if the table is full.
+ */
+static pgnxStatsEntry *
+stats_get_entry(const char *source)
+{
+	pgnxStatsEntry *entry = NULL;
+	int				i;
+
+	LWLockAcquire(pgnx_stats->lock, LW_SHARED);
+	for (i = 0; i < pgnx_stats->nentries; ++i)
+	{
+		if (strcmp(pgnx_stats->entries[i].source, source) == 0)
+		{
+			entry = &pgnx_stats->entries[i];
+			break;
+		}
+	}
+	LWLockRelease(pgnx_stats->lock);
+
+	if (entry != NULL)
+		return entry;
+
+	/* recheck under exclusive lock, someone may have beaten us to it */
+	LWLockAcquire(pgnx_stats->lock, LW_EXCLUSIVE);
+	for (i = 0; i < pgnx_stats->nentries; ++i)
+	{
+		if (strcmp(pgnx_stats->entries[i].source, source) == 0)
+		{
+			entry = &pgnx_stats->entries[i];
+			break;
+		}
+	}
+	if (entry == NULL && pgnx_stats->nentries < PGNX_STATS_MAX_SOURCES)
+	{
+		entry = &pgnx_stats->entries[pgnx_stats->nentries];
+		strlcpy(entry->source, source, NAMEDATALEN);
+		memset(&entry->counters, 0, sizeof(pgnxStatsCounters));
+		pgnx_stats->nentries += 1;
+	}
+	LWLockRelease(pgnx_stats->lock);
+
+	return entry;
+}
+
+/*
+ * Find the shared entry for the function funcid through the backend local
+ * map, resolving the function name only the first time it is seen.
+ * Returns NULL if the function does not exist or the table is full.
+ */
+static pgnxStatsEntry *
+stats_get_func_entry(Oid funcid)
+{
+	pgnxStatsFuncEntry *fentry;
+	char			   *source;
+
+	if (stats_funcs == NULL)
+	{
+		HASHCTL		ctl;
+
+		memset(&ctl, 0, sizeof(ctl));
+		ctl.keysize = sizeof(Oid);
+		ctl.entrysize = sizeof(pgnxStatsFuncEntry);
+		stats_funcs = hash_create("pgnodemx stats functions", 64, &ctl,
+								  HASH_ELEM | HASH_BLOBS);
+	}
+
+	fentry = (pgnxStatsFuncEntry *) hash_search(stats_funcs, &funcid,
+												HASH_FIND, NULL);
+	if (fentry != NULL)
+		return fentry->entry;
+
+	if ((source = get_func_name(funcid)) == NULL)
+		return NULL;
+
+	fentry = (pgnxStatsFuncEntry *) hash_search(stats_funcs, &funcid,
+												HASH_ENTER, NULL);
+	fentry->entry = stats_get_entry(source);
+	pfree(source);
+
+	return fentry->entry;
+}
+
+PG_FUNCTION_INFO_V1(pgnodemx_stats);
+Datum
+pgnodemx_stats(PG_FUNCTION_ARGS)
+{
+	int					nrow = 0;
+	int					ncol = 11;
+	char			 ***values = NULL;
+	pgnxStatsCounters  *counters;
+	char			  **sources;
+	int					i;
+
+	if (pgnx_stats == NULL)
+		return form_srf(fcinfo, NULL, 0, ncol, pgnodemx_stats_sig);
+
+	/* take a consistent copy, then format it without holding locks */
+	LWLockAcquire(pgnx_stats->lock, LW_SHARED);
+	nrow = pgnx_stats->nentries;
+	counters = (pgnxStatsCounters *) palloc(Max(nrow, 1) * sizeof(pgnxStatsCounters));
+	sources = (char **) palloc(Max(nrow, 1) * sizeof(char *));
+	for (i = 0; i < nrow; ++i)
+	{
+		pgnxStatsEntry *entry = &pgnx_stats->entries[i];
+
+		sources[i] = pstrdup(entry->source);
+		SpinLockAcquire(&entry->mutex);
+		counters[i] = entry->counters;
+		SpinLockRelease(&entry->mutex);
+	}
+	LWLockRelease(pgnx_stats->lock);
+
+	if (nrow > 0)
+		values = (char ***) palloc(nrow * sizeof(char **));
+	for (i = 0; i < nrow; ++i)
+	{
+		StringInfo	hist = makeStringInfo();
+		int			b;
+
+		appendStringInfoChar(hist, '{');
+		for (b = 0; b < PGNX_STATS_NBUCKETS; ++b)
+			appendStringInfo(hist, b ? ",%s" : "%s",
+							 int64_to_string(counters[i].hist[b]));
+		appendStringInfoChar(hist, '}');
+
+		values[i] = (char **) palloc(ncol * sizeof(char *));
+		values[i][0] = sources[i];
+		values[i][1] = int64_to_string(counters[i].calls);
+		values[i][2] = int64_to_string(counters[i].files_opened);
+		values[i][3] = int64_to_string(counters[i].file_reads);
+		values[i][4] = int64_to_string(counters[i].bytes_read);
+		values[i][5] = int64_to_string(counters[i].lines_parsed);
+		values[i][6] = psprintf("%.3f", counters[i].read_time);
+		values[i][7] = psprintf("%.3f", counters[i].parse_time);
+		values[i][8] = psprintf("%.3f", counters[i].build_time);
+		values[i][9] = psprintf("%.3f", counters[i].total_time);
+		values[i][10] = hist->data;
+	}
+
+	return form_srf(fcinfo, values, nrow, ncol, pgnodemx_stats_sig);
+}
+
+PG_FUNCTION_INFO_V1(pgnodemx_stats_reset);
+Datum
+pgnodemx_stats_reset(PG_FUNCTION_ARGS)
+{
+	int		i;
+
+	if (pgnx_stats == NULL)
+		PG_RETURN_VOID();
+
+	LWLockAcquire(pgnx_stats->lock, LW_EXCLUSIVE);
+	for (i = 0; i < pgnx_stats->nentries; ++i)
+	{
+		pgnxStatsEntry *entry = &pgnx_stats->entries[i];
+
+		SpinLockAcquire(&entry->mutex);
+		memset(&entry->counters, 0, sizeof(pgnxStatsCounters));
+		SpinLockRelease(&entry->mutex);
+	}
+	LWLockRelease(pgnx_stats->lock);
+
+	PG_RETURN_VOID();
+}
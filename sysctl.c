@@ -0,0 +1,364 @@
+/*
+ * sysctl.c
+ *
+ * Kernel tunables snapshot and comparison
+ *
+ * This code is released under the PostgreSQL license.
+ *
+ * Copyright 2020-2025 Crunchy Data Solutions, Inc.
+ *
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation for any purpose, without fee, and without a written
+ * agreement is hereby granted, provided that the above copyright notice
+ * and this paragraph and the following two paragraphs appear in all copies.
+ *
+ * IN NO EVENT SHALL CRUNCHY DATA SOLUTIONS, INC. BE LIABLE TO ANY PARTY
+ * FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING LOST PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS
+ * DOCUMENTATION, EVEN IF THE CRUNCHY DATA SOLUTIONS, INC. HAS BEEN ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THE CRUNCHY DATA SOLUTIONS, INC. SPECIFICALLY DISCLAIMS ANY WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE. THE SOFTWARE PROVIDED HEREUNDER IS
+ * ON AN "AS IS" BASIS, AND THE CRUNCHY DATA SOLUTIONS, INC. HAS NO
+ * OBLIGATIONS TO PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR
+ * MODIFICATIONS.
+ */
+
+#include "postgres.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "fmgr.h"
+#include "storage/fd.h"
+
+#include "genutils.h"
+#include "procfunc.h"
+#include "srfsigs.h"
+#include "stats.h"
+#include "sysctl.h"
+
+/*
+ * The tunables are read relative to a directory fd for each of the
+ * directories below, opened on first use and kept open for the life
+ * of the backend, so a snapshot costs one openat and read per file.
+ */
+#define SYSCTL_VM		0
+#define SYSCTL_KERNEL	1
+#define SYSCTL_THP		2
+#define SYSCTL_NDIRS	3
+
+/* relative to procroot, except the last */
+static const char *const sysctl_dirs[SYSCTL_NDIRS] = {
+	"sys/vm",
+	"sys/kernel",
+	"/sys/kernel/mm/transparent_hugepage"
+};
+
+typedef struct sysctlEntry
+{
+	int			dir;
+	const char *file;
+	const char *name;
+} sysctlEntry;
+
+/* the curated list of tunables which matter to PostgreSQL */
+static const sysctlEntry sysctl_entries[] = {
+	{SYSCTL_THP, "enabled", "transparent_hugepage.enabled"},
+	{SYSCTL_THP, "defrag", "transparent_hugepage.defrag"},
+	{SYSCTL_THP, "shmem_enabled", "transparent_hugepage.shmem_enabled"},
+	{SYSCTL_THP, "khugepaged/defrag", "transparent_hugepage.khugepaged.defrag"},
+	{SYSCTL_VM, "overcommit_memory", "vm.overcommit_memory"},
+	{SYSCTL_VM, "overcommit_ratio", "vm.overcommit_ratio"},
+	{SYSCTL_VM, "overcommit_kbytes", "vm.overcommit_kbytes"},
+	{SYSCTL_VM, "swappiness", "vm.swappiness"},
+	{SYSCTL_VM, "dirty_ratio", "vm.dirty_ratio"},
+	{SYSCTL_VM, "dirty_bytes", "vm.dirty_bytes"},
+	{SYSCTL_VM, "dirty_background_ratio", "vm.dirty_background_ratio"},
+	{SYSCTL_VM, "dirty_background_bytes", "vm.dirty_background_bytes"},
+	{SYSCTL_VM, "dirty_expire_centisecs", "vm.dirty_expire_centisecs"},
+	{SYSCTL_VM, "dirty_writeback_centisecs", "vm.dirty_writeback_centisecs"},
+	{SYSCTL_VM, "min_free_kbytes", "vm.min_free_kbytes"},
+	{SYSCTL_VM, "watermark_scale_factor", "vm.watermark_scale_factor"},
+	{SYSCTL_VM, "zone_reclaim_mode", "vm.zone_reclaim_mode"},
+	{SYSCTL_VM, "nr_hugepages", "vm.nr_hugepages"},
+	{SYSCTL_VM, "nr_overcommit_hugepages", "vm.nr_overcommit_hugepages"},
+	{SYSCTL_VM, "max_map_count", "vm.max_map_count"},
+	{SYSCTL_KERNEL, "numa_balancing", "kernel.numa_balancing"},
+	{SYSCTL_KERNEL, "sched_autogroup_enabled", "kernel.sched_autogroup_enabled"},
+	{SYSCTL_KERNEL, "sched_migration_cost_ns", "kernel.sched_migration_cost_ns"},
+	{SYSCTL_KERNEL, "sched_min_granularity_ns", "kernel.sched_min_granularity_ns"},
+	{SYSCTL_KERNEL, "sched_wakeup_granularity_ns", "kernel.sched_wakeup_granularity_ns"},
+	{SYSCTL_KERNEL, "shmmax", "kernel.shmmax"},
+	{SYSCTL_KERNEL, "shmall", "kernel.shmall"},
+	{SYSCTL_KERNEL, "sem", "kernel.sem"}
+};
+
+/*
+ * The recommended profile: the value must be one of a "|" separated
+ * list, or an integer no larger or no smaller than a limit.
+ */
+typedef enum sysctlRuleKind
+{
+	SYSCTL_RULE_IN,
+	SYSCTL_RULE_MAX,
+	SYSCTL_RULE_MIN
+} sysctlRuleKind;
+
+typedef struct sysctlRule
+{
+	const char	   *name;
+	sysctlRuleKind	kind;
+	const char	   *arg;
+} sysctlRule;
+
+static const sysctlRule sysctl_profile[] = {
+	{"transparent_hugepage.enabled", SYSCTL_RULE_IN, "never|madvise"},
+	{"transparent_hugepage.defrag", SYSCTL_RULE_IN, "never|madvise|defer+madvise"},
+	{"vm.overcommit_memory", SYSCTL_RULE_IN, "2"},
+	{"vm.swappiness", SYSCTL_RULE_MAX, "10"},
+	{"vm.dirty_background_ratio", SYSCTL_RULE_MAX, "5"},
+	{"vm.dirty_ratio", SYSCTL_RULE_MAX, "10"},
+	{"vm.zone_reclaim_mode", SYSCTL_RULE_IN, "0"},
+	{"kernel.numa_balancing", SYSCTL_RULE_IN, "0"},
+	{"kernel.sched_autogroup_enabled", SYSCTL_RULE_IN, "0"},
+	{"kernel.sched_migration_cost_ns", SYSCTL_RULE_MIN, "5000000"}
+};
+
+extern bool proc_enabled;
+
+static int sysctl_dirfds[SYSCTL_NDIRS] = {-1, -1, -1};
+
+static int sysctl_dirfd(int dir);
+static char *sysctl_read(const sysctlEntry *entry);
+static char *sysctl_int8_value(const char *value);
+static bool sysctl_rule_ok(const sysctlRule *rule, const char *value);
+
+Datum pgnodemx_sysctl_snapshot(PG_FUNCTION_ARGS);
+Datum pgnodemx_sysctl_compare(PG_FUNCTION_ARGS);
+
+/*
+ * The fd of one of sysctl_dirs, opening it if need be. Returns -1 if
+ * it cannot be opened, or if no more fds may be kept open, in which
+ * case the files are opened by full path instead.
+ */
+static int
+sysctl_dirfd(int dir)
+{
+	char	   *path;
+	int			fd;
+
+	if (sysctl_dirfds[dir] >= 0)
+		return sysctl_dirfds[dir];
+
+	if (sysctl_dirs[dir][0] == '/')
+		path = (char *) sysctl_dirs[dir];
+	else
+		path = psprintf("%s/%s", procroot, sysctl_dirs[dir]);
+
+#if PG_VERSION_NUM >= 130000
+	if (!AcquireExternalFD())
+		return -1;
+#endif
+	fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd < 0)
+	{
+#if PG_VERSION_NUM >= 130000
+		ReleaseExternalFD();
+#endif
+		return -1;
+	}
+
+	sysctl_dirfds[dir] = fd;
+	return fd;
+}
+
+/*
+ * Read one tunable. Returns NULL if it does not exist on this kernel.
+ * For the transparent_hugepage files, which list all the choices with
+ * the active one in brackets, e.g. "always [madvise] never", only the
+ * active one is returned.
+ */
+static char *
+sysctl_read(const sysctlEntry *entry)
+{
+	int			dirfd = sysctl_dirfd(entry->dir);
+	char		buf[256];
+	ssize_t		nbytes;
+	char	   *p;
+	char	   *q;
+	int			fd;
+
+	stats_read_begin();
+	if (dirfd >= 0)
+		fd = openat(dirfd, entry->file, O_RDONLY | O_CLOEXEC);
+	else
+	{
+		char	   *path;
+
+		if (sysctl_dirs[entry->dir][0] == '/')
+			path = psprintf("%s/%s", sysctl_dirs[entry->dir], entry->file);
+		else
+			path = psprintf("%s/%s/%s", procroot, sysctl_dirs[entry->dir],
+							entry->file);
+		fd = open(path, O_RDONLY | O_CLOEXEC);
+	}
+	if (fd < 0)
+		return NULL;
+
+	nbytes = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (nbytes < 0)
+		return NULL;
+	stats_read_end(nbytes, 1);
+
+	buf[nbytes] = '\0';
+	while (nbytes > 0 && (buf[nbytes - 1] == '\n' || buf[nbytes - 1] == ' '))
+		buf[--nbytes] = '\0';
+
+	if ((p = strchr(buf, '[')) != NULL && (q = strchr(p, ']')) != NULL)
+		return pnstrdup(p + 1, q - p - 1);
+
+	return pstrdup(buf);
+}
+
+/*
+ * value as an integer, if it is one, else NULL
+ */
+static char *
+sysctl_int8_value(const char *value)
+{
+	char	   *endptr;
+
+	if (value == NULL || *value == '\0')
+		return NULL;
+
+	errno = 0;
+	(void) strtoll(value, &endptr, 10);
+	if (errno != 0 || *endptr != '\0')
+		return NULL;
+
+	return pstrdup(value);
+}
+
+static bool
+sysctl_rule_ok(const sysctlRule *rule, const char *value)
+{
+	if (rule->kind == SYSCTL_RULE_IN)
+	{
+		size_t		len = strlen(value);
+		const char *p = rule->arg;
+
+		while (p != NULL)
+		{
+			if (strncmp(p, value, len) == 0 && (p[len] == '|' || p[len] == '\0'))
+				return true;
+			if ((p = strchr(p, '|')) != NULL)
+				p++;
+		}
+		return false;
+	}
+	else
+	{
+		int64		val = strtoll(value, NULL, 10);
+		int64		limit = strtoll(rule->arg, NULL, 10);
+
+		return rule->kind == SYSCTL_RULE_MAX ? val <= limit : val >= limit;
+	}
+}
+
+/*
+ * The curated tunables, with the value as read and as an integer where
+ * it is one. Tunables this kernel does not have are left out.
+ */
+PG_FUNCTION_INFO_V1(pgnodemx_sysctl_snapshot);
+Datum
+pgnodemx_sysctl_snapshot(PG_FUNCTION_ARGS)
+{
+	int			ncol = SYSCTL_SNAPSHOT_NCOL;
+	int			nentries = lengthof(sysctl_entries);
+	char	 ***values;
+	int			nrow = 0;
+	int			i;
+
+	if (!proc_enabled)
+		return form_srf(fcinfo, NULL, 0, ncol, text_text_bigint_sig);
+
+	values = (char ***) palloc(nentries * sizeof(char **));
+	for (i = 0; i < nentries; ++i)
+	{
+		char	   *value = sysctl_read(&sysctl_entries[i]);
+
+		if (value == NULL)
+			continue;
+
+		values[nrow] = (char **) palloc(ncol * sizeof(char *));
+		values[nrow][0] = pstrdup(sysctl_entries[i].name);
+		values[nrow][1] = value;
+		values[nrow][2] = sysctl_int8_value(value);
+		nrow++;
+	}
+
+	return form_srf(fcinfo, values, nrow, ncol, text_text_bigint_sig);
+}
+
+/*
+ * The tunables of the recommended profile, their current value, the
+ * recommendation, and whether the value meets it. ok is NULL for
+ * tunables this kernel does not have.
+ */
+PG_FUNCTION_INFO_V1(pgnodemx_sysctl_compare);
+Datum
+pgnodemx_sysctl_compare(PG_FUNCTION_ARGS)
+{
+	int			ncol = SYSCTL_COMPARE_NCOL;
+	int			nrules = lengthof(sysctl_profile);
+	char	 ***values;
+	int			i;
+
+	if (!proc_enabled)
+		return form_srf(fcinfo, NULL, 0, ncol, text_text_text_bool_sig);
+
+	values = (char ***) palloc(nrules * sizeof(char **));
+	for (i = 0; i < nrules; ++i)
+	{
+		const sysctlRule *rule = &sysctl_profile[i];
+		char	   *value = NULL;
+		int			j;
+
+		for (j = 0; j < lengthof(sysctl_entries); ++j)
+		{
+			if (strcmp(sysctl_entries[j].name, rule->name) == 0)
+			{
+				value = sysctl_read(&sysctl_entries[j]);
+				break;
+			}
+		}
+
+		values[i] = (char **) palloc0(ncol * sizeof(char *));
+		values[i][0] = pstrdup(rule->name);
+		values[i][1] = value;
+		if (rule->kind == SYSCTL_RULE_IN)
+		{
+			char	   *rec = pstrdup(rule->arg);
+			char	   *p;
+
+			for (p = rec; *p != '\0'; p++)
+			{
+				if (*p == '|')
+					*p = ',';
+			}
+			values[i][2] = psprintf("in (%s)", rec);
+		}
+		else
+			values[i][2] = psprintf("%s %s",
+									rule->kind == SYSCTL_RULE_MAX ? "<=" : ">=",
+									rule->arg);
+		if (value != NULL)
+			values[i][3] = sysctl_rule_ok(rule, value) ? "t" : "f";
+	}
+
+	return form_srf(fcinfo, values, nrules, ncol, text_text_text_bool_sig);
+}